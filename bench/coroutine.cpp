@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <ut/ipc/coroutine.h>
+#include <ut/ipc/server.h>
+
+// Ping-pong between a coroutine driven client and an echoing server, one
+// message in flight at a time. Every round trip is a task of its own, so the
+// frame pool's hit rate shows whether frames stayed off the global heap
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t index = static_cast<size_t>(p / 100.0 * (sorted.size() - 1));
+    return sorted[index];
+}
+
+static UT::IPCTask<double> roundTrip(UT::IPCCoClient& client, const std::vector<char>& payload, size_t size) {
+    auto begin = std::chrono::steady_clock::now();
+    co_await client.send(0, payload.data(), size);
+    co_await client.receive();
+    auto end = std::chrono::steady_clock::now();
+    co_return std::chrono::duration<double, std::micro>(end - begin).count();
+}
+
+static UT::IPCTask<> run(UT::IPCCoClient& client, const std::string& name, int iterations, std::promise<void>& done) {
+    co_await client.connect(name);
+
+    std::cout << "size\tp50, us\tp99, us\tp99.9, us\tmax, us\n";
+
+    std::vector<char> payload(64 * 1024, 'x');
+    std::vector<double> samples;
+    for (size_t size : { 64, 1024, 4096, 65536 }) {
+        const int warmup = iterations / 10;
+        samples.clear();
+        samples.reserve(iterations);
+
+        for (int i = 0; i < warmup + iterations; ++i) {
+            double sample = co_await roundTrip(client, payload, size);
+            if (i >= warmup) {
+                samples.push_back(sample);
+            }
+        }
+
+        std::sort(samples.begin(), samples.end());
+        std::cout << size << "\t" << percentile(samples, 50) << "\t" << percentile(samples, 99) << "\t"
+                  << percentile(samples, 99.9) << "\t" << samples.back() << "\n";
+    }
+
+    done.set_value();
+}
+
+int main(int argc, char* argv[]) {
+    const int iterations = argc > 1 ? std::stoi(argv[1]) : 20000;
+    const std::string name = "bench-coroutine";
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setMessageHandler([&server] (UT::IPCClientId id, uint32_t type, const void* data, size_t bytes) {
+        server.sendMessage(id, type, data, bytes);
+    });
+    server.start(name);
+
+    UT::IPCCoClient client;
+    std::promise<void> done;
+    auto before = UT::IPCBufferPool::getInstance().getStats();
+    run(client, name, iterations, done).detach();
+    done.get_future().wait();
+    auto after = UT::IPCBufferPool::getInstance().getStats();
+
+    uint64_t hits = after.hits - before.hits;
+    uint64_t misses = after.misses - before.misses;
+    std::cout << "pool hit rate " << 100.0 * hits / (hits + misses) << "%\n";
+
+    client.stop();
+    server.stop();
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+
+// Growing number of clients, each on its own thread, streaming framed
+// messages to one server with a worker reactor per core, reporting the
+// aggregate rate the server delivers. "abstract" as the second argument
+// puts the endpoint into the abstract namespace
+
+static constexpr size_t kMessages = 20000; // per client
+static constexpr size_t kSize = 1024;
+
+int main(int argc, char* argv[]) {
+    const size_t maxClients = argc > 1 ? std::stoul(argv[1]) : 32;
+    const std::string name = "bench-fanin";
+    const auto ns = argc > 2 && std::string(argv[2]) == "abstract" ? UT::IPCNamespace::kAbstract : UT::IPCNamespace::kFilesystem;
+
+    std::atomic<size_t> messages = 0;
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setNamespace(ns);
+    server.setBackend(UT::IPCPoller::Backend::kEpoll);
+    server.setWorkers(std::max(1u, std::thread::hardware_concurrency()));
+    server.onMessageReceived.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&messages] (UT::IPCClientId, uint32_t, std::shared_ptr<void>, ssize_t) {
+            ++messages;
+        });
+    server.start(name);
+
+    std::cout << "clients\tmsg/s\tMB/s\n";
+
+    std::vector<char> payload(kSize, 'x');
+    for (size_t count = 1; count <= maxClients; count *= 2) {
+        std::vector<std::unique_ptr<UT::IPCClient>> clients;
+        for (size_t i = 0; i < count; ++i) {
+            clients.emplace_back(new UT::IPCClient());
+            clients.back()->setFramed(true);
+            clients.back()->setNamespace(ns);
+            clients.back()->start(name);
+        }
+        for (auto& client : clients) {
+            while (!client->getReady()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        messages = 0;
+        const size_t total = count * kMessages;
+
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> senders;
+        for (auto& client : clients) {
+            senders.emplace_back([&client, &payload] {
+                for (size_t i = 0; i < kMessages; ++i) {
+                    client->sendMessage(0, payload.data(), payload.size());
+                }
+            });
+        }
+        for (auto& sender : senders) {
+            sender.join();
+        }
+        while (messages < total) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        auto elapsed = std::chrono::duration<double>(end - begin).count();
+        std::cout << count << "\t" << static_cast<size_t>(total / elapsed) << "\t"
+                  << total * kSize / elapsed / (1024 * 1024) << "\n";
+
+        for (auto& client : clients) {
+            client->stop();
+        }
+    }
+
+    server.stop();
+
+    return 0;
+}
\ No newline at end of file
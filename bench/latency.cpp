@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+
+// Ping-pong between one client and an echoing server, one message in flight
+// at a time, reporting round trip percentiles per payload size. Pass "shm"
+// to measure the shared memory transport instead of the socket and "direct"
+// after the iteration count to handle messages on the IPC threads instead of
+// the event loop
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t index = static_cast<size_t>(p / 100.0 * (sorted.size() - 1));
+    return sorted[index];
+}
+
+int main(int argc, char* argv[]) {
+    const bool shm = argc > 1 && std::string(argv[1]) == "shm";
+    const int iterations = argc > 2 ? std::stoi(argv[2]) : 20000;
+    const bool direct = argc > 3 && std::string(argv[3]) == "direct";
+    const std::string name = "bench-latency";
+    const UT::IPCTransport transport = shm ? UT::IPCTransport::kSharedMemory : UT::IPCTransport::kSocket;
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setTransport(transport);
+    if (direct) {
+        server.setMessageHandler([&server] (UT::IPCClientId id, uint32_t type, const void* data, size_t bytes) {
+            server.sendMessage(id, type, data, bytes);
+        });
+    } else {
+        server.onMessageReceived.addEventHandler(
+            UT::EventLoop::getMainInstance(),
+            [&server] (UT::IPCClientId id, uint32_t type, std::shared_ptr<void> data, ssize_t bytes) {
+                server.sendMessage(id, type, data.get(), bytes);
+            });
+    }
+    server.start(name);
+
+    // The handler runs on the event loop, the measuring thread spins on it
+    std::atomic<size_t> replies = 0;
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setTransport(transport);
+    if (direct) {
+        client.setMessageHandler([&replies] (uint32_t, const void*, size_t) {
+            ++replies;
+        });
+    } else {
+        client.onMessageReceived.addEventHandler(
+            UT::EventLoop::getMainInstance(),
+            [&replies] (uint32_t, std::shared_ptr<void>, ssize_t) {
+                ++replies;
+            });
+    }
+    client.start(name);
+    while (!client.getReady()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::cout << "size\tp50, us\tp99, us\tp99.9, us\tmax, us\n";
+
+    std::vector<char> payload(64 * 1024, 'x');
+    std::vector<double> samples;
+    for (size_t size : { 64, 1024, 4096, 65536 }) {
+        const int warmup = iterations / 10;
+        samples.clear();
+        samples.reserve(iterations);
+
+        for (int i = 0; i < warmup + iterations; ++i) {
+            size_t expected = replies + 1;
+
+            auto begin = std::chrono::steady_clock::now();
+            client.sendMessage(0, payload.data(), size);
+            while (replies < expected) {
+                std::this_thread::yield();
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            if (i >= warmup) {
+                samples.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+            }
+        }
+
+        std::sort(samples.begin(), samples.end());
+        std::cout << size << "\t" << percentile(samples, 50) << "\t" << percentile(samples, 99) << "\t"
+                  << percentile(samples, 99.9) << "\t" << samples.back() << "\n";
+    }
+
+    client.stop();
+    server.stop();
+
+    return 0;
+}
\ No newline at end of file
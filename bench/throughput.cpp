@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+
+// Streams framed messages of growing size from one client to the server and
+// reports the rate at which they are delivered to the server's handlers.
+// Pass "shm" to measure the shared memory transport instead of the socket
+
+static constexpr size_t kBudget = 128 * 1024 * 1024; // bytes per size
+
+int main(int argc, char* argv[]) {
+    const bool shm = argc > 1 && std::string(argv[1]) == "shm";
+    const std::string name = "bench-throughput";
+    const UT::IPCTransport transport = shm ? UT::IPCTransport::kSharedMemory : UT::IPCTransport::kSocket;
+
+    std::atomic<size_t> messages = 0;
+    std::atomic<size_t> bytes = 0;
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setTransport(transport);
+    server.setRingSize(32 * 1024 * 1024); // fits the largest message
+    server.onMessageReceived.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&messages, &bytes] (UT::IPCClientId, uint32_t, std::shared_ptr<void>, ssize_t size) {
+            bytes += size;
+            ++messages;
+        });
+    server.start(name);
+
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setTransport(transport);
+    client.start(name);
+    while (!client.getReady()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::cout << "size\tmessages\tmsg/s\tMB/s\n";
+
+    std::vector<char> payload(16 * 1024 * 1024, 'x');
+    for (size_t size = 64; size <= payload.size(); size *= 4) {
+        const size_t count = std::clamp<size_t>(kBudget / size, 16, 100000);
+        messages = 0;
+        bytes = 0;
+
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            client.sendMessage(0, payload.data(), size);
+        }
+        while (messages < count) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        auto elapsed = std::chrono::duration<double>(end - begin).count();
+        std::cout << size << "\t" << count << "\t" << static_cast<size_t>(count / elapsed) << "\t"
+                  << bytes / elapsed / (1024 * 1024) << "\n";
+    }
+
+    client.stop();
+    server.stop();
+
+    return 0;
+}
\ No newline at end of file
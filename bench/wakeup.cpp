@@ -0,0 +1,100 @@
+#include <chrono>
+#include <iostream>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <ut/ipc/server.h>
+
+// Measures the round trip of one active client while a growing number of
+// idle clients stays connected to the server, for every poller backend
+
+static int connectRaw(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    const int iterations = argc > 1 ? std::stoi(argv[1]) : 10000;
+    const std::string name = "bench-wakeup";
+    const std::string path = UT_IPC_SOCKET_PATH + name;
+
+    // Every idle client costs two descriptors in this process
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    size_t maxIdle = limit.rlim_cur > 64 ? (limit.rlim_cur - 64) / 2 : 0;
+
+    std::pair<UT::IPCPoller::Backend, const char*> backends[] = {
+        { UT::IPCPoller::Backend::kPoll, "poll" },
+        { UT::IPCPoller::Backend::kEpoll, "epoll" }
+    };
+
+    std::cout << "backend\tidle\tround trip, us\n";
+
+    for (auto& [backend, backendName] : backends) {
+        UT::IPCServer server;
+        server.setBackend(backend);
+        server.onDataReceived.addEventHandler(
+            UT::EventLoop::getMainInstance(),
+            [&server] (UT::IPCClientId id, std::shared_ptr<void> data, ssize_t bytes) {
+                server.send(id, data.get(), bytes);
+            });
+        server.start(name);
+
+        int active = connectRaw(path);
+        if (active == -1) {
+            std::cerr << "connect(...) failed, errno: " << errno << "\n";
+            return 1;
+        }
+
+        std::vector<int> idle;
+        for (size_t count : { 0, 16, 256, 1024, 4096, 16384 }) {
+            if (count > maxIdle) {
+                break;
+            }
+
+            while (idle.size() < count) {
+                int fd = connectRaw(path);
+                if (fd == -1) {
+                    std::cerr << "connect(...) failed, errno: " << errno << "\n";
+                    return 1;
+                }
+                idle.push_back(fd);
+            }
+
+            char byte = 0;
+            auto begin = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                ::send(active, &byte, sizeof(byte), 0);
+                recv(active, &byte, sizeof(byte), 0);
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            auto elapsed = std::chrono::duration<double, std::micro>(end - begin).count();
+            std::cout << backendName << "\t" << count << "\t" << elapsed / iterations << "\n";
+        }
+
+        for (int fd : idle) {
+            close(fd);
+        }
+        close(active);
+        server.stop();
+    }
+
+    return 0;
+}
\ No newline at end of file
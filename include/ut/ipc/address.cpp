@@ -0,0 +1,57 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#include "address.h"
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace UT {
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+socklen_t IPCAddress::resolve(const std::string& path, IPCNamespace ns, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    // Abstract names start with a null byte and aren't terminated, so the
+    // length is exactly what identifies them
+    if (ns == IPCNamespace::kAbstract) {
+        if (path.size() + 1 > sizeof(addr.sun_path)) {
+            throw std::length_error("socket name too long");
+        }
+        memcpy(addr.sun_path + 1, path.data(), path.size());
+        return offsetof(sockaddr_un, sun_path) + 1 + path.size();
+    }
+
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::length_error("socket path too long");
+    }
+    memcpy(addr.sun_path, path.data(), path.size());
+    return sizeof(addr);
+}
+
+} // namespace UT
\ No newline at end of file
@@ -0,0 +1,52 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_ADDRESS_H
+#define UT_IPC_ADDRESS_H
+
+#include "ut/ipc/common.h"
+
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace UT {
+
+// Helpers for building AF_UNIX endpoint addresses
+class IPCAddress {
+public:
+    IPCAddress() = delete;
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Fills "addr" for "path" in the namespace "ns" and returns the length
+    // to pass to bind(...) / connect(...). Throws std::length_error when the
+    // path doesn't fit into sun_path
+    static socklen_t resolve(const std::string& path, IPCNamespace ns, sockaddr_un& addr);
+}; // class IPCAddress
+
+} // namespace UT
+
+#endif // UT_IPC_ADDRESS_H
\ No newline at end of file
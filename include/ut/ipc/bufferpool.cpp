@@ -0,0 +1,198 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#include "bufferpool.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace UT {
+
+/******************************************************************************
+ * Thread cache
+ *****************************************************************************/
+
+struct IPCBufferPool::ThreadCache {
+    // Hands the blocks over to the shared lists directly, release(...) would
+    // put them back into this cache while it's being walked
+    ~ThreadCache() {
+        alive = false;
+
+        auto& pool = IPCBufferPool::getInstance();
+        std::unique_lock lock(pool.mMutex);
+        for (size_t i = 0; i < kClasses; ++i) {
+            for (void* block : blocks[i]) {
+                if (pool.mBlocks[i].size() < UT_IPC_POOL_GLOBAL_CACHE) {
+                    pool.mBlocks[i].push_back(block);
+                } else {
+                    free(block);
+                }
+            }
+            blocks[i].clear();
+        }
+    }
+
+    std::vector<void*> blocks[kClasses];
+    bool alive = true;
+}; // struct IPCBufferPool::ThreadCache
+
+/******************************************************************************
+ * Constructors / Destructors
+ *****************************************************************************/
+
+IPCBufferPool::~IPCBufferPool() {
+    for (auto& blocks : mBlocks) {
+        for (void* block : blocks) {
+            free(block);
+        }
+    }
+}
+
+IPCBufferPool& IPCBufferPool::getInstance() {
+    // Never destroyed, buffers may still be released by thread caches and
+    // shared pointers outliving static destruction
+    static auto pool = new IPCBufferPool();
+    return *pool;
+}
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+void* IPCBufferPool::allocate(size_t bytes) {
+    size_t index = getClass(bytes);
+
+    if (index < kClasses) {
+        auto& cache = getThreadCache();
+        if (cache.alive && !cache.blocks[index].empty()) {
+            void* block = cache.blocks[index].back();
+            cache.blocks[index].pop_back();
+            mHits.fetch_add(1, std::memory_order_relaxed);
+            return block;
+        }
+
+        std::unique_lock lock(mMutex);
+        if (!mBlocks[index].empty()) {
+            void* block = mBlocks[index].back();
+            mBlocks[index].pop_back();
+            mHits.fetch_add(1, std::memory_order_relaxed);
+            return block;
+        }
+    }
+
+    mMisses.fetch_add(1, std::memory_order_relaxed);
+
+    void* block = malloc(getCapacity(bytes));
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void IPCBufferPool::release(void* block, size_t bytes) {
+    if (!block) {
+        return;
+    }
+
+    size_t index = getClass(bytes);
+    if (index >= kClasses) {
+        free(block);
+        return;
+    }
+
+    // Blocks released on a thread that keeps receiving stay local to it,
+    // the rest migrates to the shared list and is picked up from there
+    auto& cache = getThreadCache();
+    if (cache.alive && cache.blocks[index].size() < UT_IPC_POOL_THREAD_CACHE) {
+        cache.blocks[index].push_back(block);
+        return;
+    }
+
+    std::unique_lock lock(mMutex);
+    if (mBlocks[index].size() < UT_IPC_POOL_GLOBAL_CACHE) {
+        mBlocks[index].push_back(block);
+        return;
+    }
+    lock.unlock();
+
+    free(block);
+}
+
+std::shared_ptr<void> IPCBufferPool::acquire(size_t bytes) {
+    return share(allocate(bytes), bytes);
+}
+
+std::shared_ptr<void> IPCBufferPool::share(void* block, size_t bytes) {
+    try {
+        return std::shared_ptr<void>(
+            block,
+            [bytes] (void* block) { IPCBufferPool::getInstance().release(block, bytes); },
+            IPCBufferPoolAllocator<void>());
+    } catch (...) {
+        release(block, bytes);
+        throw;
+    }
+}
+
+size_t IPCBufferPool::getCapacity(size_t bytes) {
+    size_t capacity = size_t(1) << UT_IPC_POOL_MIN_SHIFT;
+    if (bytes > (size_t(1) << UT_IPC_POOL_MAX_SHIFT)) {
+        return bytes;
+    }
+    while (capacity < bytes) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+/******************************************************************************
+ * Accessors / Mutators
+ *****************************************************************************/
+
+IPCBufferPool::Stats IPCBufferPool::getStats() const {
+    Stats stats;
+    stats.hits = mHits.load(std::memory_order_relaxed);
+    stats.misses = mMisses.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/******************************************************************************
+ * Methods (Protected)
+ *****************************************************************************/
+
+size_t IPCBufferPool::getClass(size_t bytes) {
+    size_t index = 0;
+    size_t capacity = size_t(1) << UT_IPC_POOL_MIN_SHIFT;
+    while (capacity < bytes && index < kClasses) {
+        capacity <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+IPCBufferPool::ThreadCache& IPCBufferPool::getThreadCache() {
+    thread_local ThreadCache cache;
+    return cache;
+}
+
+} // namespace UT
\ No newline at end of file
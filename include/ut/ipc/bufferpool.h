@@ -0,0 +1,149 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_BUFFER_POOL_H
+#define UT_IPC_BUFFER_POOL_H
+
+#define UT_IPC_POOL_MIN_SHIFT 6 // 64 B
+#define UT_IPC_POOL_MAX_SHIFT 22 // 4 MiB
+#define UT_IPC_POOL_THREAD_CACHE 32
+#define UT_IPC_POOL_GLOBAL_CACHE 256
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace UT {
+
+// Power of two size classes with thread-local free lists backed by a shared
+// list per class. Blocks larger than the biggest class bypass the pool
+class IPCBufferPool {
+public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+
+        double getHitRate() const;
+    }; // struct Stats
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCBufferPool(const IPCBufferPool&) = delete;
+    IPCBufferPool(IPCBufferPool&&) = delete;
+    ~IPCBufferPool();
+
+    static IPCBufferPool& getInstance();
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Returns a block of at least getCapacity(bytes) bytes, "bytes" passed to
+    // release(...) may be anything that maps to the same capacity
+    void* allocate(size_t bytes);
+    void release(void* block, size_t bytes);
+
+    // Wraps a block into a shared pointer returning it to the pool on drop,
+    // the control block is allocated from the pool as well
+    std::shared_ptr<void> acquire(size_t bytes);
+    std::shared_ptr<void> share(void* block, size_t bytes);
+
+    static size_t getCapacity(size_t bytes);
+
+    /**************************************************************************
+     * Accessors / Mutators
+     *************************************************************************/
+
+    Stats getStats() const;
+
+protected:
+    static constexpr size_t kClasses = UT_IPC_POOL_MAX_SHIFT - UT_IPC_POOL_MIN_SHIFT + 1;
+
+    struct ThreadCache;
+
+    /**************************************************************************
+     * Constructors / Destructors (Protected)
+     *************************************************************************/
+
+    IPCBufferPool() = default;
+
+    /**************************************************************************
+     * Methods (Protected)
+     *************************************************************************/
+
+    static size_t getClass(size_t bytes);
+    static ThreadCache& getThreadCache();
+
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    std::mutex mMutex;
+    std::vector<void*> mBlocks[kClasses];
+    std::atomic<uint64_t> mHits = 0;
+    std::atomic<uint64_t> mMisses = 0;
+}; // class IPCBufferPool
+
+/******************************************************************************
+ * Allocator for shared pointer control blocks
+ *****************************************************************************/
+
+template <typename T>
+class IPCBufferPoolAllocator {
+public:
+    using value_type = T;
+
+    IPCBufferPoolAllocator() = default;
+    template <typename U>
+    IPCBufferPoolAllocator(const IPCBufferPoolAllocator<U>&) { }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(IPCBufferPool::getInstance().allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* block, size_t n) {
+        IPCBufferPool::getInstance().release(block, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const IPCBufferPoolAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const IPCBufferPoolAllocator<U>&) const { return false; }
+}; // class IPCBufferPoolAllocator
+
+/******************************************************************************
+ * Inline Definition: Stats
+ *****************************************************************************/
+
+inline double IPCBufferPool::Stats::getHitRate() const {
+    return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0;
+}
+
+} // namespace UT
+
+#endif // UT_IPC_BUFFER_POOL_H
\ No newline at end of file
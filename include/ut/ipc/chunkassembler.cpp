@@ -0,0 +1,96 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#include "chunkassembler.h"
+#include "bufferpool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace UT {
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+bool IPCChunkAssembler::isChunk(const IPCFrameHeader& header) const {
+    return (header.flags & IPCFrameHeader::kPartial) || mMessages.count(header.channel);
+}
+
+bool IPCChunkAssembler::add(const IPCFrameHeader& header, const void* data, const Callback& callback) {
+    auto& message = mMessages[header.channel];
+    size_t bytes = message.bytes + header.size;
+    if (bytes > UT_IPC_FRAME_MAX_SIZE) {
+        mMessages.erase(header.channel);
+        return false;
+    }
+
+    // Grows geometrically, the total isn't known up front
+    auto& pool = IPCBufferPool::getInstance();
+    if (bytes > message.capacity) {
+        size_t capacity = IPCBufferPool::getCapacity(std::max(bytes, message.capacity * 2));
+        auto buffer = pool.acquire(capacity);
+        if (message.bytes) {
+            memcpy(buffer.get(), message.data.get(), message.bytes);
+        }
+        message.data = std::move(buffer);
+        message.capacity = capacity;
+    }
+
+    if (header.size) {
+        memcpy(static_cast<char*>(message.data.get()) + message.bytes, data, header.size);
+    }
+    message.bytes = bytes;
+
+    if (header.flags & IPCFrameHeader::kPartial) {
+        return true;
+    }
+
+    auto whole = header;
+    whole.size = static_cast<uint32_t>(bytes);
+    auto buffer = std::move(message.data);
+    mMessages.erase(header.channel);
+    callback(whole, std::move(buffer), bytes);
+
+    return true;
+}
+
+bool IPCChunkAssembler::stream(const IPCFrameHeader& header, bool& first) {
+    bool last = !(header.flags & IPCFrameHeader::kPartial);
+    first = !mStreams.count(header.channel);
+
+    if (first && !last) {
+        mStreams.insert(header.channel);
+    } else if (!first && last) {
+        mStreams.erase(header.channel);
+    }
+
+    return last;
+}
+
+void IPCChunkAssembler::reset() {
+    mMessages.clear();
+    mStreams.clear();
+}
+
+} // namespace UT
\ No newline at end of file
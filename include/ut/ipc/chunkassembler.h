@@ -0,0 +1,99 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_CHUNK_ASSEMBLER_H
+#define UT_IPC_CHUNK_ASSEMBLER_H
+
+#include "ut/ipc/common.h"
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace UT {
+
+// Joins messages sent in chunks on logical channels back together. Chunks
+// of different channels may interleave, those of a channel arrive in order
+class IPCChunkAssembler {
+public:
+    // "header" describes the whole message, kPartial cleared
+    using Callback = std::function<void(const IPCFrameHeader&, std::shared_ptr<void>, ssize_t)>;
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCChunkAssembler() = default;
+    IPCChunkAssembler(const IPCChunkAssembler&) = delete;
+    IPCChunkAssembler(IPCChunkAssembler&&) = default;
+    ~IPCChunkAssembler() = default;
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Whether the frame is a chunk: flagged partial or the last one of a
+    // message in progress on its channel
+    bool isChunk(const IPCFrameHeader& header) const;
+    // Copies the chunk behind the previous ones of its channel and invokes
+    // the callback once the message is complete. Returns false when the
+    // message grows past UT_IPC_FRAME_MAX_SIZE, it's discarded then
+    bool add(const IPCFrameHeader& header, const void* data, const Callback& callback);
+    // Streaming counterpart of add(...), nothing is buffered. Sets "first"
+    // when the frame starts a message on its channel and returns whether it
+    // completes one
+    bool stream(const IPCFrameHeader& header, bool& first);
+    void reset();
+
+    /**************************************************************************
+     * Accessors / Mutators
+     *************************************************************************/
+
+    // Channels with a streamed message in progress
+    const std::unordered_set<uint32_t>& getStreams() const;
+
+protected:
+    struct Message {
+        std::shared_ptr<void> data;
+        size_t bytes;
+        size_t capacity;
+    }; // struct Message
+
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    std::unordered_map<uint32_t, Message> mMessages; // by channel
+    std::unordered_set<uint32_t> mStreams;
+}; // class IPCChunkAssembler
+
+/******************************************************************************
+ * Inline Definition: Accessors / Mutators
+ *****************************************************************************/
+
+inline const std::unordered_set<uint32_t>& IPCChunkAssembler::getStreams() const { return mStreams; }
+
+} // namespace UT
+
+#endif // UT_IPC_CHUNK_ASSEMBLER_H
\ No newline at end of file
@@ -21,14 +21,49 @@
  *****************************************************************************/
 
 #include "client.h"
+#include "bufferpool.h"
+#include "descriptors.h"
 
+#include <algorithm>
+#include <chrono>
 #include <fcntl.h>
+#include <random>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 namespace UT {
 
+namespace {
+
+unsigned int randomize(unsigned int delay, double jitter) {
+    thread_local std::minstd_rand engine(std::random_device{}());
+    std::uniform_real_distribution<double> spread(-jitter, jitter);
+    return static_cast<unsigned int>(delay * (1 + spread(engine)));
+}
+
+int watch(const std::string& path) {
+    // The directory is watched, the socket may not exist yet
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash ? path.substr(0, slash) : "/";
+    if (inotify_add_watch(fd, directory.c_str(), IN_CREATE | IN_MOVED_TO) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+} // namespace
+
 /******************************************************************************
  * Constructors / Destructors
  *****************************************************************************/
@@ -48,7 +83,8 @@ IPCClient::RetCode IPCClient::start(const std::string& server) {
         return RetCode::kAlreadyStarted;
     }
 
-    mServerPath = UT_IPC_SOCKET_PATH + server;
+    mServerPath = mSocketPath + server;
+    mAddressLength = IPCAddress::resolve(mServerPath, mNamespace, mAddress);
 
     // Allocate buffer
     mBuffer = malloc(UT_IPC_BUFFER_SIZE);
@@ -56,43 +92,40 @@ IPCClient::RetCode IPCClient::start(const std::string& server) {
         throw std::runtime_error("malloc(...) failed, errno: " + std::to_string(errno));
     }
 
-    // Initialize pipes
-    int ret = pipe(mPipe);
-    if (ret == -1) {
-        free(mBuffer);
-        mBuffer = nullptr;
-        throw std::runtime_error("pipe(...) failed, errno: " + std::to_string(errno));
-    }
-
-    ret = fcntl(mPipe[0], F_GETFL, nullptr);
-    if (ret == -1) {
-        close(mPipe[0]);
-        close(mPipe[1]);
+    // Initialize wakeup counter
+    mEfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mEfd == -1) {
         free(mBuffer);
-        mPipe[0] = 0;
-        mPipe[1] = 0;
         mBuffer = nullptr;
-        throw std::runtime_error("fcntl(..., F_GETFL, ...) failed, errno: " + std::to_string(errno));
+        throw std::runtime_error("eventfd(...) failed, errno: " + std::to_string(errno));
     }
 
-    ret = fcntl(mPipe[0], F_SETFL, ret |= O_NONBLOCK);
-    if (ret == -1) {
-        close(mPipe[0]);
-        close(mPipe[1]);
-        free(mBuffer);
-        mPipe[0] = 0;
-        mPipe[1] = 0;
-        mBuffer = nullptr;
-        throw std::runtime_error("fcntl(..., F_SETFL, ...) failed, errno: " + std::to_string(errno));
+    // Over shared memory the socket carries no payloads
+    bool packets = mSocketType == IPCSocketType::kSeqPacket && mTransport == IPCTransport::kSocket;
+    if (packets) {
+        try {
+            mPackets = std::make_unique<IPCPacketBatch>();
+        } catch (...) {
+            close(mEfd);
+            mEfd = -1;
+            free(mBuffer);
+            mBuffer = nullptr;
+            throw;
+        }
     }
+    mQueue.setPackets(packets);
 
-    mPfds[0].fd = mPipe[0];
+    mPfds[0].fd = mEfd;
     mPfds[0].events = POLLIN;
 
+    mPfds[1].fd = -1;
     mPfds[1].events = POLLIN;
 
+    mPfds[2].fd = -1;
+    mPfds[2].events = POLLIN;
+
     mRunning = true;
-    mThread = new std::thread(&IPCClient::loop, this, mServerPath);
+    mThread = new std::thread(&IPCClient::loop, this);
 
     return RetCode::kSuccess;
 }
@@ -105,50 +138,240 @@ IPCClient::RetCode IPCClient::stop() {
     }
 
     mRunning = false;
-    onReadyChanged(mReady = false);
-    char code = '0';
-    write(mPipe[1], &code, sizeof(code));
+    mReady = false;
+    dispatchReady(false);
+    wakeUp();
     mThread->join();
     delete mThread;
     mThread = nullptr;
 
-    close(mPipe[0]);
-    close(mPipe[1]);
-    mPipe[0] = 0;
-    mPipe[1] = 0;
+    // A sender past the readiness check may have queued after the client
+    // thread cleared the queue, the next connection mustn't get it
+    clearQueue();
+
+    close(mEfd);
+    mEfd = -1;
 
     free(mBuffer);
     mBuffer = nullptr;
+    mPackets.reset();
 
     return RetCode::kSuccess;
 }
 
 void IPCClient::send(const void* data, size_t bytes) {
-    ::send(mSfd, data, bytes, 0);
+    sendDescriptors(data, bytes, {});
+}
+
+void IPCClient::sendDescriptors(const void* data, size_t bytes, const std::vector<int>& fds) {
+    if (fds.size() > UT_IPC_MAX_DESCRIPTORS) {
+        throw std::invalid_argument("too many descriptors");
+    }
+
+    if (mTransport == IPCTransport::kSharedMemory) {
+        if (bytes) {
+            sendShm({ static_cast<uint32_t>(bytes), 0, 0, 0, 0 }, data, fds);
+        }
+        return;
+    }
+
+    if (!mReady || !bytes) {
+        return;
+    }
+
+    checkPacket(bytes);
+    if (mBatchBytes && fds.empty() && mSocketType == IPCSocketType::kStream) {
+        append(nullptr, data, bytes);
+        return;
+    }
+
+    auto buffer = IPCBufferPool::getInstance().acquire(bytes);
+    memcpy(buffer.get(), data, bytes);
+    enqueue(std::move(buffer), bytes, IPCDescriptors::duplicate(fds));
+}
+
+void IPCClient::flush() {
+    bool wake = false;
+    {
+        std::unique_lock lock(mQueueMutex);
+        if (mScheduled && !mFlushing) {
+            mFlushing = true;
+            wake = true;
+        }
+    }
+
+    if (wake) {
+        wakeUp();
+    }
+}
+
+void IPCClient::sendMessage(uint32_t type, const void* data, size_t bytes) {
+    sendMessage(type, data, bytes, {});
+}
+
+void IPCClient::sendMessage(uint32_t type, const void* data, size_t bytes, const std::vector<int>& fds) {
+    sendFrame({ static_cast<uint32_t>(bytes), type, 0, 0, 0 }, data, fds);
+}
+
+void IPCClient::sendChannel(uint32_t channel, uint32_t type, const void* data, size_t bytes) {
+    if (!channel) {
+        sendMessage(type, data, bytes);
+        return;
+    }
+
+    IPCFrameHeader header = { static_cast<uint32_t>(bytes), type, 0, 0, channel };
+    if (mTransport == IPCTransport::kSharedMemory) {
+        sendShm(header, data, {});
+        return;
+    }
+
+    if (!mReady) {
+        return;
+    }
+
+    std::shared_ptr<void> buffer;
+    if (bytes) {
+        buffer = IPCBufferPool::getInstance().acquire(bytes);
+        memcpy(buffer.get(), data, bytes);
+    }
+
+    std::unique_lock lock(mQueueMutex);
+    mQueue.pushChannel(header, std::move(buffer));
+    schedule(lock);
+}
+
+void IPCClient::sendStream(uint32_t channel, uint32_t type, const void* data, size_t bytes, bool last) {
+    if (!channel) {
+        throw std::invalid_argument("streams need a logical channel");
+    }
+
+    if (!bytes && !last) {
+        return;
+    }
+
+    IPCFrameHeader header = { static_cast<uint32_t>(bytes), type, last ? 0 : IPCFrameHeader::kPartial, 0, channel };
+    if (mTransport == IPCTransport::kSharedMemory) {
+        sendShm(header, data, {});
+        return;
+    }
+
+    if (!mReady) {
+        return;
+    }
+
+    std::shared_ptr<void> buffer;
+    if (bytes) {
+        buffer = IPCBufferPool::getInstance().acquire(bytes);
+        memcpy(buffer.get(), data, bytes);
+    }
+
+    std::unique_lock lock(mQueueMutex);
+    mQueue.pushChannel(header, std::move(buffer));
+    schedule(lock);
+}
+
+/******************************************************************************
+ * Accessors / Mutators
+ *****************************************************************************/
+
+void IPCClient::setChannelPriority(uint32_t channel, int priority) {
+    std::unique_lock lock(mQueueMutex);
+    mQueue.setPriority(channel, priority);
+}
+
+void IPCClient::setChunkSize(size_t bytes) {
+    std::unique_lock lock(mQueueMutex);
+    mQueue.setChunkSize(bytes);
 }
 
 /******************************************************************************
  * Methods (Protected)
  *****************************************************************************/
 
-void IPCClient::loop(const std::string& server) {
+bool IPCClient::sendFrame(IPCFrameHeader header, const void* data, const std::vector<int>& fds) {
+    if (fds.size() > UT_IPC_MAX_DESCRIPTORS) {
+        throw std::invalid_argument("too many descriptors");
+    }
+
+    if (mTransport == IPCTransport::kSharedMemory) {
+        return sendShm(header, data, fds);
+    }
+
+    if (!mReady) {
+        return false;
+    }
+
+    if (!fds.empty()) {
+        header.flags |= IPCFrameHeader::kDescriptors;
+    }
+
+    checkPacket(sizeof(header) + header.size);
+    if (mBatchBytes && fds.empty() && mSocketType == IPCSocketType::kStream) {
+        append(&header, data, header.size);
+        return true;
+    }
+
+    // Header and payload share a single chunk of the queue
+    auto buffer = IPCBufferPool::getInstance().acquire(sizeof(header) + header.size);
+    memcpy(buffer.get(), &header, sizeof(header));
+    if (header.size) {
+        memcpy(static_cast<char*>(buffer.get()) + sizeof(header), data, header.size);
+    }
+    enqueue(std::move(buffer), sizeof(header) + header.size, IPCDescriptors::duplicate(fds));
+    return true;
+}
+
+void IPCClient::dispatchMessage(const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+    if (header.channel) {
+        onChannelMessageReceived(header.channel, header.type, std::move(data), bytes);
+    } else {
+        onMessageReceived(header.type, std::move(data), bytes);
+    }
+}
+
+void IPCClient::dispatchReady(bool ready) {
+    onReadyChanged(ready);
+}
+
+void IPCClient::dispatchCongestion(bool congested) {
+    onCongestionChanged(congested);
+}
+
+void IPCClient::loop() {
     int ret = 0;
     ssize_t bytesRead = 0;
 
-    sockaddr_un addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, server.c_str(), sizeof(addr.sun_path));
+    int inotify = -1;
+    if (mWatchSocket && mNamespace == IPCNamespace::kFilesystem) {
+        inotify = watch(mServerPath);
+    }
+
+    unsigned int backoff = mReconnectInitial;
+    bool failed = false;
 
     while (mRunning) {
-        mSfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (failed) {
+            // The socket is created by bind() before listen(), so a refused
+            // attempt right after it should be retried quickly
+            if (waitReconnect(randomize(backoff, mReconnectJitter), inotify)) {
+                backoff = mReconnectInitial;
+            } else {
+                backoff = std::min(backoff * 2, mReconnectMax);
+            }
+            failed = false;
+            continue;
+        }
+
+        mSfd = socket(AF_UNIX, mSocketType == IPCSocketType::kSeqPacket ? SOCK_SEQPACKET : SOCK_STREAM, 0);
         if (mSfd == -1) {
             throw std::runtime_error("socket(...) failed, errno: " + std::to_string(errno));
         }
 
-        ret = connect(mSfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        ret = connect(mSfd, reinterpret_cast<const sockaddr*>(&mAddress), mAddressLength);
         if (ret == -1) {
-            sleep(mReconnectTimeout);
+            close(mSfd);
+            mSfd = 0;
+            failed = true;
             continue;
         }
 
@@ -161,52 +384,184 @@ void IPCClient::loop(const std::string& server) {
         if (ret == -1) {
             throw std::runtime_error("fcntl(..., F_SETFL, ...) failed, errno: " + std::to_string(errno));
         }
-           
+
+        // The server hands out the shared memory rings right after accept
+        if (mTransport == IPCTransport::kSharedMemory) {
+            std::shared_ptr<IPCShmChannel> channel = IPCShmChannel::accept(mSfd, UT_IPC_SHM_HANDSHAKE_TIMEOUT);
+            if (!channel) {
+                close(mSfd);
+                mSfd = 0;
+                failed = true;
+                continue;
+            }
+            mPfds[2].fd = channel->getEventFd();
+            std::atomic_store(&mChannel, channel);
+        }
+
         mPfds[1].fd = mSfd;
+        backoff = mReconnectInitial;
 
-        onReadyChanged(mReady = true);
+        mReady = true;
+        dispatchReady(true);
         while (mReady) {
-            ret = poll(mPfds, 2, -1);
+            // A held back batch bounds the wait
+            timespec timeout;
+            timespec* wait = nullptr;
+            if (mDeadline != std::chrono::steady_clock::time_point()) {
+                auto left = std::max(mDeadline - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero());
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+                timeout.tv_sec = ns / 1000000000;
+                timeout.tv_nsec = ns % 1000000000;
+                wait = &timeout;
+            }
+
+            ret = ppoll(mPfds, 3, wait, nullptr);
 
             if (ret > 0) {
                 if (mPfds[0].revents & POLLIN) {
                     mPfds[0].revents = 0;
-                    read(mPipe[0], mBuffer, UT_IPC_BUFFER_SIZE);
+                    uint64_t count;
+                    read(mEfd, &count, sizeof(count));
+                    flushQueue();
+                }
+
+                if (mPfds[1].revents & POLLOUT) {
+                    mPfds[1].revents &= ~POLLOUT;
+                    flushQueue();
                 }
 
-                if (mPfds[1].revents & POLLIN) {
+                if (mPfds[2].revents & POLLIN) {
+                    mPfds[2].revents = 0;
+                    if (!receiveShm()) {
+                        disconnect();
+                    }
+                }
+
+                if (mReady && mPfds[1].revents) {
                     mPfds[1].revents = 0;
 
-                    bytesRead = 0;
-                    void* data = nullptr;
-                    while (true) {
-                        ret = recv(mPfds[1].fd, mBuffer, UT_IPC_BUFFER_SIZE, 0);
-
-                        if (ret > 0) {
-                            data = realloc(data, bytesRead + ret);
-                            bytesRead += ret;
-                            memcpy(static_cast<char*>(data) + bytesRead, mBuffer, ret);
-                        } else if (ret == 0) { // Connection closed
-                            close(mSfd);
-                            mSfd = 0;
-                            onReadyChanged(mReady = false);
-                            break;
-                        } else if (ret == -1) {
-                            if (errno != EWOULDBLOCK) {
-                                close(mSfd);
-                                mSfd = 0;
-                                onReadyChanged(mReady = false);
+                    bool closed = false;
+
+                    if (mPfds[2].fd != -1) {
+                        // Payloads arrive through the rings, only passed
+                        // descriptors and the end of the stream are expected
+                        // on the socket
+                        while (true) {
+                            std::vector<int> fds;
+                            ret = IPCDescriptors::receive(mPfds[1].fd, mBuffer, UT_IPC_BUFFER_SIZE, fds);
+                            if (!fds.empty()) {
+                                mDescriptors.push_back(std::move(fds));
+                            }
+
+                            if (ret == 0) {
+                                closed = true;
+                                break;
+                            } else if (ret == -1) {
+                                closed = errno != EWOULDBLOCK;
+                                break;
                             }
-                            break;
+                        }
+                    } else if (mPackets) {
+                        // Every packet is a whole message or frame
+                        auto callback = [this] (void* data, size_t bytes, std::vector<int>& fds) {
+                            return receivePacket(data, bytes, fds);
+                        };
+                        closed = mPackets->receive(mPfds[1].fd, callback) != IPCPacketBatch::RetCode::kSuccess;
+                    } else if (mFramed) {
+                        while (true) {
+                            // The rest of a large payload is received
+                            // straight into its destination
+                            size_t missing = 0;
+                            void* pending = mDecoder.getPending(missing);
+                            void* target = missing >= UT_IPC_BUFFER_SIZE ? pending : mBuffer;
+
+                            std::vector<int> fds;
+                            ret = IPCDescriptors::receive(mPfds[1].fd, target, target == pending ? missing : UT_IPC_BUFFER_SIZE, fds);
+                            if (!fds.empty()) {
+                                mDescriptors.push_back(std::move(fds));
+                            }
+
+                            if (ret > 0) {
+                                if (!decode(target, ret)) {
+                                    closed = true;
+                                    break;
+                                }
+                            } else if (ret == 0) { // Connection closed
+                                closed = true;
+                                break;
+                            } else if (ret == -1) {
+                                closed = errno != EWOULDBLOCK;
+                                break;
+                            }
+                        }
+                    } else if (mDataHandler) {
+                        // Handed out chunk by chunk straight from the
+                        // receive buffer
+                        while (true) {
+                            std::vector<int> fds;
+                            ret = IPCDescriptors::receive(mPfds[1].fd, mBuffer, UT_IPC_BUFFER_SIZE, fds);
+                            if (!fds.empty()) {
+                                onDescriptorsReceived(IPCDescriptors::share(std::move(fds)));
+                            }
+
+                            if (ret > 0) {
+                                mDataHandler(mBuffer, ret);
+                            } else if (ret == 0) { // Connection closed
+                                closed = true;
+                                break;
+                            } else if (ret == -1) {
+                                closed = errno != EWOULDBLOCK;
+                                break;
+                            }
+                        }
+                    } else {
+                        // Receive straight into a pooled block growing it
+                        // geometrically, so large payloads are copied a
+                        // constant number of times
+                        auto& pool = IPCBufferPool::getInstance();
+                        size_t capacity = UT_IPC_BUFFER_SIZE;
+                        void* data = pool.allocate(capacity);
+                        std::vector<int> fds;
+                        bytesRead = 0;
+
+                        while (true) {
+                            if (static_cast<size_t>(bytesRead) == capacity) {
+                                void* grown = pool.allocate(capacity * 2);
+                                memcpy(grown, data, bytesRead);
+                                pool.release(data, capacity);
+                                data = grown;
+                                capacity *= 2;
+                            }
+
+                            ret = IPCDescriptors::receive(mPfds[1].fd, static_cast<char*>(data) + bytesRead, capacity - bytesRead, fds);
+
+                            if (ret > 0) {
+                                bytesRead += ret;
+                            } else if (ret == 0) { // Connection closed
+                                closed = true;
+                                break;
+                            } else if (ret == -1) {
+                                closed = errno != EWOULDBLOCK;
+                                break;
+                            }
+                        }
+
+                        if (!fds.empty()) {
+                            onDescriptorsReceived(IPCDescriptors::share(std::move(fds)));
+                        }
+                        if (bytesRead) {
+                            onDataReceived(pool.share(data, capacity), bytesRead);
+                        } else {
+                            pool.release(data, capacity);
                         }
                     }
 
-                    if (bytesRead) {
-                        onDataReceived(std::shared_ptr<void>(data, [] (void* data) { free(data); }), bytesRead);
+                    if (closed) {
+                        disconnect();
                     }
                 }
-            } else if (ret == 0) { // No events
-                continue;
+            } else if (ret == 0) { // Batch deadline
+                flushQueue();
             } else if (ret == -1) { // Error occured
                 if (errno == EINTR) {
                     continue;
@@ -216,6 +571,443 @@ void IPCClient::loop(const std::string& server) {
             }
         }
     }
+
+    if (inotify != -1) {
+        close(inotify);
+    }
+
+    if (mPfds[1].fd != -1) {
+        close(mSfd);
+        mSfd = 0;
+        mPfds[1].fd = -1;
+        mPfds[1].events = POLLIN;
+        mDecoder.reset();
+        abortStreams();
+    }
+
+    if (mPfds[2].fd != -1) {
+        mChannel->close();
+        std::atomic_store(&mChannel, std::shared_ptr<IPCShmChannel>());
+        mPfds[2].fd = -1;
+    }
+
+    for (auto& fds : mDescriptors) {
+        IPCDescriptors::close(fds);
+    }
+    mDescriptors.clear();
+
+    mDeadline = std::chrono::steady_clock::time_point();
+    clearQueue();
+}
+
+bool IPCClient::waitReconnect(unsigned int timeout, int inotify) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    pollfd pfds[2] = { { mEfd, POLLIN, 0 }, { inotify, POLLIN, 0 } };
+
+    while (mRunning) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) {
+            return false;
+        }
+
+        int ret = poll(pfds, inotify != -1 ? 2 : 1, static_cast<int>(left));
+        if (ret == -1 && errno != EINTR) {
+            throw std::runtime_error("poll(...) failed, errno: " + std::to_string(errno));
+        }
+
+        // Nothing is queued while disconnected, so it's stop()
+        if (pfds[0].revents & POLLIN) {
+            uint64_t count;
+            read(mEfd, &count, sizeof(count));
+        }
+
+        if (pfds[1].revents & POLLIN) {
+            // Other entries of the directory come and go as well
+            std::string name = mServerPath.substr(mServerPath.rfind('/') + 1);
+            alignas(inotify_event) char buffer[4096];
+            bool created = false;
+            ssize_t bytes;
+            while ((bytes = read(inotify, buffer, sizeof(buffer))) > 0) {
+                for (char* it = buffer; it < buffer + bytes; ) {
+                    auto event = reinterpret_cast<inotify_event*>(it);
+                    if (event->len && name == event->name) {
+                        created = true;
+                    }
+                    it += sizeof(inotify_event) + event->len;
+                }
+            }
+
+            if (created) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool IPCClient::receivePacket(void* data, size_t bytes, std::vector<int>& fds) {
+    if (mFramed) {
+        if (!fds.empty()) {
+            mDescriptors.push_back(std::move(fds));
+        }
+        return decode(data, bytes);
+    }
+
+    if (!fds.empty()) {
+        onDescriptorsReceived(IPCDescriptors::share(std::move(fds)));
+    }
+
+    // Slots are reused by the next batch, so the packet is copied into a
+    // block of its exact size unless a direct handler borrows it
+    if (mDataHandler) {
+        mDataHandler(data, bytes);
+    } else {
+        auto buffer = IPCBufferPool::getInstance().acquire(bytes);
+        memcpy(buffer.get(), data, bytes);
+        onDataReceived(std::move(buffer), bytes);
+    }
+
+    return true;
+}
+
+bool IPCClient::decode(const void* chunk, size_t size) {
+    // Chunks of channel messages are joined before being dispatched
+    bool valid = true;
+    auto dispatch = [this] (const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+        dispatchMessage(header, std::move(data), bytes);
+    };
+
+    if (mMessageHandler) {
+        auto view = [this, &valid, &dispatch] (const IPCFrameHeader& header, const void* data, size_t bytes) {
+            if (header.flags & IPCFrameHeader::kDescriptors) {
+                dispatchDescriptors();
+            }
+            if (header.channel && mStreamHandler.chunk) {
+                dispatchStream(header, data, bytes);
+            } else if (mChunks.isChunk(header)) {
+                valid = mChunks.add(header, data, dispatch) && valid;
+            } else if (header.channel) {
+                std::shared_ptr<void> buffer;
+                if (bytes) {
+                    buffer = IPCBufferPool::getInstance().acquire(bytes);
+                    memcpy(buffer.get(), data, bytes);
+                }
+                dispatchMessage(header, std::move(buffer), bytes);
+            } else {
+                mMessageHandler(header.type, data, bytes);
+            }
+        };
+
+        return mDecoder.decodeView(chunk, size, view) == IPCFrameDecoder::RetCode::kSuccess && valid;
+    }
+
+    auto callback = [this, &valid, &dispatch] (const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+        if (header.flags & IPCFrameHeader::kDescriptors) {
+            dispatchDescriptors();
+        }
+        if (header.channel && mStreamHandler.chunk) {
+            dispatchStream(header, data.get(), bytes);
+        } else if (mChunks.isChunk(header)) {
+            valid = mChunks.add(header, data.get(), dispatch) && valid;
+        } else {
+            dispatchMessage(header, std::move(data), bytes);
+        }
+    };
+
+    IPCFrameDecoder::Provider provider;
+    if (mBufferProvider) {
+        provider = [this] (const IPCFrameHeader& header) {
+            // Chunks are copied into their message or streamed anyway
+            bool chunk = mChunks.isChunk(header) || (header.channel && mStreamHandler.chunk);
+            return chunk ? nullptr : mBufferProvider(header);
+        };
+    }
+
+    return mDecoder.decode(chunk, size, callback, provider) == IPCFrameDecoder::RetCode::kSuccess && valid;
+}
+
+void IPCClient::checkPacket(size_t bytes) const {
+    if (mSocketType == IPCSocketType::kSeqPacket && mTransport == IPCTransport::kSocket && bytes > UT_IPC_PACKET_MAX_SIZE) {
+        throw std::length_error("message exceeds the packet size limit");
+    }
+}
+
+bool IPCClient::receiveShm() {
+    // Records are borrowed from the ring, so they are copied into pooled or
+    // provided buffers before being handed to the event loop
+    auto& pool = IPCBufferPool::getInstance();
+    bool valid = true;
+    auto dispatch = [this] (const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+        dispatchMessage(header, std::move(data), bytes);
+    };
+
+    auto ret = mChannel->read([this, &pool, &valid, &dispatch] (const IPCFrameHeader& header, const void* data, size_t bytes) {
+        if (header.flags & IPCFrameHeader::kDescriptors) {
+            dispatchDescriptors();
+        }
+
+        // Streamed pieces are written as separate records
+        if (mFramed && header.channel && mStreamHandler.chunk) {
+            dispatchStream(header, data, bytes);
+            return;
+        } else if (mFramed && mChunks.isChunk(header)) {
+            valid = mChunks.add(header, data, dispatch) && valid;
+            return;
+        }
+
+        // Direct handlers borrow the record in place
+        if (mFramed && mMessageHandler && !header.channel) {
+            mMessageHandler(header.type, data, bytes);
+            return;
+        } else if (!mFramed && mDataHandler) {
+            if (bytes) {
+                mDataHandler(data, bytes);
+            }
+            return;
+        }
+
+        std::shared_ptr<void> buffer;
+        if (bytes) {
+            if (mFramed && mBufferProvider) {
+                buffer = mBufferProvider(header);
+            }
+            if (!buffer) {
+                buffer = pool.acquire(bytes);
+            }
+            memcpy(buffer.get(), data, bytes);
+        }
+
+        if (mFramed) {
+            dispatchMessage(header, std::move(buffer), bytes);
+        } else if (bytes) {
+            onDataReceived(std::move(buffer), bytes);
+        }
+    });
+
+    return ret == IPCShmChannel::RetCode::kSuccess && valid;
+}
+
+bool IPCClient::sendShm(const IPCFrameHeader& header, const void* data, const std::vector<int>& fds) {
+    auto channel = std::atomic_load(&mChannel);
+    if (!channel) {
+        return false;
+    }
+
+    auto ret = channel->write(header, data, fds);
+    if (ret == IPCShmChannel::RetCode::kTooLarge) {
+        throw std::length_error("message exceeds the shared memory ring capacity");
+    }
+    return ret == IPCShmChannel::RetCode::kSuccess;
+}
+
+void IPCClient::dispatchDescriptors() {
+    // Over shared memory the group is sent before its record is published,
+    // so when the socket hasn't been drained yet it's already waiting there
+    if (mDescriptors.empty() && mPfds[2].fd != -1) {
+        std::vector<int> fds;
+        char marker;
+        while (IPCDescriptors::receive(mSfd, &marker, sizeof(marker), fds) == -1 && errno == EINTR) { }
+        if (!fds.empty()) {
+            mDescriptors.push_back(std::move(fds));
+        }
+    }
+
+    if (mDescriptors.empty()) {
+        return;
+    }
+
+    auto fds = std::move(mDescriptors.front());
+    mDescriptors.pop_front();
+    onDescriptorsReceived(IPCDescriptors::share(std::move(fds)));
+}
+
+void IPCClient::dispatchStream(const IPCFrameHeader& header, const void* data, size_t bytes) {
+    bool first;
+    bool last = mChunks.stream(header, first);
+
+    if (first && mStreamHandler.begin) {
+        mStreamHandler.begin(header.channel, header.type);
+    }
+    if (bytes) {
+        mStreamHandler.chunk(header.channel, data, bytes);
+    }
+    if (last && mStreamHandler.end) {
+        mStreamHandler.end(header.channel, true);
+    }
+}
+
+void IPCClient::abortStreams() {
+    if (mStreamHandler.end) {
+        for (auto channel : mChunks.getStreams()) {
+            mStreamHandler.end(channel, false);
+        }
+    }
+    mChunks.reset();
+}
+
+void IPCClient::enqueue(std::shared_ptr<void> data, size_t bytes, std::vector<int> fds) {
+    std::unique_lock lock(mQueueMutex);
+    mQueue.push(std::move(data), bytes, std::move(fds));
+    schedule(lock);
+}
+
+void IPCClient::append(const IPCFrameHeader* header, const void* data, size_t bytes) {
+    std::unique_lock lock(mQueueMutex);
+    if (header) {
+        mQueue.append(header, sizeof(*header), mBatchBytes);
+    }
+    mQueue.append(data, bytes, mBatchBytes);
+    schedule(lock);
+}
+
+void IPCClient::schedule(std::unique_lock<std::mutex>& lock) {
+    // One wakeup per burst, everything queued until the loop gets to it
+    // leaves in a single sendmsg(...). A batch takes a second one once it
+    // reaches its threshold
+    bool wake = false;
+    if (!mScheduled) {
+        mScheduled = true;
+        wake = true;
+        if (mBatchBytes) {
+            mBatchStart = std::chrono::steady_clock::now();
+        }
+    } else if (mBatchBytes && !mFlushing && mQueue.getBytes() >= mBatchBytes) {
+        mFlushing = true;
+        wake = true;
+    }
+
+    bool congested = false;
+    if (!mCongested && mQueue.getBytes() > mHighWatermark) {
+        mCongested = true;
+        congested = true;
+    }
+    lock.unlock();
+
+    if (congested) {
+        reportCongestion();
+    }
+
+    if (wake) {
+        wakeUp();
+    }
+}
+
+void IPCClient::wakeUp() {
+    uint64_t count = 1;
+    write(mEfd, &count, sizeof(count));
+}
+
+void IPCClient::flushQueue() {
+    if (!mReady || mPfds[2].fd != -1) {
+        return;
+    }
+
+    IPCSendQueue::RetCode ret;
+    bool recovered = false;
+    {
+        std::unique_lock lock(mQueueMutex);
+
+        // Held back until the threshold, the deadline or flush()
+        if (mBatchBytes && mScheduled && !mFlushing && mQueue.getBytes() < mBatchBytes) {
+            auto deadline = mBatchStart + std::chrono::microseconds(mBatchDelay);
+            if (std::chrono::steady_clock::now() < deadline) {
+                mDeadline = deadline;
+                return;
+            }
+        }
+        mDeadline = std::chrono::steady_clock::time_point();
+
+        ret = mQueue.flush(mSfd);
+
+        // Stays scheduled and released until POLLOUT drains the rest
+        if (ret != IPCSendQueue::RetCode::kPending) {
+            mScheduled = false;
+            mFlushing = false;
+        } else {
+            mFlushing = true;
+        }
+
+        if (mCongested && mQueue.getBytes() <= mLowWatermark) {
+            mCongested = false;
+            recovered = true;
+        }
+    }
+
+    if (ret == IPCSendQueue::RetCode::kPending) {
+        mPfds[1].events = POLLIN | POLLOUT;
+    } else {
+        mPfds[1].events = POLLIN;
+    }
+
+    if (recovered) {
+        reportCongestion();
+    }
+
+    if (ret == IPCSendQueue::RetCode::kFailed) {
+        disconnect();
+    }
+}
+
+void IPCClient::reportCongestion() {
+    // Senders and the client thread change the state concurrently, raising
+    // it from one thread at a time keeps the last event current
+    std::unique_lock lock(mQueueMutex);
+    if (mReporting) {
+        return;
+    }
+
+    mReporting = true;
+    while (mReported != mCongested) {
+        bool congested = mReported = mCongested;
+        lock.unlock();
+        dispatchCongestion(congested);
+        lock.lock();
+    }
+    mReporting = false;
+}
+
+void IPCClient::disconnect() {
+    close(mSfd);
+    mSfd = 0;
+    mPfds[1].fd = -1;
+    mPfds[1].events = POLLIN;
+    mDecoder.reset();
+    abortStreams();
+    mDeadline = std::chrono::steady_clock::time_point();
+
+    for (auto& fds : mDescriptors) {
+        IPCDescriptors::close(fds);
+    }
+    mDescriptors.clear();
+
+    if (mPfds[2].fd != -1) {
+        mChannel->close();
+        std::atomic_store(&mChannel, std::shared_ptr<IPCShmChannel>());
+        mPfds[2].fd = -1;
+    }
+
+    // Whatever is left was meant for the previous connection
+    clearQueue();
+
+    mReady = false;
+    dispatchReady(false);
+}
+
+void IPCClient::clearQueue() {
+    bool recovered = false;
+    {
+        std::unique_lock lock(mQueueMutex);
+        mQueue.clear();
+        mScheduled = false;
+        mFlushing = false;
+        recovered = mCongested;
+        mCongested = false;
+    }
+
+    if (recovered) {
+        reportCongestion();
+    }
 }
 
 } // namespace UT
\ No newline at end of file
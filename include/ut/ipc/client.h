@@ -23,10 +23,23 @@
 #ifndef UT_IPC_CLIENT_H
 #define UT_IPC_CLIENT_H
 
-#define UT_IPC_RECONNECT_TIMEOUT 10
+#define UT_IPC_RECONNECT_INITIAL 10 // ms
+#define UT_IPC_RECONNECT_MAX 1000 // ms
+// Deprecated, the same in seconds, see setReconnectTimeout(...)
+#define UT_IPC_RECONNECT_TIMEOUT (UT_IPC_RECONNECT_MAX / 1000)
+#define UT_IPC_RECONNECT_JITTER 0.2
+#define UT_IPC_BATCH_DELAY 100 // us
 
+#include "ut/ipc/address.h"
+#include "ut/ipc/chunkassembler.h"
 #include "ut/ipc/common.h"
+#include "ut/ipc/framedecoder.h"
+#include "ut/ipc/packetbatch.h"
+#include "ut/ipc/sendqueue.h"
+#include "ut/ipc/shmchannel.h"
 
+#include <chrono>
+#include <deque>
 #include <poll.h>
 #include <ut/core/event.h>
 
@@ -36,6 +49,19 @@ class IPCClient {
 public:
     enum class RetCode;
 
+    // Direct handlers, see setDataHandler(...)
+    using DataHandler = std::function<void(const void*, size_t)>;
+    using MessageHandler = std::function<void(uint32_t, const void*, size_t)>;
+    // Destination of a frame's payload, see setBufferProvider(...)
+    using BufferProvider = IPCFrameDecoder::Provider;
+
+    // Streaming receive, see setStreamHandler(...)
+    struct StreamHandler {
+        std::function<void(uint32_t, uint32_t)> begin; // channel, type
+        std::function<void(uint32_t, const void*, size_t)> chunk; // channel, data
+        std::function<void(uint32_t, bool)> end; // channel, complete
+    }; // struct StreamHandler
+
     /**************************************************************************
      * Constructors / Destructors
      *************************************************************************/
@@ -43,15 +69,31 @@ public:
     IPCClient() = default;
     IPCClient(const IPCClient&) = delete;
     IPCClient(IPCClient&&) = delete;
-    ~IPCClient();
+    virtual ~IPCClient();
 
     /**************************************************************************
      * Methods
      *************************************************************************/
 
     void send(const void* data, size_t bytes);
+    // Passes "fds" along with the data, the caller keeps ownership of them
+    void sendDescriptors(const void* data, size_t bytes, const std::vector<int>& fds);
+    void sendMessage(uint32_t type, const void* data, size_t bytes);
+    void sendMessage(uint32_t type, const void* data, size_t bytes, const std::vector<int>& fds);
+    // Queues the message on logical channel "channel", 0 is the same as
+    // sendMessage(...). See setChannelPriority(...)
+    void sendChannel(uint32_t channel, uint32_t type, const void* data, size_t bytes);
+    // Streaming send: a message of any size goes out on logical channel
+    // "channel" (not 0) piece by piece, "last" completes it. Pieces are
+    // copied and queued like channel messages, so memory stays bounded as
+    // long as the caller holds off while the server is congested. One
+    // message at a time per channel
+    void sendStream(uint32_t channel, uint32_t type, const void* data, size_t bytes, bool last);
+    // Connects to getSocketPath() + "server"
     RetCode start(const std::string& server);
     RetCode stop();
+    // Sends data held back by batching right away
+    void flush();
 
     /**************************************************************************
      * Accessors / Mutators
@@ -59,37 +101,204 @@ public:
 
     bool getReady() const;
 
+    // Takes effect on the next start()
+    bool getFramed() const;
+    void setFramed(bool framed);
+
+    // Takes effect on the next start(), has to match the server
+    IPCTransport getTransport() const;
+    void setTransport(IPCTransport transport);
+
+    // Prefix of endpoint names, UT_IPC_SOCKET_PATH by default. Takes effect
+    // on the next start(), has to match the server
+    const std::string& getSocketPath() const;
+    void setSocketPath(const std::string& path);
+
+    // Takes effect on the next start(), has to match the server
+    IPCNamespace getNamespace() const;
+    void setNamespace(IPCNamespace ns);
+
+    // Takes effect on the next start(), has to match the server
+    IPCSocketType getSocketType() const;
+    void setSocketType(IPCSocketType type);
+
+    // The delay between failed connection attempts doubles from "initial"
+    // up to "max" milliseconds, each one randomized by +-"jitter" (0 - 1)
+    // so clients of a restarted server don't all retry at once. A lost
+    // connection is retried right away
+    unsigned int getReconnectInitial() const;
+    unsigned int getReconnectMax() const;
+    double getReconnectJitter() const;
+    void setReconnectBackoff(unsigned int initial, unsigned int max, double jitter);
+
+    // Fixed delay in seconds, same as setReconnectBackoff(timeout * 1000,
+    // timeout * 1000, 0)
     unsigned int getReconnectTimeout() const;
     void setReconnectTimeout(unsigned int timeout);
 
+    // Filesystem namespace only: watches the directory of the socket with
+    // inotify while backing off, so the client connects as soon as the
+    // server binds. Takes effect on the next start()
+    bool getWatchSocket() const;
+    void setWatchSocket(bool watch);
+
+    // Queued bytes above which the server is reported as congested and below
+    // which it's reported as recovered
+    size_t getLowWatermark() const;
+    size_t getHighWatermark() const;
+    void setWatermarks(size_t low, size_t high);
+
+    // Opt-in batching: sends are copied back to back into shared blocks and
+    // held until "bytes" are queued or the oldest one waited "delay"
+    // microseconds, see flush(). Amortizes the syscall and the allocation
+    // over many small messages at the cost of that much latency. 0 bytes
+    // sends right away. Messages with descriptors or over SOCK_SEQPACKET
+    // are held as well but keep a chunk of their own
+    size_t getBatchBytes() const;
+    unsigned int getBatchDelay() const;
+    void setBatching(size_t bytes, unsigned int delay = UT_IPC_BATCH_DELAY);
+
+    // Framed mode only: logical channels multiplex independent streams of
+    // messages over the connection. A message sent on a channel is cut into
+    // chunks of getChunkSize() bytes only as the socket drains, interleaved
+    // with the other channels by priority (higher first, 0 by default), so
+    // small urgent messages aren't stuck behind bulk transfers. Channel 0 is
+    // plain sendMessage(...) and goes ahead of every queued chunk. Over
+    // shared memory channel messages are written whole
+    int getChannelPriority(uint32_t channel) const;
+    void setChannelPriority(uint32_t channel, int priority);
+    size_t getChunkSize() const;
+    void setChunkSize(size_t bytes);
+
+    // Replace onDataReceived / onMessageReceived (and dispatchMessage(...))
+    // with a call on the client thread, "data" borrowed for the duration of
+    // the call only. Messages on logical channels still take the events.
+    // Must not call stop(). Takes effect on the next start()
+    void setDataHandler(DataHandler handler);
+    void setMessageHandler(MessageHandler handler);
+
+    // Framed mode only: messages on logical channels are handed over on the
+    // client thread as they arrive instead of being joined first. begin(...)
+    // comes with the first chunk, chunk(...) with every piece of payload,
+    // borrowed for the call only and at most the sender's chunk size (piece
+    // size over shared memory), end(...) once the message is complete or the
+    // connection was lost. Memory stays bounded whatever the message size,
+    // UT_IPC_FRAME_MAX_SIZE doesn't apply to the whole. Must not call stop().
+    // Takes effect on the next start()
+    void setStreamHandler(StreamHandler handler);
+
+    // Framed mode only: called on the client thread once a frame's header
+    // arrived, the payload is received straight into the returned buffer
+    // (header.size bytes) and handed to onMessageReceived as is. nullptr
+    // falls back to a pooled block. Unused with a message handler. Takes
+    // effect on the next start()
+    void setBufferProvider(BufferProvider provider);
+
     /**************************************************************************
      * Events
      *************************************************************************/
 
     Event<bool> onReadyChanged;
     Event<std::shared_ptr<void>, ssize_t> onDataReceived;
+    Event<uint32_t, std::shared_ptr<void>, ssize_t> onMessageReceived;
+    // Channel and type of messages sent with sendChannel(...)
+    Event<uint32_t, uint32_t, std::shared_ptr<void>, ssize_t> onChannelMessageReceived;
+    Event<bool> onCongestionChanged;
+    // Fired right before the data or message the descriptors came with
+    Event<std::shared_ptr<const std::vector<int>>> onDescriptorsReceived;
 
 protected:
     /**************************************************************************
      * Methods (Protected)
      *************************************************************************/
 
-    void loop(const std::string& server);
+    // Returns false when the frame was dropped, the client not being
+    // connected
+    bool sendFrame(IPCFrameHeader header, const void* data, const std::vector<int>& fds);
+    // Called on the client thread for every complete frame
+    virtual void dispatchMessage(const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes);
+    // Called on the client thread when the connection is established or
+    // lost, and on the caller's in stop()
+    virtual void dispatchReady(bool ready);
+    // Called by one thread at a time, the sending or the client thread
+    virtual void dispatchCongestion(bool congested);
+    // Called on the client thread when the connection is lost
+    virtual void disconnect();
+    void loop();
+    // Sleeps "timeout" milliseconds unless stop() or the server's socket
+    // showing up cuts it short, returns true in the latter case
+    bool waitReconnect(unsigned int timeout, int inotify);
+    bool receivePacket(void* data, size_t bytes, std::vector<int>& fds);
+    bool decode(const void* chunk, size_t size);
+    // Throws when a message would not fit into a single packet
+    void checkPacket(size_t bytes) const;
+    // Returns false when the peer has to be dropped
+    bool receiveShm();
+    // Returns false when the record was dropped
+    bool sendShm(const IPCFrameHeader& header, const void* data, const std::vector<int>& fds);
+    void dispatchDescriptors();
+    void dispatchStream(const IPCFrameHeader& header, const void* data, size_t bytes);
+    // Ends the streamed messages in progress as incomplete
+    void abortStreams();
+    void enqueue(std::shared_ptr<void> data, size_t bytes, std::vector<int> fds = {});
+    // Batching only, copies the header (optional) and the data into the
+    // queue
+    void append(const IPCFrameHeader* header, const void* data, size_t bytes);
+    // Wakes the loop up for what was just queued, releases "lock"
+    void schedule(std::unique_lock<std::mutex>& lock);
+    void wakeUp();
+    void flushQueue();
+    // Raises onCongestionChanged until it caught up with mCongested
+    void reportCongestion();
+    // Drops what was queued for the connection that's gone
+    void clearQueue();
 
     /**************************************************************************
      * Members
      *************************************************************************/
 
+    bool mFramed = false;
     bool mReady = false;
     bool mRunning = false;
-    int mPipe[2];
+    int mEfd = -1;
     int mSfd = 0;
-    pollfd mPfds[2];
+    pollfd mPfds[3];
     std::mutex mMutex;
     std::string mServerPath;
+    std::string mSocketPath = UT_IPC_SOCKET_PATH;
+    IPCNamespace mNamespace = IPCNamespace::kFilesystem;
+    sockaddr_un mAddress;
+    socklen_t mAddressLength = 0;
     std::thread* mThread = nullptr;
-    unsigned int mReconnectTimeout = UT_IPC_RECONNECT_TIMEOUT;
+    unsigned int mReconnectInitial = UT_IPC_RECONNECT_INITIAL;
+    unsigned int mReconnectMax = UT_IPC_RECONNECT_MAX;
+    double mReconnectJitter = UT_IPC_RECONNECT_JITTER;
+    bool mWatchSocket = false;
     void* mBuffer = nullptr;
+    IPCFrameDecoder mDecoder;
+    IPCChunkAssembler mChunks;
+    IPCTransport mTransport = IPCTransport::kSocket;
+    IPCSocketType mSocketType = IPCSocketType::kStream;
+    std::unique_ptr<IPCPacketBatch> mPackets; // SOCK_SEQPACKET sockets only
+    std::shared_ptr<IPCShmChannel> mChannel;
+    std::deque<std::vector<int>> mDescriptors; // waiting for their frame
+    size_t mLowWatermark = UT_IPC_LOW_WATERMARK;
+    size_t mHighWatermark = UT_IPC_HIGH_WATERMARK;
+    std::mutex mQueueMutex; // guards the send queue state below
+    IPCSendQueue mQueue;
+    bool mScheduled = false;
+    bool mCongested = false;
+    bool mReported = false; // last state raised by onCongestionChanged
+    bool mReporting = false;
+    bool mFlushing = false; // batch released by its threshold or flush()
+    std::chrono::steady_clock::time_point mBatchStart; // oldest held send
+    size_t mBatchBytes = 0;
+    unsigned int mBatchDelay = UT_IPC_BATCH_DELAY;
+    std::chrono::steady_clock::time_point mDeadline; // of a held batch, loop only
+    DataHandler mDataHandler;
+    MessageHandler mMessageHandler;
+    StreamHandler mStreamHandler;
+    BufferProvider mBufferProvider;
 }; // class IPCClient
 
 enum class IPCClient::RetCode {
@@ -104,8 +313,48 @@ enum class IPCClient::RetCode {
 
 inline bool IPCClient::getReady() const { return mReady; }
 
-inline unsigned int IPCClient::getReconnectTimeout() const { return mReconnectTimeout; }
-inline void IPCClient::setReconnectTimeout(unsigned int timeout) { mReconnectTimeout = timeout; }
+inline bool IPCClient::getFramed() const { return mFramed; }
+inline void IPCClient::setFramed(bool framed) { mFramed = framed; }
+
+inline IPCTransport IPCClient::getTransport() const { return mTransport; }
+inline void IPCClient::setTransport(IPCTransport transport) { mTransport = transport; }
+
+inline const std::string& IPCClient::getSocketPath() const { return mSocketPath; }
+inline void IPCClient::setSocketPath(const std::string& path) { mSocketPath = path; }
+
+inline IPCNamespace IPCClient::getNamespace() const { return mNamespace; }
+inline void IPCClient::setNamespace(IPCNamespace ns) { mNamespace = ns; }
+
+inline IPCSocketType IPCClient::getSocketType() const { return mSocketType; }
+inline void IPCClient::setSocketType(IPCSocketType type) { mSocketType = type; }
+
+inline unsigned int IPCClient::getReconnectInitial() const { return mReconnectInitial; }
+inline unsigned int IPCClient::getReconnectMax() const { return mReconnectMax; }
+inline double IPCClient::getReconnectJitter() const { return mReconnectJitter; }
+inline void IPCClient::setReconnectBackoff(unsigned int initial, unsigned int max, double jitter) { mReconnectInitial = initial; mReconnectMax = max; mReconnectJitter = jitter; }
+
+inline unsigned int IPCClient::getReconnectTimeout() const { return mReconnectMax / 1000; }
+inline void IPCClient::setReconnectTimeout(unsigned int timeout) { setReconnectBackoff(timeout * 1000, timeout * 1000, 0); }
+
+inline bool IPCClient::getWatchSocket() const { return mWatchSocket; }
+inline void IPCClient::setWatchSocket(bool watch) { mWatchSocket = watch; }
+
+inline size_t IPCClient::getLowWatermark() const { return mLowWatermark; }
+inline size_t IPCClient::getHighWatermark() const { return mHighWatermark; }
+inline void IPCClient::setWatermarks(size_t low, size_t high) { mLowWatermark = low; mHighWatermark = high; }
+
+inline size_t IPCClient::getBatchBytes() const { return mBatchBytes; }
+inline unsigned int IPCClient::getBatchDelay() const { return mBatchDelay; }
+inline void IPCClient::setBatching(size_t bytes, unsigned int delay) { mBatchBytes = bytes; mBatchDelay = delay; }
+
+inline int IPCClient::getChannelPriority(uint32_t channel) const { return mQueue.getPriority(channel); }
+inline size_t IPCClient::getChunkSize() const { return mQueue.getChunkSize(); }
+
+inline void IPCClient::setDataHandler(DataHandler handler) { mDataHandler = std::move(handler); }
+inline void IPCClient::setMessageHandler(MessageHandler handler) { mMessageHandler = std::move(handler); }
+inline void IPCClient::setStreamHandler(StreamHandler handler) { mStreamHandler = std::move(handler); }
+
+inline void IPCClient::setBufferProvider(BufferProvider provider) { mBufferProvider = std::move(provider); }
 
 } // namespace UT
 
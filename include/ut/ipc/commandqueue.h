@@ -0,0 +1,125 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+#ifndef UT_IPC_COMMAND_QUEUE_H
+#define UT_IPC_COMMAND_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace UT {
+
+// Lock-free multi-producer single-consumer queue. Producers push onto an
+// intrusive stack with a single CAS, the consumer takes the whole stack with
+// one exchange and replays it oldest first, so a burst of commands costs the
+// consumer one atomic operation
+template <typename T>
+class IPCCommandQueue {
+public:
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCCommandQueue() = default;
+    IPCCommandQueue(const IPCCommandQueue&) = delete;
+    IPCCommandQueue(IPCCommandQueue&&) = delete;
+    ~IPCCommandQueue();
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Returns true when the queue was empty, only then the consumer needs a
+    // wakeup since it drains everything queued until it gets to it
+    bool push(T value);
+    // Consumer only, calls "handler" for every queued command oldest first
+    template <typename Handler>
+    void drain(Handler&& handler);
+
+protected:
+    struct Node {
+        T value;
+        Node* next;
+    }; // struct Node
+
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    std::atomic<Node*> mHead = nullptr;
+}; // class IPCCommandQueue
+
+/******************************************************************************
+ * Inline Definition: Constructors / Destructors
+ *****************************************************************************/
+
+template <typename T>
+IPCCommandQueue<T>::~IPCCommandQueue() {
+    Node* node = mHead.exchange(nullptr, std::memory_order_acquire);
+    while (node) {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+/******************************************************************************
+ * Inline Definition: Methods
+ *****************************************************************************/
+
+template <typename T>
+bool IPCCommandQueue<T>::push(T value) {
+    // The node belongs to the consumer once published, so the previous head
+    // is kept aside instead of being read back from it
+    Node* expected = mHead.load(std::memory_order_relaxed);
+    Node* node = new Node { std::move(value), expected };
+    while (!mHead.compare_exchange_weak(expected, node, std::memory_order_release, std::memory_order_relaxed)) {
+        node->next = expected;
+    }
+    return expected == nullptr;
+}
+
+template <typename T>
+template <typename Handler>
+void IPCCommandQueue<T>::drain(Handler&& handler) {
+    Node* node = mHead.exchange(nullptr, std::memory_order_acquire);
+
+    // Newest first on the stack, reversed into arrival order
+    Node* ordered = nullptr;
+    while (node) {
+        Node* next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+
+    while (ordered) {
+        Node* next = ordered->next;
+        handler(ordered->value);
+        delete ordered;
+        ordered = next;
+    }
+}
+
+} // namespace UT
+
+#endif // UT_IPC_COMMAND_QUEUE_H
\ No newline at end of file
@@ -25,5 +25,89 @@
 
 #define UT_IPC_BUFFER_SIZE 4096
 #define UT_IPC_SOCKET_PATH "/tmp/ut.ipc."
+#define UT_IPC_FRAME_MAX_SIZE (64 * 1024 * 1024)
+#define UT_IPC_LOW_WATERMARK (256 * 1024)
+#define UT_IPC_HIGH_WATERMARK (4 * 1024 * 1024)
+#define UT_IPC_MAX_DESCRIPTORS 16
+#define UT_IPC_PACKET_MAX_SIZE (64 * 1024)
+
+#include <cstdint>
+
+namespace UT {
+
+/******************************************************************************
+ * Transport
+ *****************************************************************************/
+
+enum class IPCTransport {
+    kSocket,
+    // Payloads go through shared memory rings, the socket is only used for
+    // the handshake and to track the peer, both sides have to select it
+    kSharedMemory
+}; // enum class IPCTransport
+
+enum class IPCSocketType {
+    kStream,
+    // Keeps message boundaries, so unframed data arrives exactly as sent and
+    // frames never have to be reassembled. Messages are limited to
+    // UT_IPC_PACKET_MAX_SIZE bytes, both sides have to select it
+    kSeqPacket
+}; // enum class IPCSocketType
+
+enum class IPCNamespace {
+    // Socket inode at the path, recreated by every IPCServer::start()
+    kFilesystem,
+    // Linux abstract namespace: nothing to look up, clean up or contend for
+    // on the filesystem, the name goes away with the listening socket. Both
+    // sides have to select it
+    kAbstract
+}; // enum class IPCNamespace
+
+/******************************************************************************
+ * Clients
+ *****************************************************************************/
+
+// Identifies a client of an IPCServer while it's connected: a slot index and
+// the registry shard holding the slot in the low 32 bits, below the slot's
+// generation, never 0
+using IPCClientId = uint64_t;
+
+/******************************************************************************
+ * Framing
+ *****************************************************************************/
+
+// Header preceding every message when framing is enabled, the payload of
+// "size" bytes follows immediately after it
+struct IPCFrameHeader {
+    // File descriptors were passed along with the frame
+    static constexpr uint32_t kDescriptors = 0x1;
+    // RPC call, "type" is the method
+    static constexpr uint32_t kRequest = 0x2;
+    // RPC result, "type" is the IPCRpcStatus
+    static constexpr uint32_t kResponse = 0x4;
+    // More chunks of the message follow on the same channel, the frame
+    // without it completes the message
+    static constexpr uint32_t kPartial = 0x8;
+
+    uint32_t size;
+    uint32_t type;
+    uint32_t flags;
+    uint32_t id; // pairs RPC responses with their requests, 0 otherwise
+    uint32_t channel; // logical channel, 0 for plain messages
+}; // struct IPCFrameHeader
+
+/******************************************************************************
+ * RPC
+ *****************************************************************************/
+
+enum class IPCRpcStatus : uint32_t {
+    kSuccess,
+    kFailed, // the payload is the error message
+    kUnknownMethod,
+    kTimeout,
+    kDisconnected
+}; // enum class IPCRpcStatus
+
+} // namespace UT
 
 #endif // UT_IPC_COMMON_H
\ No newline at end of file
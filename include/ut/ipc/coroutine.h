@@ -0,0 +1,533 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_COROUTINE_H
+#define UT_IPC_COROUTINE_H
+
+// Optional coroutine layer, header only so the library itself builds as C++17
+#if !defined(__cpp_impl_coroutine)
+#error "ut/ipc/coroutine.h needs C++20 coroutines"
+#endif
+
+#include "ut/ipc/bufferpool.h"
+#include "ut/ipc/client.h"
+#include "ut/ipc/rpcclient.h"
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+
+namespace UT {
+
+template <typename T>
+class IPCTask;
+
+// State shared by the promises of every IPCTask. Frames come from
+// IPCBufferPool, so short lived tasks on the hot path skip the global heap
+struct IPCTaskPromiseBase {
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept;
+        void await_resume() const noexcept { }
+    }; // struct FinalAwaiter
+
+    static void* operator new(size_t bytes);
+    static void operator delete(void* frame, size_t bytes);
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+    bool detached = false;
+}; // struct IPCTaskPromiseBase
+
+template <typename T>
+struct IPCTaskPromise : IPCTaskPromiseBase {
+    IPCTask<T> get_return_object();
+    template <typename U>
+    void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+    T getResult();
+
+    std::optional<T> value;
+}; // struct IPCTaskPromise
+
+template <>
+struct IPCTaskPromise<void> : IPCTaskPromiseBase {
+    IPCTask<void> get_return_object();
+    void return_void() const noexcept { }
+    void getResult();
+}; // struct IPCTaskPromise<void>
+
+// Coroutine started lazily, once awaited by another one or detached. The
+// awaiting coroutine is resumed on whatever thread the task finishes on
+template <typename T = void>
+class IPCTask {
+public:
+    using promise_type = IPCTaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    explicit IPCTask(Handle handle);
+    IPCTask(const IPCTask&) = delete;
+    IPCTask(IPCTask&& other) noexcept;
+    ~IPCTask();
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Runs the task on the calling thread until its first suspension, with
+    // nobody awaiting it. The frame is freed once it finishes, an exception
+    // escaping it terminates
+    void detach();
+
+    bool await_ready() const noexcept;
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept;
+    T await_resume();
+
+protected:
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    Handle mHandle;
+}; // class IPCTask
+
+// Framed IPCClient driven by coroutines instead of events. Messages go to
+// receive() instead of onMessageReceived / onChannelMessageReceived, the
+// other events are raised as usual. Suspended coroutines are resumed on the
+// client thread (or the one calling stop()), so like direct handlers they
+// must not block there or call stop()
+class IPCCoClient : public IPCClient {
+public:
+    struct Message {
+        uint32_t channel;
+        uint32_t type;
+        std::shared_ptr<void> data;
+        ssize_t bytes;
+    }; // struct Message
+
+    // Parked in the awaiting coroutine's frame while it's suspended
+    struct Awaiter {
+        bool await_ready() const noexcept { return false; }
+
+        IPCCoClient* client;
+        std::coroutine_handle<> handle;
+        std::exception_ptr error;
+    }; // struct Awaiter
+
+    struct ConnectAwaiter : Awaiter {
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume();
+    }; // struct ConnectAwaiter
+
+    struct ReceiveAwaiter : Awaiter {
+        bool await_suspend(std::coroutine_handle<> handle);
+        Message await_resume();
+
+        Message message;
+    }; // struct ReceiveAwaiter
+
+    struct SendAwaiter : Awaiter {
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume();
+
+        uint32_t channel;
+        uint32_t type;
+        const void* data;
+        size_t bytes;
+    }; // struct SendAwaiter
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCCoClient();
+    IPCCoClient(const IPCCoClient&) = delete;
+    IPCCoClient(IPCCoClient&&) = delete;
+    ~IPCCoClient() override;
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Starts the client unless it runs already, resumes once it's connected
+    ConnectAwaiter connect(const std::string& server);
+    // Next message in arrival order. Throws std::runtime_error when the
+    // connection is lost before one arrives
+    ReceiveAwaiter receive();
+    // sendChannel(...) once the server isn't congested (see setWatermarks(...)),
+    // "data" has to stay valid until then. Throws std::runtime_error when not
+    // connected
+    SendAwaiter send(uint32_t type, const void* data, size_t bytes, uint32_t channel = 0);
+    // Suspended coroutines resume with std::runtime_error
+    RetCode stop();
+
+protected:
+    /**************************************************************************
+     * Methods (Protected)
+     *************************************************************************/
+
+    void dispatchMessage(const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) override;
+    void dispatchReady(bool ready) override;
+    void dispatchCongestion(bool congested) override;
+    // Resumes every awaiter in "awaiters" with "error", releases "lock"
+    template <typename Awaiters>
+    static void fail(Awaiters& awaiters, std::unique_lock<std::mutex>& lock, const char* error);
+
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    std::mutex mAwaitersMutex; // guards everything below
+    bool mConnected = false;
+    bool mCongested = false;
+    std::deque<Message> mMessages; // waiting for receive()
+    std::deque<ConnectAwaiter*> mConnecting;
+    std::deque<ReceiveAwaiter*> mReceivers;
+    std::deque<SendAwaiter*> mSenders;
+}; // class IPCCoClient
+
+// co_await IPCRpcAwaiter(client, ...) issues the call and resumes with its
+// response on the client thread, or on the timer thread when it times out
+class IPCRpcAwaiter {
+public:
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    // A timeout of 0 uses IPCRpcClient::getTimeout()
+    IPCRpcAwaiter(IPCRpcClient& client, uint32_t method, const void* data, size_t bytes, unsigned int timeout = 0);
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> handle);
+    IPCRpcClient::Response await_resume();
+
+protected:
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    IPCRpcClient& mClient;
+    uint32_t mMethod;
+    const void* mData;
+    size_t mBytes;
+    unsigned int mTimeout;
+    std::coroutine_handle<> mHandle;
+    IPCRpcClient::Response mResponse;
+    std::atomic<bool> mDone = false; // set by whichever of the two sides is last
+}; // class IPCRpcAwaiter
+
+/******************************************************************************
+ * Inline Definition: IPCTaskPromise
+ *****************************************************************************/
+
+template <typename Promise>
+std::coroutine_handle<> IPCTaskPromiseBase::FinalAwaiter::await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+    auto& promise = handle.promise();
+    if (!promise.detached) {
+        return promise.continuation ? promise.continuation : std::noop_coroutine();
+    }
+
+    if (promise.exception) {
+        std::terminate();
+    }
+    handle.destroy();
+    return std::noop_coroutine();
+}
+
+inline void* IPCTaskPromiseBase::operator new(size_t bytes) {
+    return IPCBufferPool::getInstance().allocate(bytes);
+}
+
+inline void IPCTaskPromiseBase::operator delete(void* frame, size_t bytes) {
+    IPCBufferPool::getInstance().release(frame, bytes);
+}
+
+template <typename T>
+IPCTask<T> IPCTaskPromise<T>::get_return_object() {
+    return IPCTask<T>(IPCTask<T>::Handle::from_promise(*this));
+}
+
+template <typename T>
+T IPCTaskPromise<T>::getResult() {
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+    return std::move(*value);
+}
+
+inline IPCTask<void> IPCTaskPromise<void>::get_return_object() {
+    return IPCTask<void>(IPCTask<void>::Handle::from_promise(*this));
+}
+
+inline void IPCTaskPromise<void>::getResult() {
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+/******************************************************************************
+ * Inline Definition: IPCTask
+ *****************************************************************************/
+
+template <typename T>
+IPCTask<T>::IPCTask(Handle handle) : mHandle(handle) { }
+
+template <typename T>
+IPCTask<T>::IPCTask(IPCTask&& other) noexcept : mHandle(other.mHandle) {
+    other.mHandle = nullptr;
+}
+
+template <typename T>
+IPCTask<T>::~IPCTask() {
+    if (mHandle) {
+        mHandle.destroy();
+    }
+}
+
+template <typename T>
+void IPCTask<T>::detach() {
+    auto handle = mHandle;
+    mHandle = nullptr;
+    handle.promise().detached = true;
+    handle.resume();
+}
+
+template <typename T>
+bool IPCTask<T>::await_ready() const noexcept {
+    return false;
+}
+
+template <typename T>
+std::coroutine_handle<> IPCTask<T>::await_suspend(std::coroutine_handle<> continuation) noexcept {
+    mHandle.promise().continuation = continuation;
+    return mHandle;
+}
+
+template <typename T>
+T IPCTask<T>::await_resume() {
+    return mHandle.promise().getResult();
+}
+
+/******************************************************************************
+ * Inline Definition: IPCCoClient
+ *****************************************************************************/
+
+inline IPCCoClient::IPCCoClient() {
+    setFramed(true);
+}
+
+inline IPCCoClient::~IPCCoClient() {
+    stop();
+}
+
+inline IPCCoClient::ConnectAwaiter IPCCoClient::connect(const std::string& server) {
+    start(server);
+    return { { this, nullptr, nullptr } };
+}
+
+inline IPCCoClient::ReceiveAwaiter IPCCoClient::receive() {
+    return { { this, nullptr, nullptr }, {} };
+}
+
+inline IPCCoClient::SendAwaiter IPCCoClient::send(uint32_t type, const void* data, size_t bytes, uint32_t channel) {
+    return { { this, nullptr, nullptr }, channel, type, data, bytes };
+}
+
+inline IPCClient::RetCode IPCCoClient::stop() {
+    RetCode ret = IPCClient::stop();
+
+    std::unique_lock lock(mAwaitersMutex);
+    fail(mConnecting, lock, "client stopped");
+    lock.lock();
+    fail(mSenders, lock, "client stopped");
+    return ret;
+}
+
+inline bool IPCCoClient::ConnectAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    std::unique_lock lock(client->mAwaitersMutex);
+    if (client->mConnected) {
+        return false;
+    }
+
+    this->handle = handle;
+    client->mConnecting.push_back(this);
+    return true;
+}
+
+inline void IPCCoClient::ConnectAwaiter::await_resume() {
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+inline bool IPCCoClient::ReceiveAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    std::unique_lock lock(client->mAwaitersMutex);
+    if (!client->mMessages.empty()) {
+        message = std::move(client->mMessages.front());
+        client->mMessages.pop_front();
+        return false;
+    }
+
+    if (!client->mConnected) {
+        error = std::make_exception_ptr(std::runtime_error("not connected"));
+        return false;
+    }
+
+    this->handle = handle;
+    client->mReceivers.push_back(this);
+    return true;
+}
+
+inline IPCCoClient::Message IPCCoClient::ReceiveAwaiter::await_resume() {
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return std::move(message);
+}
+
+inline bool IPCCoClient::SendAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    std::unique_lock lock(client->mAwaitersMutex);
+    if (!client->mConnected) {
+        error = std::make_exception_ptr(std::runtime_error("not connected"));
+        return false;
+    }
+    if (!client->mCongested) {
+        return false;
+    }
+
+    this->handle = handle;
+    client->mSenders.push_back(this);
+    return true;
+}
+
+inline void IPCCoClient::SendAwaiter::await_resume() {
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    client->sendChannel(channel, type, data, bytes);
+}
+
+inline void IPCCoClient::dispatchMessage(const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+    Message message = { header.channel, header.type, std::move(data), bytes };
+
+    std::unique_lock lock(mAwaitersMutex);
+    if (mReceivers.empty()) {
+        mMessages.push_back(std::move(message));
+        return;
+    }
+
+    auto* receiver = mReceivers.front();
+    mReceivers.pop_front();
+    lock.unlock();
+
+    receiver->message = std::move(message);
+    receiver->handle.resume();
+}
+
+inline void IPCCoClient::dispatchReady(bool ready) {
+    IPCClient::dispatchReady(ready);
+
+    std::unique_lock lock(mAwaitersMutex);
+    mConnected = ready;
+    if (!ready) {
+        fail(mReceivers, lock, "connection lost");
+        return;
+    }
+
+    auto connecting = std::move(mConnecting);
+    mConnecting.clear();
+    lock.unlock();
+
+    for (auto* awaiter : connecting) {
+        awaiter->handle.resume();
+    }
+}
+
+inline void IPCCoClient::dispatchCongestion(bool congested) {
+    IPCClient::dispatchCongestion(congested);
+
+    std::unique_lock lock(mAwaitersMutex);
+    mCongested = congested;
+
+    // One at a time, a resumed sender may congest the queue again
+    while (!mCongested && !mSenders.empty()) {
+        auto* sender = mSenders.front();
+        mSenders.pop_front();
+        lock.unlock();
+        sender->handle.resume();
+        lock.lock();
+    }
+}
+
+template <typename Awaiters>
+void IPCCoClient::fail(Awaiters& awaiters, std::unique_lock<std::mutex>& lock, const char* error) {
+    auto failed = std::move(awaiters);
+    awaiters.clear();
+    lock.unlock();
+
+    for (auto* awaiter : failed) {
+        awaiter->error = std::make_exception_ptr(std::runtime_error(error));
+        awaiter->handle.resume();
+    }
+}
+
+/******************************************************************************
+ * Inline Definition: IPCRpcAwaiter
+ *****************************************************************************/
+
+inline IPCRpcAwaiter::IPCRpcAwaiter(IPCRpcClient& client, uint32_t method, const void* data, size_t bytes, unsigned int timeout)
+    : mClient(client), mMethod(method), mData(data), mBytes(bytes), mTimeout(timeout) { }
+
+inline bool IPCRpcAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    mHandle = handle;
+    mClient.call(mMethod, mData, mBytes, [this] (IPCRpcClient::Response response) {
+        mResponse = std::move(response);
+        if (mDone.exchange(true)) {
+            mHandle.resume();
+        }
+    }, mTimeout);
+
+    // Answered already, e.g. while disconnected
+    return !mDone.exchange(true);
+}
+
+inline IPCRpcClient::Response IPCRpcAwaiter::await_resume() {
+    return std::move(mResponse);
+}
+
+} // namespace UT
+
+#endif // UT_IPC_COROUTINE_H
\ No newline at end of file
@@ -0,0 +1,161 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#include "descriptors.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace UT {
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+ssize_t IPCDescriptors::receive(int sfd, void* data, size_t bytes, std::vector<int>& fds) {
+    alignas(cmsghdr) char control[kControlSize];
+
+    iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = bytes;
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t ret = recvmsg(sfd, &msg, MSG_CMSG_CLOEXEC);
+    if (ret > 0) {
+        size_t count = fds.size();
+        collect(msg, fds);
+
+        // Descriptors that didn't fit are gone, and the rest can't be paired
+        // with their data anymore
+        if (msg.msg_flags & MSG_CTRUNC) {
+            close(std::vector<int>(fds.begin() + count, fds.end()));
+            fds.resize(count);
+            errno = EMSGSIZE;
+            return -1;
+        }
+    }
+
+    return ret;
+}
+
+ssize_t IPCDescriptors::send(int sfd, const void* data, size_t bytes, const std::vector<int>& fds) {
+    if (fds.size() > UT_IPC_MAX_DESCRIPTORS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    alignas(cmsghdr) char control[kControlSize];
+
+    iovec iov;
+    iov.iov_base = const_cast<void*>(data);
+    iov.iov_len = bytes;
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    attach(msg, control, fds);
+
+    return sendmsg(sfd, &msg, MSG_NOSIGNAL);
+}
+
+void IPCDescriptors::attach(msghdr& msg, void* control, const std::vector<int>& fds) {
+    if (fds.empty()) {
+        msg.msg_control = nullptr;
+        msg.msg_controllen = 0;
+        return;
+    }
+
+    memset(control, 0, kControlSize);
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+}
+
+void IPCDescriptors::collect(const msghdr& msg, std::vector<int>& fds) {
+    if (!msg.msg_controllen) {
+        return;
+    }
+
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&msg), cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const unsigned char* payload = CMSG_DATA(cmsg);
+        for (size_t i = 0; i < count; ++i) {
+            int fd;
+            memcpy(&fd, payload + i * sizeof(int), sizeof(int));
+            fds.push_back(fd);
+        }
+    }
+}
+
+std::vector<int> IPCDescriptors::duplicate(const std::vector<int>& fds) {
+    std::vector<int> copies;
+    copies.reserve(fds.size());
+
+    for (int fd : fds) {
+        int copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (copy == -1) {
+            int error = errno;
+            close(copies);
+            throw std::runtime_error("fcntl(..., F_DUPFD_CLOEXEC, ...) failed, errno: " + std::to_string(error));
+        }
+        copies.push_back(copy);
+    }
+
+    return copies;
+}
+
+std::shared_ptr<const std::vector<int>> IPCDescriptors::share(std::vector<int> fds) {
+    return std::shared_ptr<const std::vector<int>>(new std::vector<int>(std::move(fds)), [] (const std::vector<int>* fds) {
+        close(*fds);
+        delete fds;
+    });
+}
+
+void IPCDescriptors::close(const std::vector<int>& fds) {
+    for (int fd : fds) {
+        ::close(fd);
+    }
+}
+
+} // namespace UT
\ No newline at end of file
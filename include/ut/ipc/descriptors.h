@@ -0,0 +1,70 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_DESCRIPTORS_H
+#define UT_IPC_DESCRIPTORS_H
+
+#include "ut/ipc/common.h"
+
+#include <cstddef>
+#include <memory>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <vector>
+
+namespace UT {
+
+// Helpers for passing file descriptors over AF_UNIX sockets with SCM_RIGHTS
+class IPCDescriptors {
+public:
+    // Room for the largest group of descriptors in a control message
+    static constexpr size_t kControlSize = CMSG_SPACE(sizeof(int) * UT_IPC_MAX_DESCRIPTORS);
+
+    IPCDescriptors() = delete;
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // recv(...) collecting passed descriptors into "fds", returned ones are
+    // owned by the caller and close-on-exec. Fails with EMSGSIZE when more
+    // descriptors came than fit, closing the ones that did
+    static ssize_t receive(int sfd, void* data, size_t bytes, std::vector<int>& fds);
+    // sendmsg(...) attaching "fds" to the first byte of the data
+    static ssize_t send(int sfd, const void* data, size_t bytes, const std::vector<int>& fds);
+    // Fills the control message of "msg" from "fds", "control" has to hold
+    // kControlSize bytes aligned for a cmsghdr
+    static void attach(msghdr& msg, void* control, const std::vector<int>& fds);
+    // Appends descriptors found in the control message of "msg" to "fds"
+    static void collect(const msghdr& msg, std::vector<int>& fds);
+    // Close-on-exec copies, so the caller keeps ownership of "fds"
+    static std::vector<int> duplicate(const std::vector<int>& fds);
+    // Hands "fds" out to event handlers, they are closed once the last
+    // reference is dropped, dup(...) the ones to keep
+    static std::shared_ptr<const std::vector<int>> share(std::vector<int> fds);
+    static void close(const std::vector<int>& fds);
+}; // class IPCDescriptors
+
+} // namespace UT
+
+#endif // UT_IPC_DESCRIPTORS_H
\ No newline at end of file
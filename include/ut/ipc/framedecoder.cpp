@@ -0,0 +1,205 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#include "framedecoder.h"
+#include "bufferpool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace UT {
+
+/******************************************************************************
+ * Constructors / Destructors
+ *****************************************************************************/
+
+IPCFrameDecoder::IPCFrameDecoder(IPCFrameDecoder&& other) noexcept
+    : mHeader(other.mHeader),
+      mHeaderBytes(other.mHeaderBytes),
+      mPayload(std::move(other.mPayload)),
+      mPayloadBytes(other.mPayloadBytes),
+      mAssembly(std::move(other.mAssembly)) {
+    other.reset();
+}
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+IPCFrameDecoder::RetCode IPCFrameDecoder::decode(const void* data, size_t bytes, const Callback& callback, const Provider& provider) {
+    auto input = static_cast<const char*>(data);
+
+    while (bytes) {
+        // Accumulate header
+        if (mHeaderBytes < sizeof(mHeader)) {
+            size_t chunk = std::min(bytes, sizeof(mHeader) - mHeaderBytes);
+            memcpy(reinterpret_cast<char*>(&mHeader) + mHeaderBytes, input, chunk);
+            mHeaderBytes += chunk;
+            input += chunk;
+            bytes -= chunk;
+
+            if (mHeaderBytes < sizeof(mHeader)) {
+                break;
+            }
+
+            if (mHeader.size > UT_IPC_FRAME_MAX_SIZE) {
+                reset();
+                return RetCode::kFrameTooLarge;
+            }
+
+            if (mHeader.size == 0) {
+                auto header = mHeader;
+                reset();
+                callback(header, nullptr, 0);
+                continue;
+            }
+
+            try {
+                if (provider) {
+                    mPayload = provider(mHeader);
+                }
+                if (!mPayload) {
+                    mPayload = IPCBufferPool::getInstance().acquire(mHeader.size);
+                }
+            } catch (const std::bad_alloc&) {
+                reset();
+                return RetCode::kAllocationFailed;
+            }
+            mPayloadBytes = 0;
+        }
+
+        // Accumulate payload, unless it was received in place
+        size_t chunk = std::min(bytes, mHeader.size - mPayloadBytes);
+        char* destination = static_cast<char*>(mPayload.get()) + mPayloadBytes;
+        if (destination != input) {
+            memcpy(destination, input, chunk);
+        }
+        mPayloadBytes += chunk;
+        input += chunk;
+        bytes -= chunk;
+
+        if (mPayloadBytes == mHeader.size) {
+            auto payload = std::move(mPayload);
+            auto header = mHeader;
+            reset();
+            callback(header, std::move(payload), header.size);
+        }
+    }
+
+    return RetCode::kSuccess;
+}
+
+IPCFrameDecoder::RetCode IPCFrameDecoder::decodeView(const void* data, size_t bytes, const ViewCallback& callback) {
+    auto input = static_cast<const char*>(data);
+
+    while (bytes) {
+        // Whole frames are handed out in place
+        if (!mHeaderBytes && bytes >= sizeof(mHeader)) {
+            IPCFrameHeader header;
+            memcpy(&header, input, sizeof(header));
+
+            if (header.size > UT_IPC_FRAME_MAX_SIZE) {
+                return RetCode::kFrameTooLarge;
+            }
+
+            if (bytes - sizeof(header) >= header.size) {
+                callback(header, header.size ? input + sizeof(header) : nullptr, header.size);
+                input += sizeof(header) + header.size;
+                bytes -= sizeof(header) + header.size;
+                continue;
+            }
+        }
+
+        // Accumulate header
+        if (mHeaderBytes < sizeof(mHeader)) {
+            size_t chunk = std::min(bytes, sizeof(mHeader) - mHeaderBytes);
+            memcpy(reinterpret_cast<char*>(&mHeader) + mHeaderBytes, input, chunk);
+            mHeaderBytes += chunk;
+            input += chunk;
+            bytes -= chunk;
+
+            if (mHeaderBytes < sizeof(mHeader)) {
+                break;
+            }
+
+            if (mHeader.size > UT_IPC_FRAME_MAX_SIZE) {
+                reset();
+                return RetCode::kFrameTooLarge;
+            }
+
+            if (mHeader.size == 0) {
+                auto header = mHeader;
+                reset();
+                callback(header, nullptr, 0);
+                continue;
+            }
+
+            try {
+                if (mAssembly.size() < mHeader.size) {
+                    mAssembly.resize(mHeader.size);
+                }
+            } catch (const std::bad_alloc&) {
+                reset();
+                return RetCode::kAllocationFailed;
+            }
+            mPayloadBytes = 0;
+        }
+
+        // Accumulate payload
+        size_t chunk = std::min(bytes, mHeader.size - mPayloadBytes);
+        memcpy(mAssembly.data() + mPayloadBytes, input, chunk);
+        mPayloadBytes += chunk;
+        input += chunk;
+        bytes -= chunk;
+
+        if (mPayloadBytes == mHeader.size) {
+            auto header = mHeader;
+            reset();
+            callback(header, mAssembly.data(), header.size);
+
+            if (mAssembly.capacity() > UT_IPC_ASSEMBLY_RETAINED) {
+                std::vector<char>().swap(mAssembly);
+            }
+        }
+    }
+
+    return RetCode::kSuccess;
+}
+
+void* IPCFrameDecoder::getPending(size_t& bytes) {
+    if (mHeaderBytes < sizeof(mHeader) || !mPayload) {
+        bytes = 0;
+        return nullptr;
+    }
+
+    bytes = mHeader.size - mPayloadBytes;
+    return static_cast<char*>(mPayload.get()) + mPayloadBytes;
+}
+
+void IPCFrameDecoder::reset() {
+    mHeaderBytes = 0;
+    mPayload.reset();
+    mPayloadBytes = 0;
+}
+
+} // namespace UT
\ No newline at end of file
@@ -0,0 +1,113 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_FRAME_DECODER_H
+#define UT_IPC_FRAME_DECODER_H
+
+#define UT_IPC_ASSEMBLY_RETAINED (256 * 1024) // bytes, kept by decodeView(...) between frames
+
+#include "ut/ipc/common.h"
+
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+#include <vector>
+
+namespace UT {
+
+class IPCFrameDecoder {
+public:
+    enum class RetCode;
+
+    using Callback = std::function<void(const IPCFrameHeader&, std::shared_ptr<void>, ssize_t)>;
+    // Destination of a payload, has to hold header.size bytes. nullptr falls
+    // back to a pooled block
+    using Provider = std::function<std::shared_ptr<void>(const IPCFrameHeader&)>;
+    // "data" is only valid during the call and isn't aligned
+    using ViewCallback = std::function<void(const IPCFrameHeader&, const void*, size_t)>;
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCFrameDecoder() = default;
+    IPCFrameDecoder(const IPCFrameDecoder&) = delete;
+    IPCFrameDecoder(IPCFrameDecoder&& other) noexcept;
+    ~IPCFrameDecoder() = default;
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Consumes a chunk of the byte stream and invokes the callback once for
+    // every message completed by it. Incomplete header or payload bytes are
+    // kept until the next call. "data" may have been received in place at
+    // getPending(...), it isn't copied then
+    RetCode decode(const void* data, size_t bytes, const Callback& callback, const Provider& provider = nullptr);
+    // Same as decode(...), but payloads are borrowed: straight from the chunk
+    // when the whole frame is in it, otherwise from a reassembly buffer that
+    // is reused across frames. The buffer is released after a frame larger
+    // than UT_IPC_ASSEMBLY_RETAINED, so a single large frame doesn't pin its
+    // memory for the connection's lifetime. Not to be mixed with decode(...)
+    // on a stream
+    RetCode decodeView(const void* data, size_t bytes, const ViewCallback& callback);
+    // Where the rest of a partially received payload goes and how many bytes
+    // it misses, nullptr when no payload is in progress. Lets large payloads
+    // be received straight into their destination
+    void* getPending(size_t& bytes);
+    void reset();
+
+    /**************************************************************************
+     * Accessors / Mutators
+     *************************************************************************/
+
+    // Capacity of the reassembly buffer of decodeView(...)
+    size_t getRetained() const;
+
+protected:
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    IPCFrameHeader mHeader;
+    size_t mHeaderBytes = 0;
+    std::shared_ptr<void> mPayload;
+    size_t mPayloadBytes = 0;
+    std::vector<char> mAssembly; // decodeView(...) only
+}; // class IPCFrameDecoder
+
+enum class IPCFrameDecoder::RetCode {
+    kSuccess,
+    kFrameTooLarge,
+    kAllocationFailed
+}; // IPCFrameDecoder::RetCode
+
+/******************************************************************************
+ * Inline Definition: Accessors / Mutators
+ *****************************************************************************/
+
+inline size_t IPCFrameDecoder::getRetained() const { return mAssembly.capacity(); }
+
+} // namespace UT
+
+#endif // UT_IPC_FRAME_DECODER_H
\ No newline at end of file
@@ -0,0 +1,179 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace UT {
+
+namespace {
+
+void writeCounter(std::ostream& out, const std::string& name, const char* help) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " counter\n";
+}
+
+void writeSummary(std::ostream& out, const std::string& name, const char* help, const IPCHistogram::Snapshot& snapshot) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " summary\n";
+    for (double quantile : { 0.5, 0.9, 0.99, 0.999 }) {
+        out << name << "{quantile=\"" << quantile << "\"} " << snapshot.getPercentile(quantile * 100) * 1e-9 << "\n";
+    }
+    out << name << "_sum " << snapshot.sum * 1e-9 << "\n";
+    out << name << "_count " << snapshot.count << "\n";
+}
+
+} // namespace
+
+/******************************************************************************
+ * Methods: IPCHistogram
+ *****************************************************************************/
+
+IPCHistogram::Snapshot IPCHistogram::getSnapshot() const {
+    Snapshot snapshot;
+    snapshot.buckets.resize(kBuckets);
+
+    // Not a consistent cut, the count is derived from the buckets so that
+    // percentiles at least add up
+    for (size_t i = 0; i < kBuckets; ++i) {
+        snapshot.buckets[i] = mBuckets[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.sum = mSum.load(std::memory_order_relaxed);
+
+    return snapshot;
+}
+
+uint64_t IPCHistogram::getUpperBound(size_t bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+
+    size_t shift = bucket / kSubBuckets - 1;
+    uint64_t mantissa = kSubBuckets + bucket % kSubBuckets;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/******************************************************************************
+ * Methods: IPCHistogram::Snapshot
+ *****************************************************************************/
+
+void IPCHistogram::Snapshot::merge(const Snapshot& other) {
+    if (buckets.empty()) {
+        buckets.resize(kBuckets);
+    }
+
+    for (size_t i = 0; i < other.buckets.size(); ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum += other.sum;
+}
+
+uint64_t IPCHistogram::Snapshot::getPercentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = uint64_t(std::ceil(p / 100 * count));
+    rank = std::max<uint64_t>(1, std::min(rank, count));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return getUpperBound(i);
+        }
+    }
+
+    return 0;
+}
+
+uint64_t IPCHistogram::Snapshot::getMax() const {
+    for (size_t i = buckets.size(); i > 0; --i) {
+        if (buckets[i - 1]) {
+            return getUpperBound(i - 1);
+        }
+    }
+
+    return 0;
+}
+
+double IPCHistogram::Snapshot::getMean() const {
+    return count ? double(sum) / count : 0;
+}
+
+/******************************************************************************
+ * Methods: IPCServerMetrics
+ *****************************************************************************/
+
+std::string IPCServerMetrics::toText(const std::string& prefix) const {
+    std::ostringstream out;
+
+    writeCounter(out, prefix + "_connections_accepted_total", "Clients accepted");
+    out << prefix << "_connections_accepted_total " << accepted << "\n";
+    writeCounter(out, prefix + "_connections_closed_total", "Clients disconnected");
+    out << prefix << "_connections_closed_total " << disconnected << "\n";
+
+    struct Counter {
+        const char* name;
+        const char* help;
+        uint64_t total;
+        uint64_t IPCConnectionMetrics::*field;
+    }; // struct Counter
+    const Counter counters[] = {
+        { "_received_bytes_total", "Bytes received", bytesReceived, &IPCConnectionMetrics::bytesReceived },
+        { "_sent_bytes_total", "Bytes sent", bytesSent, &IPCConnectionMetrics::bytesSent },
+        { "_received_messages_total", "Messages received", messagesReceived, &IPCConnectionMetrics::messagesReceived },
+        { "_sent_messages_total", "Messages sent", messagesSent, &IPCConnectionMetrics::messagesSent },
+        { "_dropped_bytes_total", "Published bytes dropped for slow consumers", droppedBytes, &IPCConnectionMetrics::droppedBytes }
+    };
+
+    // Per client series, plus the total including departed clients
+    for (const auto& counter : counters) {
+        std::string name = prefix + counter.name;
+        writeCounter(out, name, counter.help);
+        out << name << " " << counter.total << "\n";
+        for (const auto& connection : connections) {
+            out << name << "{client=\"" << connection.client << "\"} " << connection.*counter.field << "\n";
+        }
+    }
+
+    std::string name = prefix + "_queued_bytes";
+    out << "# HELP " << name << " Bytes waiting in send queues\n";
+    out << "# TYPE " << name << " gauge\n";
+    out << name << " " << queuedBytes << "\n";
+    for (const auto& connection : connections) {
+        out << name << "{client=\"" << connection.client << "\"} " << connection.queuedBytes << "\n";
+    }
+
+    writeSummary(out, prefix + "_dispatch_latency_seconds", "Receive to dispatch latency", dispatchLatency);
+    writeSummary(out, prefix + "_queue_wait_seconds", "Time spent in send queues", queueWait);
+
+    return out.str();
+}
+
+} // namespace UT
\ No newline at end of file
@@ -0,0 +1,165 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+#ifndef UT_IPC_METRICS_H
+#define UT_IPC_METRICS_H
+
+#define UT_IPC_HISTOGRAM_SUB_BITS 4 // 16 buckets per power of two, ~6% error
+
+#include "ut/ipc/common.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace UT {
+
+// HDR-style log-linear histogram of 64-bit values. Recording is a pair of
+// relaxed atomic increments, so it's safe from any thread and cheap enough
+// to leave on
+class IPCHistogram {
+public:
+    static constexpr size_t kSubBuckets = size_t(1) << UT_IPC_HISTOGRAM_SUB_BITS;
+    static constexpr size_t kBuckets = (64 - UT_IPC_HISTOGRAM_SUB_BITS + 1) * kSubBuckets;
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        std::vector<uint64_t> buckets;
+
+        void merge(const Snapshot& other);
+        // Upper bound of the bucket holding the "p"th percentile (0 - 100),
+        // 0 when empty
+        uint64_t getPercentile(double p) const;
+        uint64_t getMax() const;
+        double getMean() const;
+    }; // struct Snapshot
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCHistogram() = default;
+    IPCHistogram(const IPCHistogram&) = delete;
+    IPCHistogram(IPCHistogram&&) = delete;
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    void record(uint64_t value);
+    Snapshot getSnapshot() const;
+
+    static size_t getBucket(uint64_t value);
+    static uint64_t getUpperBound(size_t bucket);
+
+protected:
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    std::atomic<uint64_t> mBuckets[kBuckets] {};
+    std::atomic<uint64_t> mSum = 0;
+}; // class IPCHistogram
+
+// Live traffic counters of a connection
+class IPCCounters {
+public:
+    enum Counter {
+        kBytesReceived,
+        kBytesSent,
+        kMessagesReceived,
+        kMessagesSent,
+        kDroppedBytes,
+        kCount
+    }; // enum Counter
+
+    void add(Counter counter, uint64_t value = 1);
+    uint64_t get(Counter counter) const;
+
+protected:
+    std::atomic<uint64_t> mValues[kCount] {};
+}; // class IPCCounters
+
+struct IPCConnectionMetrics {
+    IPCClientId client = 0;
+    uint64_t bytesReceived = 0;
+    uint64_t bytesSent = 0;
+    uint64_t messagesReceived = 0;
+    uint64_t messagesSent = 0;
+    uint64_t droppedBytes = 0; // by SlowConsumerPolicy::kDropOldest
+    size_t queuedBytes = 0;
+}; // struct IPCConnectionMetrics
+
+struct IPCServerMetrics {
+    uint64_t accepted = 0;
+    uint64_t disconnected = 0;
+    // Totals include clients gone since start()
+    uint64_t bytesReceived = 0;
+    uint64_t bytesSent = 0;
+    uint64_t messagesReceived = 0;
+    uint64_t messagesSent = 0;
+    uint64_t droppedBytes = 0;
+    size_t queuedBytes = 0;
+    std::vector<IPCConnectionMetrics> connections;
+    // Nanoseconds from a receive completing to its handlers being invoked
+    // or queued on their event loop
+    IPCHistogram::Snapshot dispatchLatency;
+    // Nanoseconds a chunk spent in a send queue until fully written
+    IPCHistogram::Snapshot queueWait;
+
+    // Prometheus text exposition format
+    std::string toText(const std::string& prefix = "ut_ipc") const;
+}; // struct IPCServerMetrics
+
+/******************************************************************************
+ * Inline Definition: Methods
+ *****************************************************************************/
+
+inline void IPCHistogram::record(uint64_t value) {
+    mBuckets[getBucket(value)].fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(value, std::memory_order_relaxed);
+}
+
+inline size_t IPCHistogram::getBucket(uint64_t value) {
+    if (value < kSubBuckets) {
+        return value;
+    }
+
+    // Top UT_IPC_HISTOGRAM_SUB_BITS + 1 bits of the value select the bucket
+    size_t shift = 63 - __builtin_clzll(value) - UT_IPC_HISTOGRAM_SUB_BITS;
+    return (shift + 1) * kSubBuckets + (value >> shift) - kSubBuckets;
+}
+
+inline void IPCCounters::add(Counter counter, uint64_t value) {
+    mValues[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+inline uint64_t IPCCounters::get(Counter counter) const {
+    return mValues[counter].load(std::memory_order_relaxed);
+}
+
+} // namespace UT
+
+#endif // UT_IPC_METRICS_H
\ No newline at end of file
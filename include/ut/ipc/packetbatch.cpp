@@ -0,0 +1,105 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#include "packetbatch.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace UT {
+
+/******************************************************************************
+ * Constructors / Destructors
+ *****************************************************************************/
+
+IPCPacketBatch::IPCPacketBatch() {
+    // Pages of slots past the usual burst are never touched
+    mSlots = static_cast<char*>(malloc(UT_IPC_PACKET_BATCH * UT_IPC_PACKET_MAX_SIZE));
+    if (!mSlots) {
+        throw std::runtime_error("malloc(...) failed, errno: " + std::to_string(errno));
+    }
+}
+
+IPCPacketBatch::~IPCPacketBatch() {
+    free(mSlots);
+}
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+IPCPacketBatch::RetCode IPCPacketBatch::receive(int sfd, const Callback& callback) {
+    while (true) {
+        for (size_t i = 0; i < UT_IPC_PACKET_BATCH; ++i) {
+            mIov[i].iov_base = mSlots + i * UT_IPC_PACKET_MAX_SIZE;
+            mIov[i].iov_len = UT_IPC_PACKET_MAX_SIZE;
+
+            memset(&mMessages[i], 0, sizeof(mMessages[i]));
+            mMessages[i].msg_hdr.msg_iov = &mIov[i];
+            mMessages[i].msg_hdr.msg_iovlen = 1;
+            mMessages[i].msg_hdr.msg_control = mControl[i];
+            mMessages[i].msg_hdr.msg_controllen = IPCDescriptors::kControlSize;
+        }
+
+        int count = recvmmsg(sfd, mMessages, UT_IPC_PACKET_BATCH, MSG_DONTWAIT | MSG_CMSG_CLOEXEC, nullptr);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? RetCode::kSuccess : RetCode::kClosed;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            auto& message = mMessages[i];
+            std::vector<int> fds;
+            IPCDescriptors::collect(message.msg_hdr, fds);
+
+            // Senders never emit empty packets, so zero bytes is the end of
+            // the stream. A truncated packet came from a peer ignoring the
+            // size limit, the rest of it is lost
+            bool stop = !message.msg_len || (message.msg_hdr.msg_flags & (MSG_TRUNC | MSG_CTRUNC));
+            if (!stop) {
+                stop = !callback(mIov[i].iov_base, message.msg_len, fds);
+            }
+
+            if (stop) {
+                IPCDescriptors::close(fds);
+                for (int j = i + 1; j < count; ++j) {
+                    fds.clear();
+                    IPCDescriptors::collect(mMessages[j].msg_hdr, fds);
+                    IPCDescriptors::close(fds);
+                }
+                return RetCode::kClosed;
+            }
+        }
+
+        if (count < UT_IPC_PACKET_BATCH) {
+            return RetCode::kSuccess;
+        }
+    }
+}
+
+} // namespace UT
\ No newline at end of file
@@ -0,0 +1,84 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_PACKET_BATCH_H
+#define UT_IPC_PACKET_BATCH_H
+
+#define UT_IPC_PACKET_BATCH 16
+
+#include "ut/ipc/descriptors.h"
+
+#include <functional>
+#include <sys/socket.h>
+#include <vector>
+
+namespace UT {
+
+// Receives SOCK_SEQPACKET packets UT_IPC_PACKET_BATCH at a time with
+// recvmmsg(...). Every slot holds the largest packet allowed, so none is
+// truncated and each one is handed out with its exact size
+class IPCPacketBatch {
+public:
+    enum class RetCode;
+
+    // "data" is borrowed for the duration of the call and may be modified,
+    // "fds" have to be taken over or closed. Returning false stops receiving
+    using Callback = std::function<bool(void*, size_t, std::vector<int>&)>;
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCPacketBatch();
+    IPCPacketBatch(const IPCPacketBatch&) = delete;
+    IPCPacketBatch(IPCPacketBatch&&) = delete;
+    ~IPCPacketBatch();
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Receives until the socket would block
+    RetCode receive(int sfd, const Callback& callback);
+
+protected:
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    char* mSlots = nullptr;
+    mmsghdr mMessages[UT_IPC_PACKET_BATCH];
+    iovec mIov[UT_IPC_PACKET_BATCH];
+    alignas(cmsghdr) char mControl[UT_IPC_PACKET_BATCH][IPCDescriptors::kControlSize];
+}; // class IPCPacketBatch
+
+enum class IPCPacketBatch::RetCode {
+    kSuccess,
+    // End of the stream, an error, a truncated packet or the callback
+    // asked to stop
+    kClosed
+}; // IPCPacketBatch::RetCode
+
+} // namespace UT
+
+#endif // UT_IPC_PACKET_BATCH_H
\ No newline at end of file
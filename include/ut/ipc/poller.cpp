@@ -0,0 +1,189 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#include "poller.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+namespace UT {
+
+/******************************************************************************
+ * IPCPoller
+ *****************************************************************************/
+
+std::unique_ptr<IPCPoller> IPCPoller::create(Backend backend) {
+    switch (backend) {
+        case Backend::kEpoll:
+            return std::make_unique<IPCEpollPoller>();
+        case Backend::kPoll:
+        default:
+            return std::make_unique<IPCPollPoller>();
+    }
+}
+
+/******************************************************************************
+ * IPCPollPoller
+ *****************************************************************************/
+
+void IPCPollPoller::add(int fd, short events) {
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    mIndexes[fd] = mPfds.size();
+    mPfds.push_back(pfd);
+}
+
+void IPCPollPoller::modify(int fd, short events) {
+    auto it = mIndexes.find(fd);
+    if (it == mIndexes.end()) {
+        return;
+    }
+    mPfds[it->second].events = events;
+}
+
+void IPCPollPoller::remove(int fd) {
+    auto it = mIndexes.find(fd);
+    if (it == mIndexes.end()) {
+        return;
+    }
+
+    // Swap with the last descriptor instead of shifting the whole vector
+    size_t index = it->second;
+    mIndexes.erase(it);
+    if (index != mPfds.size() - 1) {
+        mPfds[index] = mPfds.back();
+        mIndexes[mPfds[index].fd] = index;
+    }
+    mPfds.pop_back();
+}
+
+int IPCPollPoller::wait(std::vector<Event>& events, int timeout) {
+    events.clear();
+
+    int ret = poll(mPfds.data(), mPfds.size(), timeout);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    for (size_t i = 0; i < mPfds.size() && events.size() < static_cast<size_t>(ret); ++i) {
+        if (!mPfds[i].revents) {
+            continue;
+        }
+        events.push_back({ mPfds[i].fd, mPfds[i].revents });
+        mPfds[i].revents = 0;
+    }
+
+    return static_cast<int>(events.size());
+}
+
+/******************************************************************************
+ * IPCEpollPoller
+ *****************************************************************************/
+
+IPCEpollPoller::IPCEpollPoller() {
+    mEfd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEfd == -1) {
+        throw std::runtime_error("epoll_create1(...) failed, errno: " + std::to_string(errno));
+    }
+}
+
+IPCEpollPoller::~IPCEpollPoller() {
+    close(mEfd);
+}
+
+static uint32_t toEpollEvents(short events) {
+    uint32_t ret = EPOLLET;
+    if (events & POLLIN) {
+        ret |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (events & POLLOUT) {
+        ret |= EPOLLOUT;
+    }
+    return ret;
+}
+
+static short fromEpollEvents(uint32_t events) {
+    short ret = 0;
+    if (events & (EPOLLIN | EPOLLRDHUP)) {
+        ret |= POLLIN;
+    }
+    if (events & EPOLLOUT) {
+        ret |= POLLOUT;
+    }
+    if (events & EPOLLERR) {
+        ret |= POLLERR;
+    }
+    if (events & EPOLLHUP) {
+        ret |= POLLHUP;
+    }
+    return ret;
+}
+
+void IPCEpollPoller::add(int fd, short events) {
+    epoll_event event;
+    event.events = toEpollEvents(events);
+    event.data.fd = fd;
+
+    if (epoll_ctl(mEfd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        throw std::runtime_error("epoll_ctl(..., EPOLL_CTL_ADD, ...) failed, errno: " + std::to_string(errno));
+    }
+    ++mCount;
+}
+
+void IPCEpollPoller::modify(int fd, short events) {
+    epoll_event event;
+    event.events = toEpollEvents(events);
+    event.data.fd = fd;
+
+    epoll_ctl(mEfd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void IPCEpollPoller::remove(int fd) {
+    if (epoll_ctl(mEfd, EPOLL_CTL_DEL, fd, nullptr) == 0) {
+        --mCount;
+    }
+}
+
+int IPCEpollPoller::wait(std::vector<Event>& events, int timeout) {
+    events.clear();
+
+    mEvents.resize(std::max<size_t>(mCount, 1));
+
+    int ret = epoll_wait(mEfd, mEvents.data(), static_cast<int>(mEvents.size()), timeout);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    for (int i = 0; i < ret; ++i) {
+        events.push_back({ mEvents[i].data.fd, fromEpollEvents(mEvents[i].events) });
+    }
+
+    return ret;
+}
+
+} // namespace UT
\ No newline at end of file
@@ -0,0 +1,117 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_POLLER_H
+#define UT_IPC_POLLER_H
+
+#include <cstdint>
+#include <memory>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unordered_map>
+#include <vector>
+
+namespace UT {
+
+class IPCPoller {
+public:
+    enum class Backend;
+
+    // Ready descriptor, "events" holds POLLIN / POLLOUT / POLLERR / POLLHUP
+    // bits regardless of the backend
+    struct Event {
+        int fd;
+        short events;
+    }; // struct Event
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCPoller() = default;
+    IPCPoller(const IPCPoller&) = delete;
+    IPCPoller(IPCPoller&&) = delete;
+    virtual ~IPCPoller() = default;
+
+    static std::unique_ptr<IPCPoller> create(Backend backend);
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    virtual void add(int fd, short events) = 0;
+    virtual void modify(int fd, short events) = 0;
+    virtual void remove(int fd) = 0;
+
+    // Fills "events" with ready descriptors only, returns their count or -1
+    // with errno set
+    virtual int wait(std::vector<Event>& events, int timeout) = 0;
+}; // class IPCPoller
+
+enum class IPCPoller::Backend {
+    kPoll,
+    kEpoll,
+    // Completion based, only IPCServer drives it and only on kernels where
+    // IPCUring::isSupported(), create(...) falls back to poll(...)
+    kUring
+}; // IPCPoller::Backend
+
+/******************************************************************************
+ * poll(...) backend
+ *****************************************************************************/
+
+class IPCPollPoller : public IPCPoller {
+public:
+    void add(int fd, short events) override;
+    void modify(int fd, short events) override;
+    void remove(int fd) override;
+    int wait(std::vector<Event>& events, int timeout) override;
+
+protected:
+    std::vector<pollfd> mPfds;
+    std::unordered_map<int, size_t> mIndexes;
+}; // class IPCPollPoller
+
+/******************************************************************************
+ * Edge-triggered epoll(...) backend
+ *****************************************************************************/
+
+class IPCEpollPoller : public IPCPoller {
+public:
+    IPCEpollPoller();
+    ~IPCEpollPoller();
+
+    void add(int fd, short events) override;
+    void modify(int fd, short events) override;
+    void remove(int fd) override;
+    int wait(std::vector<Event>& events, int timeout) override;
+
+protected:
+    int mEfd = 0;
+    size_t mCount = 0;
+    std::vector<epoll_event> mEvents;
+}; // class IPCEpollPoller
+
+} // namespace UT
+
+#endif // UT_IPC_POLLER_H
\ No newline at end of file
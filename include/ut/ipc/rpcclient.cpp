@@ -0,0 +1,196 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+#include "rpcclient.h"
+
+namespace UT {
+
+/******************************************************************************
+ * Constructors / Destructors
+ *****************************************************************************/
+
+IPCRpcClient::IPCRpcClient() {
+    setFramed(true);
+    mTimer = new std::thread(&IPCRpcClient::expire, this);
+}
+
+IPCRpcClient::~IPCRpcClient() {
+    stop();
+
+    {
+        std::unique_lock lock(mCallsMutex);
+        mExpiring = false;
+    }
+    mDeadlinesChanged.notify_all();
+    mTimer->join();
+    delete mTimer;
+    mTimer = nullptr;
+}
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+std::future<IPCRpcClient::Response> IPCRpcClient::call(uint32_t method, const void* data, size_t bytes, unsigned int timeout) {
+    auto promise = std::make_shared<std::promise<Response>>();
+    auto future = promise->get_future();
+
+    call(method, data, bytes, [promise] (Response response) {
+        promise->set_value(std::move(response));
+    }, timeout);
+
+    return future;
+}
+
+void IPCRpcClient::call(uint32_t method, const void* data, size_t bytes, Callback callback, unsigned int timeout) {
+    if (!getReady()) {
+        callback({ IPCRpcStatus::kDisconnected, nullptr, 0 });
+        return;
+    }
+
+    uint32_t id = mNextId++;
+    if (!id) { // 0 marks frames outside of calls
+        id = mNextId++;
+    }
+
+    // Registered first, the response may arrive before sendFrame(...) returns
+    {
+        std::unique_lock lock(mCallsMutex);
+        auto deadline = mDeadlines.emplace(Clock::now() + std::chrono::milliseconds(timeout ? timeout : mTimeout), id);
+        mCalls.emplace(id, Call { std::move(callback), deadline });
+        if (deadline == mDeadlines.begin()) {
+            mDeadlinesChanged.notify_all();
+        }
+    }
+
+    IPCFrameHeader header;
+    header.size = static_cast<uint32_t>(bytes);
+    header.type = method;
+    header.flags = IPCFrameHeader::kRequest;
+    header.id = id;
+
+    bool sent;
+    try {
+        sent = sendFrame(header, data, {});
+    } catch (...) {
+        std::unique_lock lock(mCallsMutex);
+        auto it = mCalls.find(id);
+        if (it != mCalls.end()) {
+            mDeadlines.erase(it->second.deadline);
+            mCalls.erase(it);
+        }
+        throw;
+    }
+
+    // Lost the connection since getReady(), no response is coming
+    if (!sent) {
+        complete(id, { IPCRpcStatus::kDisconnected, nullptr, 0 });
+    }
+}
+
+IPCRpcClient::RetCode IPCRpcClient::stop() {
+    RetCode ret = IPCClient::stop();
+    failAll(IPCRpcStatus::kDisconnected);
+    return ret;
+}
+
+/******************************************************************************
+ * Methods (Protected)
+ *****************************************************************************/
+
+void IPCRpcClient::dispatchMessage(const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+    if (!(header.flags & IPCFrameHeader::kResponse)) {
+        IPCClient::dispatchMessage(header, std::move(data), bytes);
+        return;
+    }
+
+    complete(header.id, { static_cast<IPCRpcStatus>(header.type), std::move(data), bytes });
+}
+
+void IPCRpcClient::disconnect() {
+    IPCClient::disconnect();
+    failAll(IPCRpcStatus::kDisconnected);
+}
+
+void IPCRpcClient::complete(uint32_t id, Response response) {
+    Callback callback;
+    {
+        std::unique_lock lock(mCallsMutex);
+        auto it = mCalls.find(id);
+        if (it == mCalls.end()) { // Timed out already
+            return;
+        }
+        callback = std::move(it->second.callback);
+        mDeadlines.erase(it->second.deadline);
+        mCalls.erase(it);
+    }
+
+    callback(std::move(response));
+}
+
+void IPCRpcClient::failAll(IPCRpcStatus status) {
+    std::unordered_map<uint32_t, Call> calls;
+    {
+        std::unique_lock lock(mCallsMutex);
+        calls.swap(mCalls);
+        mDeadlines.clear();
+    }
+
+    for (auto& [id, call] : calls) {
+        call.callback({ status, nullptr, 0 });
+    }
+}
+
+void IPCRpcClient::expire() {
+    std::unique_lock lock(mCallsMutex);
+
+    while (mExpiring) {
+        if (mDeadlines.empty()) {
+            mDeadlinesChanged.wait(lock);
+            continue;
+        }
+
+        auto now = Clock::now();
+        auto deadline = mDeadlines.begin()->first;
+        if (deadline > now) {
+            mDeadlinesChanged.wait_until(lock, deadline);
+            continue;
+        }
+
+        // Callbacks run unlocked, they may issue new calls
+        std::vector<Callback> expired;
+        while (!mDeadlines.empty() && mDeadlines.begin()->first <= now) {
+            auto it = mCalls.find(mDeadlines.begin()->second);
+            expired.push_back(std::move(it->second.callback));
+            mCalls.erase(it);
+            mDeadlines.erase(mDeadlines.begin());
+        }
+
+        lock.unlock();
+        for (auto& callback : expired) {
+            callback({ IPCRpcStatus::kTimeout, nullptr, 0 });
+        }
+        lock.lock();
+    }
+}
+
+} // namespace UT
\ No newline at end of file
@@ -0,0 +1,121 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+#ifndef UT_IPC_RPC_CLIENT_H
+#define UT_IPC_RPC_CLIENT_H
+
+#define UT_IPC_RPC_TIMEOUT 5000 // ms
+
+#include "ut/ipc/client.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <unordered_map>
+
+namespace UT {
+
+// IPCClient issuing calls to IPCRpcServer, framing is always enabled. Calls
+// are pipelined over the connection and matched to their responses by id
+class IPCRpcClient : public IPCClient {
+public:
+    struct Response {
+        IPCRpcStatus status;
+        std::shared_ptr<void> data;
+        ssize_t bytes;
+    }; // struct Response
+
+    // Called on the client thread, on the timer thread when the call times
+    // out, or on the caller's when it can't be sent
+    using Callback = std::function<void(Response)>;
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCRpcClient();
+    IPCRpcClient(const IPCRpcClient&) = delete;
+    IPCRpcClient(IPCRpcClient&&) = delete;
+    ~IPCRpcClient() override;
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // A timeout of 0 uses getTimeout()
+    std::future<Response> call(uint32_t method, const void* data, size_t bytes, unsigned int timeout = 0);
+    void call(uint32_t method, const void* data, size_t bytes, Callback callback, unsigned int timeout = 0);
+    // Calls still in flight complete with IPCRpcStatus::kDisconnected
+    RetCode stop();
+
+    /**************************************************************************
+     * Accessors / Mutators
+     *************************************************************************/
+
+    // Default per call timeout in ms
+    unsigned int getTimeout() const;
+    void setTimeout(unsigned int timeout);
+
+protected:
+    using Clock = std::chrono::steady_clock;
+
+    struct Call {
+        Callback callback;
+        std::multimap<Clock::time_point, uint32_t>::iterator deadline;
+    }; // struct Call
+
+    /**************************************************************************
+     * Methods (Protected)
+     *************************************************************************/
+
+    void dispatchMessage(const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) override;
+    void disconnect() override;
+    void complete(uint32_t id, Response response);
+    void failAll(IPCRpcStatus status);
+    void expire();
+
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    std::atomic<uint32_t> mNextId = 1;
+    unsigned int mTimeout = UT_IPC_RPC_TIMEOUT;
+    std::mutex mCallsMutex; // guards everything below
+    std::condition_variable mDeadlinesChanged;
+    std::unordered_map<uint32_t, Call> mCalls;
+    std::multimap<Clock::time_point, uint32_t> mDeadlines;
+    bool mExpiring = true;
+    std::thread* mTimer = nullptr;
+}; // class IPCRpcClient
+
+/******************************************************************************
+ * Inline Definition: Accessors / Mutators
+ *****************************************************************************/
+
+inline unsigned int IPCRpcClient::getTimeout() const { return mTimeout; }
+inline void IPCRpcClient::setTimeout(unsigned int timeout) { mTimeout = timeout; }
+
+} // namespace UT
+
+#endif // UT_IPC_RPC_CLIENT_H
\ No newline at end of file
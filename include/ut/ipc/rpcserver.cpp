@@ -0,0 +1,111 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+#include "rpcserver.h"
+
+namespace UT {
+
+/******************************************************************************
+ * Constructors / Destructors
+ *****************************************************************************/
+
+IPCRpcServer::IPCRpcServer() {
+    setFramed(true);
+}
+
+IPCRpcServer::~IPCRpcServer() {
+    // Reactors may still be dispatching into the handlers
+    stop();
+}
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+void IPCRpcServer::bind(uint32_t method, Handler handler) {
+    auto shared = std::make_shared<const Handler>(std::move(handler));
+    std::unique_lock lock(mHandlersMutex);
+    mHandlers[method] = std::move(shared);
+}
+
+void IPCRpcServer::unbind(uint32_t method) {
+    std::shared_ptr<const Handler> handler; // released unlocked
+    std::unique_lock lock(mHandlersMutex);
+    auto it = mHandlers.find(method);
+    if (it != mHandlers.end()) {
+        handler = std::move(it->second);
+        mHandlers.erase(it);
+    }
+}
+
+void IPCRpcServer::reply(IPCClientId client, uint32_t id, const void* data, size_t bytes) {
+    respond(client, id, IPCRpcStatus::kSuccess, data, bytes);
+}
+
+void IPCRpcServer::fail(IPCClientId client, uint32_t id, const std::string& error) {
+    respond(client, id, IPCRpcStatus::kFailed, error.data(), error.size());
+}
+
+/******************************************************************************
+ * Methods (Protected)
+ *****************************************************************************/
+
+void IPCRpcServer::dispatchMessage(IPCClientId client, const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+    if (!(header.flags & IPCFrameHeader::kRequest)) {
+        IPCServer::dispatchMessage(client, header, std::move(data), bytes);
+        return;
+    }
+
+    // Called unlocked, the handler may bind or unbind
+    std::shared_ptr<const Handler> handler;
+    {
+        std::shared_lock lock(mHandlersMutex);
+        auto it = mHandlers.find(header.type);
+        if (it != mHandlers.end()) {
+            handler = it->second;
+        }
+    }
+
+    if (!handler) {
+        respond(client, header.id, IPCRpcStatus::kUnknownMethod, nullptr, 0);
+        return;
+    }
+
+    // A throwing handler fails the call instead of the reactor
+    try {
+        (*handler)(client, header.id, std::move(data), bytes);
+    } catch (const std::exception& e) {
+        fail(client, header.id, e.what());
+    }
+}
+
+void IPCRpcServer::respond(IPCClientId client, uint32_t id, IPCRpcStatus status, const void* data, size_t bytes) {
+    IPCFrameHeader header;
+    header.size = static_cast<uint32_t>(bytes);
+    header.type = static_cast<uint32_t>(status);
+    header.flags = IPCFrameHeader::kResponse;
+    header.id = id;
+
+    sendFrame(client, header, data, {});
+}
+
+} // namespace UT
\ No newline at end of file
@@ -0,0 +1,82 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+#ifndef UT_IPC_RPC_SERVER_H
+#define UT_IPC_RPC_SERVER_H
+
+#include "ut/ipc/server.h"
+
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace UT {
+
+// IPCServer answering calls of IPCRpcClient, framing is always enabled.
+// Requests of a client are dispatched in order, but replies may be sent
+// later and from any thread, so many calls can be in flight per connection
+class IPCRpcServer : public IPCServer {
+public:
+    // Called on the reactor thread, has to end up in reply(...) or
+    // fail(...) with "id", anything slow should be handed off
+    using Handler = std::function<void(IPCClientId, uint32_t, std::shared_ptr<void>, ssize_t)>;
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCRpcServer();
+    IPCRpcServer(const IPCRpcServer&) = delete;
+    IPCRpcServer(IPCRpcServer&&) = delete;
+    ~IPCRpcServer() override;
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Safe while running, takes effect on the next request. A handler
+    // unbound while it runs is released once it returns
+    void bind(uint32_t method, Handler handler);
+    void unbind(uint32_t method);
+    void reply(IPCClientId client, uint32_t id, const void* data, size_t bytes);
+    void fail(IPCClientId client, uint32_t id, const std::string& error);
+
+protected:
+    /**************************************************************************
+     * Methods (Protected)
+     *************************************************************************/
+
+    void dispatchMessage(IPCClientId client, const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) override;
+    void respond(IPCClientId client, uint32_t id, IPCRpcStatus status, const void* data, size_t bytes);
+
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    std::shared_mutex mHandlersMutex;
+    std::unordered_map<uint32_t, std::shared_ptr<const Handler>> mHandlers;
+}; // class IPCRpcServer
+
+} // namespace UT
+
+#endif // UT_IPC_RPC_SERVER_H
\ No newline at end of file
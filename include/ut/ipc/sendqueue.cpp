@@ -0,0 +1,458 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#include "sendqueue.h"
+#include "bufferpool.h"
+#include "descriptors.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace UT {
+
+/******************************************************************************
+ * Constructors / Destructors
+ *****************************************************************************/
+
+IPCSendQueue::~IPCSendQueue() {
+    for (auto& chunk : mChunks) {
+        IPCDescriptors::close(chunk.fds);
+    }
+}
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+void IPCSendQueue::push(std::shared_ptr<void> data, size_t bytes) {
+    if (!bytes) {
+        return;
+    }
+
+    mChunks.push_back({ std::move(data), 0, bytes, {}, now() });
+    mBytes += bytes;
+}
+
+void IPCSendQueue::push(std::shared_ptr<void> data, size_t bytes, std::vector<int> fds) {
+    if (!bytes) {
+        IPCDescriptors::close(fds);
+        return;
+    }
+
+    mChunks.push_back({ std::move(data), 0, bytes, std::move(fds), now() });
+    mBytes += bytes;
+}
+
+void IPCSendQueue::publish(std::shared_ptr<void> data, size_t bytes) {
+    if (!bytes) {
+        return;
+    }
+
+    mChunks.push_back({ std::move(data), 0, bytes, {}, now(), 0, true });
+    mBytes += bytes;
+}
+
+void IPCSendQueue::append(const void* data, size_t bytes, size_t capacity) {
+    if (!bytes) {
+        return;
+    }
+
+    // Gathered chunks are described to the kernel already
+    if (!mPackets && mChunks.size() > mGathered) {
+        auto& back = mChunks.back();
+        size_t end = back.offset + back.bytes;
+        if (back.capacity && back.capacity - end >= bytes) {
+            memcpy(static_cast<char*>(back.data.get()) + end, data, bytes);
+            back.bytes += bytes;
+            mBytes += bytes;
+            return;
+        }
+    }
+
+    capacity = std::max(capacity, bytes);
+    auto block = IPCBufferPool::getInstance().acquire(capacity);
+    memcpy(block.get(), data, bytes);
+    mChunks.push_back({ std::move(block), 0, bytes, {}, now(), mPackets ? 0 : capacity });
+    mBytes += bytes;
+}
+
+void IPCSendQueue::pushChannel(const IPCFrameHeader& header, std::shared_ptr<void> data) {
+    // A channel keeps its lane until it runs dry, so its messages stay in
+    // order whatever its priority became meanwhile
+    for (auto& [priority, lanes] : mLanes) {
+        for (auto& lane : lanes) {
+            if (lane.channel == header.channel) {
+                lane.messages.emplace_back(header, std::move(data));
+                mBytes += header.size;
+                mPending += header.size;
+                return;
+            }
+        }
+    }
+
+    Lane lane = { header.channel, {}, 0 };
+    lane.messages.emplace_back(header, std::move(data));
+    mLanes[getPriority(header.channel)].push_back(std::move(lane));
+    mBytes += header.size;
+    mPending += header.size;
+}
+
+void IPCSendQueue::pushFile(const IPCFrameHeader* header, std::shared_ptr<int> fd, off_t position, size_t bytes) {
+    pushSource(header, std::move(fd), position, bytes);
+}
+
+void IPCSendQueue::pushPipe(const IPCFrameHeader* header, std::shared_ptr<int> fd, size_t bytes) {
+    pushSource(header, std::move(fd), -1, bytes);
+}
+
+IPCSendQueue::RetCode IPCSendQueue::flush(int fd) {
+    if (mPackets) {
+        return flushPackets(fd);
+    }
+
+    iovec iov[UT_IPC_IOV_MAX];
+
+    refill();
+
+    while (!mChunks.empty()) {
+        ssize_t ret = 0;
+        auto& front = mChunks.front();
+
+        if (front.source != -1) {
+            ret = transfer(fd);
+        } else if (!front.fds.empty()) {
+            // Goes out alone, so the descriptors are attached to the first
+            // byte of the chunk
+            ret = IPCDescriptors::send(fd, static_cast<char*>(front.data.get()) + front.offset, front.bytes, front.fds);
+            if (ret > 0) {
+                IPCDescriptors::close(front.fds);
+                front.fds.clear();
+            }
+        } else {
+            // Chunks carrying descriptors or coming from a file break the
+            // batch
+            size_t count = 0;
+            for (auto it = mChunks.begin(); it != mChunks.end() && count < UT_IPC_IOV_MAX && it->fds.empty() && it->source == -1; ++it, ++count) {
+                iov[count].iov_base = static_cast<char*>(it->data.get()) + it->offset;
+                iov[count].iov_len = it->bytes;
+            }
+
+            msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+
+            ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        }
+
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return RetCode::kPending;
+            }
+            return RetCode::kFailed;
+        }
+
+        consume(static_cast<size_t>(ret));
+        refill();
+    }
+
+    return RetCode::kSuccess;
+}
+
+bool IPCSendQueue::gather(msghdr& msg, iovec* iov, void* control) {
+    refill();
+    if (mChunks.empty()) {
+        return false;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+
+    auto& front = mChunks.front();
+    if (!front.fds.empty()) {
+        iov[0].iov_base = static_cast<char*>(front.data.get()) + front.offset;
+        iov[0].iov_len = front.bytes;
+        msg.msg_iovlen = 1;
+        IPCDescriptors::attach(msg, control, front.fds);
+        mGathered = 1;
+        return true;
+    }
+
+    // A single message carries a single packet
+    size_t limit = mPackets ? 1 : UT_IPC_IOV_MAX;
+    size_t count = 0;
+    for (auto it = mChunks.begin(); it != mChunks.end() && count < limit && it->fds.empty() && it->source == -1; ++it, ++count) {
+        iov[count].iov_base = static_cast<char*>(it->data.get()) + it->offset;
+        iov[count].iov_len = it->bytes;
+    }
+    msg.msg_iovlen = count;
+    mGathered = count;
+
+    return true;
+}
+
+void IPCSendQueue::commit(size_t bytes) {
+    mGathered = 0;
+    if (!bytes) {
+        return;
+    }
+
+    auto& front = mChunks.front();
+    if (!front.fds.empty()) {
+        IPCDescriptors::close(front.fds);
+        front.fds.clear();
+    }
+    consume(bytes);
+}
+
+IPCSendQueue::RetCode IPCSendQueue::splice(int fd) {
+    while (!mChunks.empty() && mChunks.front().source != -1) {
+        ssize_t ret = transfer(fd);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return RetCode::kPending;
+            }
+            return RetCode::kFailed;
+        }
+
+        consume(static_cast<size_t>(ret));
+    }
+
+    return RetCode::kSuccess;
+}
+
+size_t IPCSendQueue::drop(size_t bytes) {
+    size_t freed = 0;
+
+    auto begin = mChunks.begin() + std::min(mGathered, mChunks.size());
+    for (auto it = begin; it != mChunks.end() && freed < bytes; ) {
+        if (it->offset || !it->published) {
+            ++it;
+            continue;
+        }
+        freed += it->bytes;
+        it = mChunks.erase(it);
+    }
+
+    mBytes -= freed;
+    return freed;
+}
+
+void IPCSendQueue::clear() {
+    size_t kept = std::min(mGathered, mChunks.size());
+    for (size_t i = kept; i < mChunks.size(); ++i) {
+        mBytes -= mChunks[i].bytes;
+        IPCDescriptors::close(mChunks[i].fds);
+    }
+    mChunks.erase(mChunks.begin() + kept, mChunks.end());
+
+    mBytes -= mPending;
+    mPending = 0;
+    mLanes.clear();
+}
+
+/******************************************************************************
+ * Accessors / Mutators
+ *****************************************************************************/
+
+int IPCSendQueue::getPriority(uint32_t channel) const {
+    auto it = mPriorities.find(channel);
+    return it != mPriorities.end() ? it->second : 0;
+}
+
+/******************************************************************************
+ * Methods (Protected)
+ *****************************************************************************/
+
+void IPCSendQueue::consume(size_t bytes) {
+    // Drop fully written chunks, a partially written one stays in front
+    mBytes -= bytes;
+    if (mCounters) {
+        mCounters->add(IPCCounters::kBytesSent, bytes);
+    }
+
+    auto completed = mWait ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    while (bytes) {
+        auto& chunk = mChunks.front();
+        if (bytes < chunk.bytes) {
+            chunk.offset += bytes;
+            chunk.bytes -= bytes;
+            break;
+        }
+        bytes -= chunk.bytes;
+        if (mWait) {
+            mWait->record(std::chrono::duration_cast<std::chrono::nanoseconds>(completed - chunk.queued).count());
+        }
+        mChunks.pop_front();
+    }
+}
+
+IPCSendQueue::RetCode IPCSendQueue::flushPackets(int fd) {
+    mmsghdr messages[UT_IPC_IOV_MAX];
+    iovec iov[UT_IPC_IOV_MAX];
+    alignas(cmsghdr) char control[UT_IPC_IOV_MAX][IPCDescriptors::kControlSize];
+
+    // Packets are sent whole or not at all, descriptors travel with the
+    // packet they belong to
+    refill();
+    while (!mChunks.empty()) {
+        size_t count = 0;
+        for (auto it = mChunks.begin(); it != mChunks.end() && count < UT_IPC_IOV_MAX; ++it, ++count) {
+            iov[count].iov_base = static_cast<char*>(it->data.get()) + it->offset;
+            iov[count].iov_len = it->bytes;
+
+            memset(&messages[count], 0, sizeof(messages[count]));
+            messages[count].msg_hdr.msg_iov = &iov[count];
+            messages[count].msg_hdr.msg_iovlen = 1;
+            IPCDescriptors::attach(messages[count].msg_hdr, control[count], it->fds);
+        }
+
+        int ret = sendmmsg(fd, messages, count, MSG_NOSIGNAL);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return RetCode::kPending;
+            }
+            return RetCode::kFailed;
+        }
+
+        size_t bytes = 0;
+        for (int i = 0; i < ret; ++i) {
+            bytes += iov[i].iov_len;
+            IPCDescriptors::close(mChunks[i].fds);
+            mChunks[i].fds.clear();
+        }
+        consume(bytes);
+        refill();
+    }
+
+    return RetCode::kSuccess;
+}
+
+ssize_t IPCSendQueue::transfer(int fd) {
+    auto& front = mChunks.front();
+
+    ssize_t ret;
+    if (front.position != -1) {
+        off_t position = front.position + front.offset;
+        ret = sendfile(fd, front.source, &position, front.bytes);
+    } else {
+        ret = ::splice(front.source, nullptr, fd, nullptr, front.bytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    }
+
+    // A file cut short or a drained pipe would leave the peer waiting for
+    // bytes that never come
+    if (ret == 0) {
+        errno = EPIPE;
+        return -1;
+    }
+
+    return ret;
+}
+
+void IPCSendQueue::pushSource(const IPCFrameHeader* header, std::shared_ptr<int> fd, off_t position, size_t bytes) {
+    if (header) {
+        auto block = IPCBufferPool::getInstance().acquire(sizeof(*header));
+        memcpy(block.get(), header, sizeof(*header));
+        mChunks.push_back({ std::move(block), 0, sizeof(*header), {}, now() });
+        mBytes += sizeof(*header);
+    }
+
+    if (bytes) {
+        int source = *fd;
+        mChunks.push_back({ std::move(fd), 0, bytes, {}, now(), 0, false, source, position });
+        mBytes += bytes;
+    }
+}
+
+void IPCSendQueue::refill() {
+    size_t limit = mPackets ? std::min(mChunkSize, UT_IPC_PACKET_MAX_SIZE - sizeof(IPCFrameHeader)) : mChunkSize;
+    auto& pool = IPCBufferPool::getInstance();
+
+    while (!mLanes.empty() && mBytes - mPending < mChunkSize) {
+        auto level = mLanes.begin();
+        auto lane = std::move(level->second.front());
+        level->second.pop_front();
+
+        auto& [message, data] = lane.messages.front();
+        size_t bytes = std::min(limit, message.size - lane.offset);
+        auto header = message;
+        header.size = static_cast<uint32_t>(bytes);
+        if (lane.offset + bytes < message.size) {
+            header.flags |= IPCFrameHeader::kPartial;
+        }
+
+        // The payload is referenced in place, a packet has to be a single
+        // chunk though
+        char* payload = static_cast<char*>(data.get()) + lane.offset;
+        if (mPackets) {
+            auto block = pool.acquire(sizeof(header) + bytes);
+            memcpy(block.get(), &header, sizeof(header));
+            if (bytes) {
+                memcpy(static_cast<char*>(block.get()) + sizeof(header), payload, bytes);
+            }
+            mChunks.push_back({ std::move(block), 0, sizeof(header) + bytes, {}, now() });
+        } else {
+            auto block = pool.acquire(sizeof(header));
+            memcpy(block.get(), &header, sizeof(header));
+            mChunks.push_back({ std::move(block), 0, sizeof(header), {}, now() });
+            if (bytes) {
+                mChunks.push_back({ std::shared_ptr<void>(data, payload), 0, bytes, {}, now() });
+            }
+        }
+        mBytes += sizeof(header);
+        mPending -= bytes;
+
+        lane.offset += bytes;
+        if (lane.offset == message.size) {
+            lane.messages.pop_front();
+            lane.offset = 0;
+        }
+
+        // Round robin: the lane goes behind the others of its priority
+        if (!lane.messages.empty()) {
+            level->second.push_back(std::move(lane));
+        } else if (level->second.empty()) {
+            mLanes.erase(level);
+        }
+    }
+}
+
+std::chrono::steady_clock::time_point IPCSendQueue::now() const {
+    // Skip the clock read when nobody looks at the wait times
+    return mWait ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+}
+
+} // namespace UT
\ No newline at end of file
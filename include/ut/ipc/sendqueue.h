@@ -0,0 +1,197 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_SEND_QUEUE_H
+#define UT_IPC_SEND_QUEUE_H
+
+#define UT_IPC_IOV_MAX 64
+#define UT_IPC_CHUNK_SIZE (16 * 1024)
+
+#include "common.h"
+#include "metrics.h"
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <sys/socket.h>
+#include <unordered_map>
+#include <vector>
+
+namespace UT {
+
+// Outbound byte stream of a connection made of refcounted chunks, flushed
+// with as many chunks per syscall as possible
+class IPCSendQueue {
+public:
+    enum class RetCode;
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCSendQueue() = default;
+    IPCSendQueue(const IPCSendQueue&) = delete;
+    IPCSendQueue(IPCSendQueue&&) = default;
+    ~IPCSendQueue();
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    void push(std::shared_ptr<void> data, size_t bytes);
+    // Takes ownership of "fds", they are closed once passed to the peer
+    void push(std::shared_ptr<void> data, size_t bytes, std::vector<int> fds);
+    // Same as push(...) for broadcast data, which drop(...) may discard
+    void publish(std::shared_ptr<void> data, size_t bytes);
+    // Copies "data" right behind the last chunk when it was appended as well
+    // and has room left, otherwise into a new pooled block of at least
+    // "capacity" bytes. Coalesces small writes, never in packet mode
+    void append(const void* data, size_t bytes, size_t capacity);
+    // Queues a message of header.size bytes on logical channel
+    // header.channel. It's only cut into frames of at most getChunkSize()
+    // bytes as the queue drains: highest priority channel first, round robin
+    // among channels of the same priority. Pushed and appended data and more
+    // urgent channels thus overtake large messages, at most a chunk behind.
+    // With kPartial set in "header" the message continues with the next one
+    // queued on the channel
+    void pushChannel(const IPCFrameHeader& header, std::shared_ptr<void> data);
+    // "bytes" of a regular file from "position" or of a pipe go straight
+    // from "fd" to the socket with sendfile(...) / splice(...), preceded by
+    // "header" unless null. The queue keeps "fd" open until then, a pipe
+    // must hold at least "bytes" bytes. Not in packet mode
+    void pushFile(const IPCFrameHeader* header, std::shared_ptr<int> fd, off_t position, size_t bytes);
+    void pushPipe(const IPCFrameHeader* header, std::shared_ptr<int> fd, size_t bytes);
+    // Writes until the queue is empty or the socket would block
+    RetCode flush(int fd);
+    // Asynchronous counterpart of flush(...): describes the head of the
+    // queue in "msg", "iov" has to hold UT_IPC_IOV_MAX entries and "control"
+    // IPCDescriptors::kControlSize bytes. Gathered chunks stay in place until
+    // commit(...), returns false when there is nothing to send
+    bool gather(msghdr& msg, iovec* iov, void* control);
+    // Completes the last gather(...) with the number of bytes written
+    void commit(size_t bytes);
+    // Writes the file and pipe chunks at the head of the queue, which
+    // gather(...) can't describe. kSuccess once a regular chunk or nothing
+    // is left in front
+    RetCode splice(int fd);
+    // Drops untouched published chunks oldest first until at least "bytes"
+    // are freed, partially written and gathered ones are kept. Returns the
+    // number of bytes freed
+    size_t drop(size_t bytes);
+    // Gathered chunks are kept until their commit(...)
+    void clear();
+
+    /**************************************************************************
+     * Accessors / Mutators
+     *************************************************************************/
+
+    size_t getBytes() const;
+    bool isEmpty() const;
+    // Written bytes are added to "counters" and the time each chunk spent
+    // queued to "wait", either may be null
+    void setMetrics(IPCCounters* counters, IPCHistogram* wait);
+    // Every chunk leaves as a packet of its own instead of being coalesced,
+    // for SOCK_SEQPACKET sockets
+    bool getPackets() const;
+    void setPackets(bool packets);
+    // Higher goes first, 0 by default. Channels with queued messages keep
+    // the priority they were queued with
+    int getPriority(uint32_t channel) const;
+    void setPriority(uint32_t channel, int priority);
+    // Payload bytes per frame of channel messages, capped by the packet size
+    // in packet mode
+    size_t getChunkSize() const;
+    void setChunkSize(size_t bytes);
+
+protected:
+    struct Chunk {
+        std::shared_ptr<void> data;
+        size_t offset;
+        size_t bytes;
+        std::vector<int> fds;
+        std::chrono::steady_clock::time_point queued;
+        size_t capacity = 0; // of appended blocks, 0 for pushed ones
+        bool published = false; // the only chunks drop(...) may remove
+        int source = -1; // file or pipe the bytes come from, kept open by "data"
+        off_t position = -1; // in a file source, -1 for pipes
+    }; // struct Chunk
+
+    // Channel with queued messages, the first one partially cut into frames
+    struct Lane {
+        uint32_t channel;
+        std::deque<std::pair<IPCFrameHeader, std::shared_ptr<void>>> messages;
+        size_t offset;
+    }; // struct Lane
+
+    /**************************************************************************
+     * Methods (Protected)
+     *************************************************************************/
+
+    void consume(size_t bytes);
+    // Writes from the source of the chunk in front
+    ssize_t transfer(int fd);
+    void pushSource(const IPCFrameHeader* header, std::shared_ptr<int> fd, off_t position, size_t bytes);
+    // Cuts channel messages into frames until about a chunk is queued
+    void refill();
+    RetCode flushPackets(int fd);
+    std::chrono::steady_clock::time_point now() const;
+
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    std::deque<Chunk> mChunks;
+    size_t mBytes = 0;
+    size_t mGathered = 0; // chunks referenced by an asynchronous send
+    bool mPackets = false;
+    IPCCounters* mCounters = nullptr;
+    IPCHistogram* mWait = nullptr;
+    std::map<int, std::deque<Lane>, std::greater<int>> mLanes; // by priority
+    std::unordered_map<uint32_t, int> mPriorities;
+    size_t mPending = 0; // payload bytes in mLanes, part of mBytes
+    size_t mChunkSize = UT_IPC_CHUNK_SIZE;
+}; // class IPCSendQueue
+
+enum class IPCSendQueue::RetCode {
+    kSuccess,
+    kPending,
+    kFailed
+}; // IPCSendQueue::RetCode
+
+/******************************************************************************
+ * Inline Definition: Accessors / Mutators
+ *****************************************************************************/
+
+inline size_t IPCSendQueue::getBytes() const { return mBytes; }
+inline bool IPCSendQueue::isEmpty() const { return mChunks.empty() && mLanes.empty(); }
+inline bool IPCSendQueue::getPackets() const { return mPackets; }
+inline void IPCSendQueue::setPackets(bool packets) { mPackets = packets; }
+inline void IPCSendQueue::setPriority(uint32_t channel, int priority) { mPriorities[channel] = priority; }
+inline size_t IPCSendQueue::getChunkSize() const { return mChunkSize; }
+inline void IPCSendQueue::setChunkSize(size_t bytes) { mChunkSize = bytes; }
+inline void IPCSendQueue::setMetrics(IPCCounters* counters, IPCHistogram* wait) { mCounters = counters; mWait = wait; }
+
+} // namespace UT
+
+#endif // UT_IPC_SEND_QUEUE_H
\ No newline at end of file
@@ -21,14 +21,56 @@
  *****************************************************************************/
 
 #include "server.h"
+#include "bufferpool.h"
+#include "descriptors.h"
 
+#include <algorithm>
+#include <chrono>
 #include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
 namespace UT {
 
+namespace {
+
+// Requests on the ring carry their connection and kind in the user data,
+// connections are 16 byte aligned so the kind fits the low bits
+enum Operation : uint64_t {
+    kWakeUp,
+    kAccept,
+    kReceive,
+    kReadable,
+    kChannel,
+    kSend,
+    kWritable,
+    kCancel,
+    kRelay
+}; // enum Operation
+
+constexpr uint64_t kOperationMask = 0xf;
+
+uint64_t tag(const void* connection, Operation operation) {
+    return reinterpret_cast<uintptr_t>(connection) | operation;
+}
+
+// Batch of the reactor running on this thread, nullptr unless batching
+thread_local std::vector<IPCServer::Received>* currentBatch = nullptr;
+
+void depart(IPCCounters& departed, const IPCCounters& counters) {
+    for (int i = 0; i < IPCCounters::kCount; ++i) {
+        auto counter = static_cast<IPCCounters::Counter>(i);
+        departed.add(counter, counters.get(counter));
+    }
+}
+
+} // namespace
+
 /******************************************************************************
  * Constructors / Destructors
  *****************************************************************************/
@@ -37,151 +79,375 @@ IPCServer::~IPCServer() {
     stop();
 }
 
+IPCServer::Connection::~Connection() {
+    for (auto& fds : descriptors) {
+        IPCDescriptors::close(fds);
+    }
+}
+
+IPCServer::Reactor::~Reactor() {
+    // The kernel lets go of the connections' send buffers first
+    ring.reset();
+    for (auto& [fd, connection] : connections) {
+        close(fd);
+    }
+    commands.drain([] (Command& command) {
+        if (command.type == Command::Type::kAdd) {
+            close(command.fd);
+        }
+    });
+    if (efd != -1) {
+        close(efd);
+    }
+    free(buffer);
+}
+
 /******************************************************************************
  * Methods
  *****************************************************************************/
 
-void IPCServer::send(int to, const void* data, size_t bytes) {
-    ::send(to, data, bytes, 0);
+void IPCServer::send(IPCClientId to, const void* data, size_t bytes) {
+    sendDescriptors(to, data, bytes, {});
 }
 
-IPCServer::RetCode IPCServer::start(const std::string& name) {
-    std::unique_lock lock(mMutex);
+void IPCServer::sendDescriptors(IPCClientId to, const void* data, size_t bytes, const std::vector<int>& fds) {
+    if (fds.size() > UT_IPC_MAX_DESCRIPTORS) {
+        throw std::invalid_argument("too many descriptors");
+    }
 
-    if (mRunning) {
-        return RetCode::kAlreadyStarted;
+    auto connection = findConnection(to);
+    if (!connection || !bytes) {
+        return;
+    }
+
+    if (connection->channel) {
+        writeShm(*connection, { static_cast<uint32_t>(bytes), 0, 0, 0, 0 }, data, fds);
+        return;
     }
 
-    mServerName = UT_IPC_SOCKET_PATH + name;
+    checkPacket(bytes);
+    auto buffer = IPCBufferPool::getInstance().acquire(bytes);
+    memcpy(buffer.get(), data, bytes);
+    enqueue(connection, std::move(buffer), bytes, IPCDescriptors::duplicate(fds));
+}
 
-    // Allocate buffer
-    mBuffer = malloc(UT_IPC_BUFFER_SIZE);
-    if (!mBuffer) {
-        throw std::runtime_error("malloc(...) failed, errno: " + std::to_string(errno));
+void IPCServer::sendMessage(IPCClientId to, uint32_t type, const void* data, size_t bytes) {
+    sendMessage(to, type, data, bytes, {});
+}
+
+void IPCServer::sendMessage(IPCClientId to, uint32_t type, const void* data, size_t bytes, const std::vector<int>& fds) {
+    sendFrame(to, { static_cast<uint32_t>(bytes), type, 0, 0, 0 }, data, fds);
+}
+
+void IPCServer::sendChannel(IPCClientId to, uint32_t channel, uint32_t type, const void* data, size_t bytes) {
+    if (!channel) {
+        sendMessage(to, type, data, bytes);
+        return;
     }
 
-    // Initialize pipes
-    int ret = pipe(mPipe);
-    if (ret == -1) {
-        free(mBuffer);
-        mBuffer = nullptr;
-        throw std::runtime_error("pipe(...) failed, errno: " + std::to_string(errno));
+    auto connection = findConnection(to);
+    if (!connection) {
+        return;
     }
 
-    ret = fcntl(mPipe[0], F_GETFL, nullptr);
-    if (ret == -1) {
-        close(mPipe[0]);
-        close(mPipe[1]);
-        free(mBuffer);
-        mPipe[0] = 0;
-        mPipe[1] = 0;
-        mBuffer = nullptr;
-        throw std::runtime_error("fcntl(..., F_GETFL, ...) failed, errno: " + std::to_string(errno));
+    IPCFrameHeader header = { static_cast<uint32_t>(bytes), type, 0, 0, channel };
+    if (connection->channel) {
+        writeShm(*connection, header, data);
+        return;
     }
 
-    ret = fcntl(mPipe[0], F_SETFL, ret |= O_NONBLOCK);
-    if (ret == -1) {
-        close(mPipe[0]);
-        close(mPipe[1]);
-        free(mBuffer);
-        mPipe[0] = 0;
-        mPipe[1] = 0;
-        mBuffer = nullptr;
-        throw std::runtime_error("fcntl(..., F_SETFL, ...) failed, errno: " + std::to_string(errno));
+    std::shared_ptr<void> buffer;
+    if (bytes) {
+        buffer = IPCBufferPool::getInstance().acquire(bytes);
+        memcpy(buffer.get(), data, bytes);
+    }
+
+    std::unique_lock lock(connection->mutex);
+    if (connection->closed) {
+        return;
+    }
+    connection->queue.pushChannel(header, std::move(buffer));
+    schedule(connection, lock);
+}
+
+void IPCServer::sendStream(IPCClientId to, uint32_t channel, uint32_t type, const void* data, size_t bytes, bool last) {
+    if (!channel) {
+        throw std::invalid_argument("streams need a logical channel");
+    }
+
+    if (!bytes && !last) {
+        return;
+    }
+
+    auto connection = findConnection(to);
+    if (!connection) {
+        return;
+    }
+
+    IPCFrameHeader header = { static_cast<uint32_t>(bytes), type, last ? 0 : IPCFrameHeader::kPartial, 0, channel };
+    if (connection->channel) {
+        writeShm(*connection, header, data);
+        return;
+    }
+
+    std::shared_ptr<void> buffer;
+    if (bytes) {
+        buffer = IPCBufferPool::getInstance().acquire(bytes);
+        memcpy(buffer.get(), data, bytes);
+    }
+
+    std::unique_lock lock(connection->mutex);
+    if (connection->closed) {
+        return;
+    }
+    connection->queue.pushChannel(header, std::move(buffer));
+    schedule(connection, lock);
+}
+
+void IPCServer::sendFile(IPCClientId to, int fd, off_t offset, size_t bytes, uint32_t type, uint32_t channel) {
+    if (mFramed && !channel && bytes > UT_IPC_FRAME_MAX_SIZE) {
+        throw std::length_error("message exceeds the frame size limit");
+    }
+
+    auto source = duplicate(fd, S_IFREG);
+    auto connection = findConnection(to);
+    if (!connection || (!bytes && !mFramed)) {
+        return;
+    }
+
+    std::unique_lock lock(connection->mutex);
+    if (connection->closed) {
+        return;
+    }
+
+    // Frames of at most UT_IPC_FRAME_MAX_SIZE, all but the last partial
+    size_t queued = 0;
+    do {
+        size_t piece = std::min<size_t>(bytes - queued, UT_IPC_FRAME_MAX_SIZE);
+        if (mFramed) {
+            uint32_t flags = queued + piece < bytes ? IPCFrameHeader::kPartial : 0;
+            IPCFrameHeader header = { static_cast<uint32_t>(piece), type, flags, 0, channel };
+            connection->queue.pushFile(&header, source, offset + queued, piece);
+        } else {
+            connection->queue.pushFile(nullptr, source, offset + queued, piece);
+        }
+        queued += piece;
+    } while (queued < bytes);
+
+    schedule(connection, lock);
+}
+
+void IPCServer::forward(IPCClientId to, int fd, uint32_t type, uint32_t channel) {
+    if (mFramed && !channel) {
+        throw std::invalid_argument("framed pipes are streamed, which takes a logical channel");
+    }
+
+    auto pipe = duplicate(fd, S_IFIFO);
+    auto connection = findConnection(to);
+    if (!connection) {
+        return;
+    }
+
+    post(*connection->reactor, { Command::Type::kForward, connection->fd, connection, { std::move(pipe), type, channel } });
+}
+
+void IPCServer::disconnectClient(IPCClientId client) {
+    auto connection = findConnection(client);
+    if (!connection) {
+        return;
+    }
+
+    post(*connection->reactor, { Command::Type::kDisconnect, connection->fd, connection, {} });
+}
+
+void IPCServer::subscribe(IPCClientId client, const std::string& topic) {
+    auto connection = findConnection(client);
+    if (!connection) {
+        return;
+    }
+
+    std::unique_lock lock(mTopicsMutex);
+
+    // Checked under the topics lock, disconnect() cleans up right after
+    // marking the connection closed
+    {
+        std::unique_lock connectionLock(connection->mutex);
+        if (connection->closed) {
+            return;
+        }
+    }
+
+    auto& topics = connection->topics;
+    if (std::find(topics.begin(), topics.end(), topic) != topics.end()) {
+        return;
+    }
+    topics.push_back(topic);
+
+    auto subscribers = std::make_shared<Subscribers>();
+    auto it = mTopics.find(topic);
+    if (it != mTopics.end()) {
+        subscribers->reserve(it->second->size() + 1);
+        *subscribers = *it->second;
+    }
+    subscribers->push_back(connection);
+    mTopics[topic] = std::move(subscribers);
+}
+
+void IPCServer::unsubscribe(IPCClientId client, const std::string& topic) {
+    auto connection = findConnection(client);
+    if (!connection) {
+        return;
+    }
+
+    std::unique_lock lock(mTopicsMutex);
+
+    auto& topics = connection->topics;
+    auto it = std::find(topics.begin(), topics.end(), topic);
+    if (it == topics.end()) {
+        return;
+    }
+    topics.erase(it);
+
+    unsubscribe(*connection, topic);
+}
+
+void IPCServer::publish(const std::string& topic, const void* data, size_t bytes) {
+    auto subscribers = findSubscribers(topic);
+    if (!subscribers || !bytes) {
+        return;
+    }
+    checkPacket(bytes);
+
+    std::shared_ptr<void> buffer;
+    for (auto& connection : *subscribers) {
+        // Rings belong to a single client, so only sockets share the buffer
+        if (connection->channel) {
+            writeShm(*connection, { static_cast<uint32_t>(bytes), 0, 0, 0, 0 }, data, {}, true);
+            continue;
+        }
+
+        if (!buffer) {
+            buffer = IPCBufferPool::getInstance().acquire(bytes);
+            memcpy(buffer.get(), data, bytes);
+        }
+        enqueue(connection, buffer, bytes, {}, true);
+    }
+}
+
+void IPCServer::publishMessage(const std::string& topic, uint32_t type, const void* data, size_t bytes) {
+    auto subscribers = findSubscribers(topic);
+    if (!subscribers) {
+        return;
+    }
+    checkPacket(sizeof(IPCFrameHeader) + bytes);
+
+    IPCFrameHeader header = { static_cast<uint32_t>(bytes), type, 0, 0, 0 };
+    std::shared_ptr<void> buffer;
+    for (auto& connection : *subscribers) {
+        if (connection->channel) {
+            writeShm(*connection, header, data, {}, true);
+            continue;
+        }
+
+        if (!buffer) {
+            buffer = IPCBufferPool::getInstance().acquire(sizeof(header) + bytes);
+            memcpy(buffer.get(), &header, sizeof(header));
+            if (bytes) {
+                memcpy(static_cast<char*>(buffer.get()) + sizeof(header), data, bytes);
+            }
+        }
+        enqueue(connection, buffer, sizeof(IPCFrameHeader) + bytes, {}, true);
+    }
+}
+
+IPCServer::RetCode IPCServer::start(const std::string& name) {
+    std::unique_lock lock(mMutex);
+
+    if (mRunning) {
+        return RetCode::kAlreadyStarted;
     }
 
-    pollfd pfd;
-    pfd.fd = mPipe[0];
-    pfd.events = POLLIN;
-    mPfds.push_back(pfd);
+    mServerName = mSocketPath + name;
+
+    sockaddr_un addr;
+    socklen_t length = IPCAddress::resolve(mServerName, mNamespace, addr);
+
+    // Initialize reactors, the first one accepts connections and hands them
+    // out to the rest when workers are configured
+    for (unsigned int i = 0; i <= mWorkers; ++i) {
+        try {
+            mReactors.push_back(createReactor());
+        } catch (...) {
+            mReactors.clear();
+            throw;
+        }
+    }
 
     // Initialize socket
-    mSfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    mSfd = socket(AF_UNIX, mSocketType == IPCSocketType::kSeqPacket ? SOCK_SEQPACKET : SOCK_STREAM, 0);
     if (mSfd == -1) {
-        close(mPipe[0]);
-        close(mPipe[1]);
-        free(mBuffer);
-        mPipe[0] = 0;
-        mPipe[1] = 0;
-        mBuffer = nullptr;
+        mReactors.clear();
         throw std::runtime_error("socket(...) failed, errno: " + std::to_string(errno));
     }
 
-    sockaddr_un addr;
-    memset(&addr, 0, sizeof(addr));
-
-    if (remove(mServerName.c_str()) == -1 && errno != ENOENT) {
+    // A stale inode of a previous run would fail bind(...), abstract names
+    // are released with their socket
+    if (mNamespace == IPCNamespace::kFilesystem && remove(mServerName.c_str()) == -1 && errno != ENOENT) {
         close(mSfd);
-        close(mPipe[0]);
-        close(mPipe[1]);
-        free(mBuffer);
         mSfd = 0;
-        mPipe[0] = 0;
-        mPipe[1] = 0;
-        mBuffer = nullptr;
+        mReactors.clear();
         throw std::runtime_error("remove(...) failed, errno: " + std::to_string(errno));
     }
 
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, mServerName.c_str(), sizeof(addr.sun_path));
-
-    ret = bind(mSfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    int ret = bind(mSfd, reinterpret_cast<sockaddr*>(&addr), length);
     if (ret == -1) {
         close(mSfd);
-        close(mPipe[0]);
-        close(mPipe[1]);
-        free(mBuffer);
         mSfd = 0;
-        mPipe[0] = 0;
-        mPipe[1] = 0;
-        mBuffer = nullptr;
+        mReactors.clear();
         throw std::runtime_error("bind(...) failed, errno: " + std::to_string(errno));
     }
 
     ret = listen(mSfd, UT_IPC_BACKLOG);
     if (ret == -1) {
         close(mSfd);
-        close(mPipe[0]);
-        close(mPipe[1]);
-        free(mBuffer);
         mSfd = 0;
-        mPipe[0] = 0;
-        mPipe[1] = 0;
-        mBuffer = nullptr;
+        mReactors.clear();
         throw std::runtime_error("listen(...) failed, errno: " + std::to_string(errno));
     }
 
     ret = fcntl(mSfd, F_GETFL, nullptr);
     if (ret == -1) {
         close(mSfd);
-        close(mPipe[0]);
-        close(mPipe[1]);
-        free(mBuffer);
         mSfd = 0;
-        mPipe[0] = 0;
-        mPipe[1] = 0;
-        mBuffer = nullptr;
+        mReactors.clear();
         throw std::runtime_error("fcntl(..., F_GETFL, ...) failed, errno: " + std::to_string(errno));
     }
 
     ret = fcntl(mSfd, F_SETFL, ret |= O_NONBLOCK);
     if (ret == -1) {
         close(mSfd);
-        close(mPipe[0]);
-        close(mPipe[1]);
-        free(mBuffer);
         mSfd = 0;
-        mPipe[0] = 0;
-        mPipe[1] = 0;
-        mBuffer = nullptr;
+        mReactors.clear();
         throw std::runtime_error("fcntl(..., F_SETFL, ...) failed, errno: " + std::to_string(errno));
     }
-   
-    pfd.fd = mSfd;
-    mPfds.push_back(pfd);
+
+    // With io_uring the accepting reactor arms a multishot accept instead
+    try {
+        if (mReactors[0]->poller) {
+            mReactors[0]->poller->add(mSfd, POLLIN);
+        }
+    } catch (...) {
+        close(mSfd);
+        mSfd = 0;
+        mReactors.clear();
+        throw;
+    }
 
     mRunning = true;
-    mThread = new std::thread(&IPCServer::loop, this);
+    mNextWorker = 0;
+    for (auto& reactor : mReactors) {
+        reactor->thread = new std::thread(reactor->ring ? &IPCServer::loopUring : &IPCServer::loop, this, reactor.get());
+    }
 
     return RetCode::kSuccess;
 }
@@ -193,113 +459,1494 @@ IPCServer::RetCode IPCServer::stop() {
 
     mRunning = false;
 
-    char code = '0';
-    write(mPipe[1], &code, sizeof(code));
-    mThread->join();
-    delete mThread;    
-    mThread = nullptr;
+    // Publishers and senders may still hold connections, closing them keeps
+    // their data out of queues the reactors won't flush anymore and releases
+    // the blocked ones before the reactors go away
+    for (auto& shard : mShards) {
+        std::unique_lock lock(shard.mutex);
+        shard.connections.forEach([this] (IPCClientId, const std::shared_ptr<Connection>& connection) {
+            {
+                std::unique_lock connectionLock(connection->mutex);
+                connection->closed = true;
+            }
+            connection->drained.notify_all();
+            depart(mDeparted, connection->counters);
+        });
+        mDisconnected += shard.connections.size();
+        shard.connections.clear();
+    }
+
+    {
+        std::unique_lock lock(mTopicsMutex);
+        mTopics.clear();
+    }
 
-    for (size_t i = 0; i < mPfds.size(); ++i) {
-        close(mPfds[i].fd);
+    for (auto& reactor : mReactors) {
+        wakeUp(*reactor);
+        reactor->thread->join();
+        delete reactor->thread;
+        reactor->thread = nullptr;
     }
-    mPfds.clear();
+    mReactors.clear();
 
     close(mSfd);
-    close(mPipe[0]);
-    close(mPipe[1]);
-    free(mBuffer);
     mSfd = 0;
-    mPipe[0] = 0;
-    mPipe[1] = 0;
-    mBuffer = nullptr;
+
+    if (mNamespace == IPCNamespace::kFilesystem) {
+        remove(mServerName.c_str());
+    }
 
     return RetCode::kSuccess;
 }
 
-void IPCServer::loop() {
-    int ret = 0;
-    ssize_t bytes = 0;
-
-    while (mRunning) {
-        ret = poll(mPfds.data(), mPfds.size(), -1);
+IPCServerMetrics IPCServer::getMetrics() {
+    IPCServerMetrics metrics;
+    metrics.accepted = mAccepted;
+    metrics.disconnected = mDisconnected;
 
-        if (ret > 0) {
-            // Software interrupt by pipe
-            if (mPfds[0].revents & POLLIN) {
-                mPfds[0].revents = 0;
-                read(mPipe[0], mBuffer, UT_IPC_BUFFER_SIZE);
-            }
+    {
+        // All shards at once, so no client is counted both live and departed
+        std::vector<std::shared_lock<std::shared_mutex>> locks;
+        locks.reserve(kShards);
+        size_t connections = 0;
+        for (auto& shard : mShards) {
+            locks.emplace_back(shard.mutex);
+            connections += shard.connections.size();
+        }
 
-            // New connection accept
-            if (mPfds[1].revents & POLLIN) {
-                mPfds[1].revents = 0;
+        metrics.bytesReceived = mDeparted.get(IPCCounters::kBytesReceived);
+        metrics.bytesSent = mDeparted.get(IPCCounters::kBytesSent);
+        metrics.messagesReceived = mDeparted.get(IPCCounters::kMessagesReceived);
+        metrics.messagesSent = mDeparted.get(IPCCounters::kMessagesSent);
+        metrics.droppedBytes = mDeparted.get(IPCCounters::kDroppedBytes);
 
-                int cfd = accept(mSfd, nullptr, nullptr);
-                if (cfd == -1) {
-                    continue;
+        metrics.connections.reserve(connections);
+        for (auto& shard : mShards) {
+            shard.connections.forEach([&metrics] (IPCClientId, const std::shared_ptr<Connection>& connection) {
+                IPCConnectionMetrics entry;
+                entry.client = connection->id;
+                entry.bytesReceived = connection->counters.get(IPCCounters::kBytesReceived);
+                entry.bytesSent = connection->counters.get(IPCCounters::kBytesSent);
+                entry.messagesReceived = connection->counters.get(IPCCounters::kMessagesReceived);
+                entry.messagesSent = connection->counters.get(IPCCounters::kMessagesSent);
+                entry.droppedBytes = connection->counters.get(IPCCounters::kDroppedBytes);
+                {
+                    std::unique_lock connectionLock(connection->mutex);
+                    entry.queuedBytes = connection->queue.getBytes();
                 }
 
-                ret = fcntl(cfd, F_GETFL, nullptr);
-                if (ret == -1) {
-                    close(cfd);
-                    continue;
-                }
+                metrics.bytesReceived += entry.bytesReceived;
+                metrics.bytesSent += entry.bytesSent;
+                metrics.messagesReceived += entry.messagesReceived;
+                metrics.messagesSent += entry.messagesSent;
+                metrics.droppedBytes += entry.droppedBytes;
+                metrics.queuedBytes += entry.queuedBytes;
+                metrics.connections.push_back(entry);
+            });
+        }
+    }
 
-                ret = fcntl(cfd, F_SETFL, ret |= O_NONBLOCK);
-                if (ret == -1) {
-                    close(cfd);
-                    continue;
-                }
+    std::sort(metrics.connections.begin(), metrics.connections.end(), [] (const auto& a, const auto& b) {
+        return a.client < b.client;
+    });
+    metrics.dispatchLatency = mDispatchLatency.getSnapshot();
+    metrics.queueWait = mQueueWait.getSnapshot();
 
-                pollfd pfd;
-                pfd.fd = cfd;
-                pfd.events = POLLIN;
-                mPfds.push_back(pfd);
+    return metrics;
+}
 
-                onClientConnected(cfd);
-            }
+void* IPCServer::getUserData(IPCClientId client) {
+    auto connection = findConnection(client);
+    return connection ? connection->userData.load() : nullptr;
+}
 
-            // Process data from clients
-            for (size_t i = 2; i < mPfds.size(); ++i) {
-                if (!mPfds[i].revents & POLLIN) {
-                    continue;
-                }
-                mPfds[i].revents = 0;           
-
-                bytes = 0;
-                void* data = nullptr;
-                while (true) {
-                    ret = recv(mPfds[i].fd, mBuffer, UT_IPC_BUFFER_SIZE, 0);
-
-                    if (ret > 0) {
-                        data = realloc(data, bytes + ret);
-                        memcpy(static_cast<char*>(data) + bytes, mBuffer, ret);
-                        bytes += ret;
-                    } else if (ret == 0) { // Connection closed
-                        onClientDisconnected(mPfds[i].fd);
-                        close(mPfds[i].fd);
-                        mPfds.erase(mPfds.begin() + i);
-                        --i;
-                        break;
-                    } else if (ret == -1) {
-                        break;
-                    }
-                }
+void IPCServer::setUserData(IPCClientId client, void* data) {
+    auto connection = findConnection(client);
+    if (connection) {
+        connection->userData = data;
+    }
+}
 
-                if (bytes) {
-                    onDataReceived(mPfds[i].fd, std::shared_ptr<void>(data, [] (void* data) { free(data); }), bytes);
+/******************************************************************************
+ * Methods (Protected)
+ *****************************************************************************/
+
+void IPCServer::sendFrame(IPCClientId to, IPCFrameHeader header, const void* data, const std::vector<int>& fds) {
+    if (fds.size() > UT_IPC_MAX_DESCRIPTORS) {
+        throw std::invalid_argument("too many descriptors");
+    }
+
+    auto connection = findConnection(to);
+    if (!connection) {
+        return;
+    }
+
+    if (connection->channel) {
+        writeShm(*connection, header, data, fds);
+        return;
+    }
+
+    if (!fds.empty()) {
+        header.flags |= IPCFrameHeader::kDescriptors;
+    }
+
+    // Header and payload share a single chunk of the queue
+    checkPacket(sizeof(header) + header.size);
+    auto buffer = IPCBufferPool::getInstance().acquire(sizeof(header) + header.size);
+    memcpy(buffer.get(), &header, sizeof(header));
+    if (header.size) {
+        memcpy(static_cast<char*>(buffer.get()) + sizeof(header), data, header.size);
+    }
+    enqueue(connection, std::move(buffer), sizeof(header) + header.size, IPCDescriptors::duplicate(fds));
+}
+
+void IPCServer::dispatchMessage(IPCClientId client, const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+    if (currentBatch) {
+        collect({ client, header.channel, header.type, std::move(data), bytes });
+    } else if (header.channel) {
+        onChannelMessageReceived(client, header.channel, header.type, std::move(data), bytes);
+    } else {
+        onMessageReceived(client, header.type, std::move(data), bytes);
+    }
+}
+
+void IPCServer::dispatchData(IPCClientId client, std::shared_ptr<void> data, ssize_t bytes) {
+    if (currentBatch) {
+        collect({ client, 0, 0, std::move(data), bytes });
+    } else {
+        onDataReceived(client, std::move(data), bytes);
+    }
+}
+
+void IPCServer::collect(Received entry) {
+    currentBatch->push_back(std::move(entry));
+
+    // A client writing as fast as it's read keeps the iteration going
+    if (currentBatch->size() >= UT_IPC_BATCH_MAX) {
+        dispatchBatch(*currentBatch);
+    }
+}
+
+void IPCServer::dispatchBatch(std::vector<Received>& batch) {
+    if (batch.empty()) {
+        return;
+    }
+
+    // Handed over whole, the next one starts with a vector of similar size
+    size_t capacity = batch.size();
+    auto shared = std::make_shared<const std::vector<Received>>(std::move(batch));
+    batch.clear();
+    batch.reserve(capacity);
+    onBatchReceived(std::move(shared));
+}
+
+std::unique_ptr<IPCServer::Reactor> IPCServer::createReactor() {
+    auto reactor = std::make_unique<Reactor>();
+
+    // Allocate buffer
+    reactor->buffer = malloc(UT_IPC_BUFFER_SIZE);
+    if (!reactor->buffer) {
+        throw std::runtime_error("malloc(...) failed, errno: " + std::to_string(errno));
+    }
+
+    // Initialize wakeup counter
+    reactor->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (reactor->efd == -1) {
+        throw std::runtime_error("eventfd(...) failed, errno: " + std::to_string(errno));
+    }
+
+    // Over shared memory the socket carries no payloads
+    if (mSocketType == IPCSocketType::kSeqPacket && mTransport == IPCTransport::kSocket) {
+        reactor->packets = std::make_unique<IPCPacketBatch>();
+    }
+
+    // Initialize poller, io_uring falls back to poll(...) on older kernels
+    if (mBackend == IPCPoller::Backend::kUring && IPCUring::isSupported()) {
+        reactor->ring = std::make_unique<IPCUring>(UT_IPC_URING_ENTRIES);
+    } else {
+        reactor->poller = IPCPoller::create(mBackend);
+        reactor->poller->add(reactor->efd, POLLIN);
+    }
+
+    return reactor;
+}
+
+void IPCServer::post(Reactor& reactor, Command command) {
+    if (reactor.commands.push(std::move(command))) {
+        wakeUp(reactor);
+    }
+}
+
+void IPCServer::wakeUp(Reactor& reactor) {
+    uint64_t count = 1;
+    write(reactor.efd, &count, sizeof(count));
+}
+
+void IPCServer::loop(Reactor* reactor) {
+    int ret = 0;
+    currentBatch = mBatched ? &reactor->batch : nullptr;
+
+    while (mRunning) {
+        // Only ready descriptors are returned, so the cost of a wakeup does
+        // not depend on the number of idle clients with the epoll backend
+        ret = reactor->poller->wait(reactor->events, -1);
+
+        if (ret > 0) {
+            for (auto& event : reactor->events) {
+                if (event.fd == reactor->efd) { // Software interrupt by eventfd
+                    processCommands(*reactor);
+                } else if (event.fd == mSfd) { // New connection accept
+                    acceptClients(*reactor);
+                } else if (auto it = reactor->channels.find(event.fd); it != reactor->channels.end()) {
+                    receiveShm(*reactor, it->second);
+                } else if (auto it = reactor->relays.find(event.fd); it != reactor->relays.end()) {
+                    auto connection = reactor->connections.find(it->second);
+                    if (connection != reactor->connections.end()) {
+                        relay(*reactor, *connection->second);
+                    }
+                } else { // Process clients
+                    if (event.events & POLLOUT) {
+                        auto it = reactor->connections.find(event.fd);
+                        if (it != reactor->connections.end()) {
+                            flush(*reactor, *it->second);
+                        }
+                    }
+                    if (event.events & ~POLLOUT) {
+                        receive(*reactor, event.fd);
+                    }
                 }
             }
+            dispatchBatch(reactor->batch);
         } else if (ret == 0) { // No events
             continue;
         } else if (ret == -1) { // Error occured
             if (errno == EINTR) {
                 continue;
             }
-            
+
             throw std::runtime_error("poll(...) failed, errno: " + std::to_string(errno));
         }
     }
 }
 
+void IPCServer::loopUring(Reactor* reactor) {
+    auto& ring = *reactor->ring;
+    currentBatch = mBatched ? &reactor->batch : nullptr;
+
+    ring.preparePoll(reactor->efd, POLLIN, true, tag(nullptr, kWakeUp));
+    if (reactor == mReactors[0].get()) {
+        ring.prepareAccept(mSfd, tag(nullptr, kAccept));
+        reactor->accepting = true;
+    }
+
+    while (mRunning) {
+        // Everything prepared while handling the previous batch goes out
+        // with the same call that waits for the next one
+        int ret = ring.submit(1);
+        if (ret == -1 && errno != EINTR && errno != EBUSY) {
+            throw std::runtime_error("io_uring_enter(...) failed, errno: " + std::to_string(errno));
+        }
+
+        ring.reap(reactor->completions);
+        for (auto& cqe : reactor->completions) {
+            complete(*reactor, cqe);
+        }
+        dispatchBatch(reactor->batch);
+    }
+
+    // The multishot accept keeps installing descriptors until it's cancelled,
+    // the clients nobody reaps anymore would leak
+    if (reactor->accepting) {
+        ring.prepareCancel(mSfd, tag(nullptr, kCancel));
+
+        while (reactor->accepting) {
+            int ret = ring.submit(1);
+            if (ret == -1 && errno != EINTR && errno != EBUSY) {
+                throw std::runtime_error("io_uring_enter(...) failed, errno: " + std::to_string(errno));
+            }
+
+            ring.reap(reactor->completions);
+            for (auto& cqe : reactor->completions) {
+                complete(*reactor, cqe);
+            }
+            dispatchBatch(reactor->batch);
+        }
+    }
+}
+
+void IPCServer::processCommands(Reactor& reactor) {
+    // Reset before draining, a command queued after the drain started sees
+    // an empty queue and signals again
+    uint64_t count;
+    read(reactor.efd, &count, sizeof(count));
+
+    reactor.commands.drain([this, &reactor] (Command& command) {
+        if (command.type == Command::Type::kAdd) {
+            addClient(reactor, command.fd);
+            return;
+        }
+
+        // The connection may have gone, or its descriptor been reused
+        auto it = reactor.connections.find(command.fd);
+        if (it == reactor.connections.end() || it->second != command.connection) {
+            return;
+        }
+
+        if (command.type == Command::Type::kFlush) {
+            flush(reactor, *command.connection);
+        } else if (command.type == Command::Type::kForward) {
+            command.connection->relays.push_back(std::move(command.relay));
+            watch(reactor, *command.connection);
+        } else {
+            disconnect(reactor, command.fd);
+        }
+    });
+}
+
+void IPCServer::complete(Reactor& reactor, const io_uring_cqe& cqe) {
+    auto& ring = *reactor.ring;
+    auto operation = static_cast<Operation>(cqe.user_data & kOperationMask);
+    auto* connection = reinterpret_cast<Connection*>(cqe.user_data & ~kOperationMask);
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    switch (operation) {
+    case kWakeUp:
+        if (!more && mRunning) {
+            ring.preparePoll(reactor.efd, POLLIN, true, tag(nullptr, kWakeUp));
+        }
+        processCommands(reactor);
+        return;
+    case kAccept:
+        if (!more) {
+            reactor.accepting = mRunning;
+            if (mRunning) {
+                ring.prepareAccept(mSfd, tag(nullptr, kAccept));
+            }
+        }
+        if (cqe.res >= 0) {
+            assignClient(reactor, cqe.res);
+        }
+        return;
+    case kCancel:
+        return;
+    default:
+        break;
+    }
+
+    if (!more) {
+        --connection->operations;
+    }
+
+    // Late completions of a disconnected client only give back resources
+    auto it = reactor.connections.find(connection->fd);
+    if (it == reactor.connections.end() || it->second.get() != connection) {
+        ring.recycle(cqe);
+        if (!connection->operations) {
+            reactor.retired.erase(connection);
+        }
+        return;
+    }
+
+    switch (operation) {
+    case kReceive:
+        receiveUring(reactor, *connection, cqe);
+        break;
+    case kReadable:
+        if (!more) {
+            ring.preparePoll(connection->fd, POLLIN | POLLRDHUP, true, tag(connection, kReadable));
+            ++connection->operations;
+        }
+        receive(reactor, connection->fd);
+        break;
+    case kChannel:
+        if (!more) {
+            ring.preparePoll(connection->channel->getEventFd(), POLLIN, true, tag(connection, kChannel));
+            ++connection->operations;
+        }
+        receiveShm(reactor, connection->fd);
+        break;
+    case kSend:
+        completeSend(reactor, *connection, cqe.res);
+        break;
+    case kWritable:
+        submitSend(reactor, *connection);
+        break;
+    case kRelay:
+        connection->watching = false;
+        relay(reactor, *connection);
+        break;
+    default:
+        break;
+    }
+}
+
+void IPCServer::acceptClients(Reactor& reactor) {
+    int ret = 0;
+
+    // Drain the whole backlog, the edge-triggered backend won't report the
+    // listening socket again until a new connection arrives
+    while (true) {
+        int cfd = accept(mSfd, nullptr, nullptr);
+        if (cfd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+
+        ret = fcntl(cfd, F_GETFL, nullptr);
+        if (ret == -1) {
+            close(cfd);
+            continue;
+        }
+
+        ret = fcntl(cfd, F_SETFL, ret |= O_NONBLOCK);
+        if (ret == -1) {
+            close(cfd);
+            continue;
+        }
+
+        assignClient(reactor, cfd);
+    }
+}
+
+void IPCServer::assignClient(Reactor& reactor, int fd) {
+    if (mReactors.size() == 1) {
+        addClient(reactor, fd);
+        return;
+    }
+
+    // Hand the client out to one of the workers
+    size_t index = 1;
+    if (mBalancing == Balancing::kLeastLoaded) {
+        for (size_t i = 2; i < mReactors.size(); ++i) {
+            if (mReactors[i]->load < mReactors[index]->load) {
+                index = i;
+            }
+        }
+    } else {
+        index = 1 + mNextWorker++ % (mReactors.size() - 1);
+    }
+
+    auto& worker = *mReactors[index];
+    ++worker.load;
+    post(worker, { Command::Type::kAdd, fd, nullptr, {} });
+}
+
+void IPCServer::addClient(Reactor& reactor, int fd) {
+    auto connection = std::make_shared<Connection>();
+    connection->fd = fd;
+    connection->reactor = &reactor;
+    connection->queue.setMetrics(&connection->counters, &mQueueWait);
+    connection->queue.setPackets(mSocketType == IPCSocketType::kSeqPacket);
+    connection->queue.setChunkSize(mChunkSize);
+    for (auto& [channel, priority] : mPriorities) {
+        connection->queue.setPriority(channel, priority);
+    }
+
+    // Once stop(...) cleared the registry nothing may enter it anymore
+    {
+        uint32_t index = mNextShard++ % kShards;
+        auto& shard = mShards[index];
+        std::unique_lock lock(shard.mutex);
+        if (mRunning) {
+            auto handle = shard.connections.insert(connection);
+            connection->id = toClientId(index, handle);
+            if (handle && !connection->id) {
+                shard.connections.erase(handle);
+            }
+        }
+    }
+
+    // Past UINT32_MAX / kShards clients in the shard, or stopping
+    if (!connection->id) {
+        if (&reactor != mReactors[0].get()) {
+            --reactor.load;
+        }
+        close(fd);
+        return;
+    }
+
+    try {
+        if (mTransport == IPCTransport::kSharedMemory) {
+            connection->channel = IPCShmChannel::create(fd, mRingSize);
+        }
+
+        if (reactor.ring) {
+            // Over shared memory the socket only carries descriptors and the
+            // end of the stream, so readiness is enough there
+            auto& ring = *reactor.ring;
+            if (connection->channel) {
+                ring.preparePoll(connection->channel->getEventFd(), POLLIN, true, tag(connection.get(), kChannel));
+                ring.preparePoll(fd, POLLIN | POLLRDHUP, true, tag(connection.get(), kReadable));
+                connection->operations += 2;
+            } else if (reactor.packets) {
+                // Packets are batched with recvmmsg(...) on readiness
+                ring.preparePoll(fd, POLLIN | POLLRDHUP, true, tag(connection.get(), kReadable));
+                ++connection->operations;
+            } else {
+                ring.prepareReceive(fd, tag(connection.get(), kReceive));
+                ++connection->operations;
+            }
+        } else {
+            if (connection->channel) {
+                reactor.poller->add(connection->channel->getEventFd(), POLLIN);
+            }
+
+            try {
+                reactor.poller->add(fd, POLLIN);
+            } catch (...) {
+                if (connection->channel) {
+                    reactor.poller->remove(connection->channel->getEventFd());
+                }
+                throw;
+            }
+        }
+    } catch (...) {
+        {
+            auto& shard = getShard(connection->id);
+            std::unique_lock lock(shard.mutex);
+            shard.connections.erase(toHandle(connection->id));
+        }
+        if (&reactor != mReactors[0].get()) {
+            --reactor.load;
+        }
+        close(fd);
+        return;
+    }
+
+    if (connection->channel) {
+        reactor.channels.emplace(connection->channel->getEventFd(), fd);
+    }
+    reactor.connections.emplace(fd, connection);
+    ++mAccepted;
+
+    // Keeps connection events in order with the data collected so far
+    if (currentBatch) {
+        dispatchBatch(*currentBatch);
+    }
+    onClientConnected(connection->id);
+}
+
+void IPCServer::receive(Reactor& reactor, int fd) {
+    auto it = reactor.connections.find(fd);
+    if (it == reactor.connections.end()) {
+        return;
+    }
+
+    ssize_t ret = 0;
+    bool closed = false;
+    auto& connection = *it->second;
+
+    if (connection.channel) {
+        // Payloads arrive through the rings, only passed descriptors and the
+        // end of the stream are expected on the socket
+        while (true) {
+            std::vector<int> fds;
+            ret = IPCDescriptors::receive(fd, reactor.buffer, UT_IPC_BUFFER_SIZE, fds);
+            if (!fds.empty()) {
+                connection.descriptors.push_back(std::move(fds));
+            }
+
+            if (ret == 0) {
+                closed = true;
+                break;
+            } else if (ret == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                closed = errno != EWOULDBLOCK;
+                break;
+            }
+        }
+    } else if (reactor.packets) {
+        // Every packet is a whole message or frame
+        auto callback = [this, &connection] (void* data, size_t bytes, std::vector<int>& fds) {
+            return receivePacket(connection, data, bytes, fds);
+        };
+        closed = reactor.packets->receive(fd, callback) != IPCPacketBatch::RetCode::kSuccess;
+    } else if (mFramed) {
+        while (true) {
+            // The rest of a large payload is received straight into its
+            // destination instead of going through the reactor buffer
+            size_t missing = 0;
+            void* pending = connection.decoder.getPending(missing);
+            void* target = missing >= UT_IPC_BUFFER_SIZE ? pending : reactor.buffer;
+
+            // Descriptors ride on the first byte of their frame, so they are
+            // always queued before the frame completes
+            std::vector<int> fds;
+            ret = IPCDescriptors::receive(fd, target, target == pending ? missing : UT_IPC_BUFFER_SIZE, fds);
+            if (!fds.empty()) {
+                connection.descriptors.push_back(std::move(fds));
+            }
+
+            if (ret > 0) {
+                countReceived(connection, ret);
+                if (!decode(connection, target, ret)) {
+                    closed = true;
+                    break;
+                }
+            } else if (ret == 0) { // Connection closed
+                closed = true;
+                break;
+            } else if (ret == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                closed = errno != EWOULDBLOCK;
+                break;
+            }
+        }
+    } else if (mDataHandler) {
+        // Handed out chunk by chunk straight from the reactor buffer
+        while (true) {
+            std::vector<int> fds;
+            ret = IPCDescriptors::receive(fd, reactor.buffer, UT_IPC_BUFFER_SIZE, fds);
+            if (!fds.empty()) {
+                onDescriptorsReceived(connection.id, IPCDescriptors::share(std::move(fds)));
+            }
+
+            if (ret > 0) {
+                countReceived(connection, ret);
+                countDispatched(connection);
+                mDataHandler(connection.id, reactor.buffer, ret);
+            } else if (ret == 0) { // Connection closed
+                closed = true;
+                break;
+            } else if (ret == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                closed = errno != EWOULDBLOCK;
+                break;
+            }
+        }
+    } else {
+        // Receive straight into a pooled block growing it geometrically, so
+        // large payloads are copied a constant number of times
+        auto& pool = IPCBufferPool::getInstance();
+        size_t capacity = UT_IPC_BUFFER_SIZE;
+        size_t bytes = 0;
+        void* data = pool.allocate(capacity);
+        std::vector<int> fds;
+
+        while (true) {
+            if (bytes == capacity) {
+                void* grown = pool.allocate(capacity * 2);
+                memcpy(grown, data, bytes);
+                pool.release(data, capacity);
+                data = grown;
+                capacity *= 2;
+            }
+
+            ret = IPCDescriptors::receive(fd, static_cast<char*>(data) + bytes, capacity - bytes, fds);
+
+            if (ret > 0) {
+                countReceived(connection, ret);
+                bytes += ret;
+            } else if (ret == 0) { // Connection closed
+                closed = true;
+                break;
+            } else if (ret == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                closed = errno != EWOULDBLOCK;
+                break;
+            }
+        }
+
+        if (!fds.empty()) {
+            onDescriptorsReceived(connection.id, IPCDescriptors::share(std::move(fds)));
+        }
+        if (bytes) {
+            countDispatched(connection);
+            dispatchData(connection.id, pool.share(data, capacity), bytes);
+        } else {
+            pool.release(data, capacity);
+        }
+    }
+
+    if (closed) {
+        disconnect(reactor, fd);
+    }
+}
+
+void IPCServer::receiveShm(Reactor& reactor, int fd) {
+    auto it = reactor.connections.find(fd);
+    if (it == reactor.connections.end()) {
+        return;
+    }
+
+    // Records are borrowed from the ring, so they are copied into pooled or
+    // provided buffers before being handed to the event loop
+    auto& pool = IPCBufferPool::getInstance();
+    auto& connection = *it->second;
+    bool valid = true;
+    auto dispatch = [this, &connection] (const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+        countDispatched(connection);
+        dispatchMessage(connection.id, header, std::move(data), bytes);
+    };
+
+    connection.received = std::chrono::steady_clock::now();
+    auto ret = connection.channel->read([this, &pool, &connection, &valid, &dispatch] (const IPCFrameHeader& header, const void* data, size_t bytes) {
+        if (header.flags & IPCFrameHeader::kDescriptors) {
+            dispatchDescriptors(connection);
+        }
+
+        connection.counters.add(IPCCounters::kBytesReceived, bytes);
+
+        // Streamed pieces are written as separate records
+        if (mFramed && header.channel && mStreamHandler.chunk) {
+            dispatchStream(connection, header, data, bytes);
+            return;
+        } else if (mFramed && connection.chunks.isChunk(header)) {
+            valid = connection.chunks.add(header, data, dispatch) && valid;
+            return;
+        }
+
+        if (mFramed || bytes) {
+            countDispatched(connection);
+        }
+
+        // Direct handlers borrow the record in place
+        if (mFramed && mMessageHandler && !header.channel) {
+            mMessageHandler(connection.id, header.type, data, bytes);
+            return;
+        } else if (!mFramed && mDataHandler) {
+            if (bytes) {
+                mDataHandler(connection.id, data, bytes);
+            }
+            return;
+        }
+
+        std::shared_ptr<void> buffer;
+        if (bytes) {
+            if (mFramed && mBufferProvider) {
+                buffer = mBufferProvider(connection.id, header);
+            }
+            if (!buffer) {
+                buffer = pool.acquire(bytes);
+            }
+            memcpy(buffer.get(), data, bytes);
+        }
+
+        if (mFramed) {
+            dispatchMessage(connection.id, header, std::move(buffer), bytes);
+        } else if (bytes) {
+            dispatchData(connection.id, std::move(buffer), bytes);
+        }
+    });
+
+    if (ret != IPCShmChannel::RetCode::kSuccess || !valid) {
+        disconnect(reactor, fd);
+    }
+}
+
+void IPCServer::receiveUring(Reactor& reactor, Connection& connection, const io_uring_cqe& cqe) {
+    auto& ring = *reactor.ring;
+    int fd = connection.fd;
+
+    // Zero is the end of the stream, running out of provided buffers only
+    // ends the multishot request
+    if (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS)) {
+        ring.recycle(cqe);
+        disconnect(reactor, fd);
+        return;
+    }
+
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        ring.prepareReceive(fd, tag(&connection, kReceive));
+        ++connection.operations;
+    }
+
+    std::vector<int> fds;
+    size_t bytes = 0;
+    const char* data = ring.getPayload(cqe, bytes, fds);
+    if (!data) {
+        ring.recycle(cqe);
+        if (cqe.res > 0) {
+            disconnect(reactor, fd);
+        }
+        return;
+    }
+
+    // A stream socket only completes empty at its end
+    if (!bytes && fds.empty()) {
+        ring.recycle(cqe);
+        disconnect(reactor, fd);
+        return;
+    }
+
+    countReceived(connection, bytes);
+
+    // The provided buffer goes back to the kernel right away, so unframed
+    // payloads are copied into a pooled block unless a direct handler
+    // borrows them
+    bool closed = false;
+    if (mFramed) {
+        if (!fds.empty()) {
+            connection.descriptors.push_back(std::move(fds));
+        }
+        closed = bytes && !decode(connection, data, bytes);
+    } else {
+        if (!fds.empty()) {
+            onDescriptorsReceived(connection.id, IPCDescriptors::share(std::move(fds)));
+        }
+        if (bytes) {
+            countDispatched(connection);
+        }
+        if (bytes && mDataHandler) {
+            mDataHandler(connection.id, data, bytes);
+        } else if (bytes) {
+            auto buffer = IPCBufferPool::getInstance().acquire(bytes);
+            memcpy(buffer.get(), data, bytes);
+            dispatchData(connection.id, std::move(buffer), bytes);
+        }
+    }
+    ring.recycle(cqe);
+
+    if (closed) {
+        disconnect(reactor, fd);
+    }
+}
+
+bool IPCServer::receivePacket(Connection& connection, void* data, size_t bytes, std::vector<int>& fds) {
+    countReceived(connection, bytes);
+
+    if (mFramed) {
+        if (!fds.empty()) {
+            connection.descriptors.push_back(std::move(fds));
+        }
+        return decode(connection, data, bytes);
+    }
+
+    if (!fds.empty()) {
+        onDescriptorsReceived(connection.id, IPCDescriptors::share(std::move(fds)));
+    }
+
+    // Slots are reused by the next batch, so the packet is copied into a
+    // block of its exact size unless a direct handler borrows it
+    countDispatched(connection);
+    if (mDataHandler) {
+        mDataHandler(connection.id, data, bytes);
+    } else {
+        auto buffer = IPCBufferPool::getInstance().acquire(bytes);
+        memcpy(buffer.get(), data, bytes);
+        dispatchData(connection.id, std::move(buffer), bytes);
+    }
+
+    return true;
+}
+
+bool IPCServer::decode(Connection& connection, const void* chunk, size_t size) {
+    // Every chunk goes straight into the reassembly state of the connection,
+    // so many small frames are emitted from a single receive. Chunks of
+    // channel messages are joined before being dispatched
+    bool valid = true;
+    auto dispatch = [this, &connection] (const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+        countDispatched(connection);
+        dispatchMessage(connection.id, header, std::move(data), bytes);
+    };
+
+    if (mMessageHandler) {
+        auto view = [this, &connection, &valid, &dispatch] (const IPCFrameHeader& header, const void* data, size_t bytes) {
+            if (header.flags & IPCFrameHeader::kDescriptors) {
+                dispatchDescriptors(connection);
+            }
+            if (header.channel && mStreamHandler.chunk) {
+                dispatchStream(connection, header, data, bytes);
+            } else if (connection.chunks.isChunk(header)) {
+                valid = connection.chunks.add(header, data, dispatch) && valid;
+            } else if (header.channel) {
+                std::shared_ptr<void> buffer;
+                if (bytes) {
+                    buffer = IPCBufferPool::getInstance().acquire(bytes);
+                    memcpy(buffer.get(), data, bytes);
+                }
+                dispatch(header, std::move(buffer), bytes);
+            } else {
+                countDispatched(connection);
+                mMessageHandler(connection.id, header.type, data, bytes);
+            }
+        };
+
+        return connection.decoder.decodeView(chunk, size, view) == IPCFrameDecoder::RetCode::kSuccess && valid;
+    }
+
+    auto callback = [this, &connection, &valid, &dispatch] (const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+        if (header.flags & IPCFrameHeader::kDescriptors) {
+            dispatchDescriptors(connection);
+        }
+        if (header.channel && mStreamHandler.chunk) {
+            dispatchStream(connection, header, data.get(), bytes);
+        } else if (connection.chunks.isChunk(header)) {
+            valid = connection.chunks.add(header, data.get(), dispatch) && valid;
+        } else {
+            dispatch(header, std::move(data), bytes);
+        }
+    };
+
+    IPCFrameDecoder::Provider provider;
+    if (mBufferProvider) {
+        provider = [this, &connection] (const IPCFrameHeader& header) {
+            // Chunks are copied into their message or streamed anyway
+            bool chunk = connection.chunks.isChunk(header) || (header.channel && mStreamHandler.chunk);
+            return chunk ? nullptr : mBufferProvider(connection.id, header);
+        };
+    }
+
+    return connection.decoder.decode(chunk, size, callback, provider) == IPCFrameDecoder::RetCode::kSuccess && valid;
+}
+
+void IPCServer::countReceived(Connection& connection, size_t bytes) {
+    connection.counters.add(IPCCounters::kBytesReceived, bytes);
+    connection.received = std::chrono::steady_clock::now();
+}
+
+void IPCServer::countDispatched(Connection& connection) {
+    // Latency of a message is measured from the receive completing it
+    auto latency = std::chrono::steady_clock::now() - connection.received;
+    connection.counters.add(IPCCounters::kMessagesReceived);
+    mDispatchLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+}
+
+void IPCServer::checkPacket(size_t bytes) const {
+    if (mSocketType == IPCSocketType::kSeqPacket && mTransport == IPCTransport::kSocket && bytes > UT_IPC_PACKET_MAX_SIZE) {
+        throw std::length_error("message exceeds the packet size limit");
+    }
+}
+
+void IPCServer::writeShm(Connection& connection, const IPCFrameHeader& header, const void* data, const std::vector<int>& fds, bool published) {
+    bool wait = !published || mSlowConsumerPolicy == SlowConsumerPolicy::kBlock;
+    auto ret = connection.channel->write(header, data, fds, wait);
+    if (ret == IPCShmChannel::RetCode::kTooLarge) {
+        throw std::length_error("message exceeds the shared memory ring capacity");
+    }
+
+    // Records on the ring may already be read, so kDropOldest can only drop
+    // the one that doesn't fit
+    if (ret == IPCShmChannel::RetCode::kFull) {
+        if (mSlowConsumerPolicy == SlowConsumerPolicy::kDisconnect) {
+            // Once closed the reactor may have closed the descriptor already,
+            // and another connection reused it
+            std::lock_guard lock(connection.mutex);
+            if (connection.closed) {
+                return;
+            }
+            connection.closed = true;
+            connection.queue.clear();
+            shutdown(connection.fd, SHUT_RDWR);
+        } else {
+            connection.counters.add(IPCCounters::kDroppedBytes, header.size);
+        }
+        return;
+    }
+    connection.counters.add(IPCCounters::kMessagesSent);
+    connection.counters.add(IPCCounters::kBytesSent, header.size);
+}
+
+std::shared_ptr<IPCServer::Connection> IPCServer::findConnection(IPCClientId client) {
+    auto& shard = getShard(client);
+    std::shared_lock lock(shard.mutex);
+    auto connection = shard.connections.find(toHandle(client));
+    return connection ? *connection : nullptr;
+}
+
+IPCServer::Shard& IPCServer::getShard(IPCClientId client) {
+    return mShards[static_cast<uint32_t>(client) & (kShards - 1)];
+}
+
+IPCClientId IPCServer::toClientId(uint32_t shard, IPCSlotMap<std::shared_ptr<Connection>>::Handle handle) {
+    uint32_t index = static_cast<uint32_t>(handle);
+    if (!handle || index > UINT32_MAX / kShards - 1) {
+        return 0;
+    }
+    return (handle & ~static_cast<uint64_t>(UINT32_MAX)) | (index * kShards + shard);
+}
+
+IPCSlotMap<std::shared_ptr<IPCServer::Connection>>::Handle IPCServer::toHandle(IPCClientId client) {
+    uint32_t index = static_cast<uint32_t>(client);
+    return (client & ~static_cast<uint64_t>(UINT32_MAX)) | (index / kShards);
+}
+
+void IPCServer::dispatchDescriptors(Connection& connection) {
+    // Over shared memory the group is sent before its record is published,
+    // so when the socket hasn't been drained yet it's already waiting there
+    if (connection.descriptors.empty() && connection.channel) {
+        std::vector<int> fds;
+        char marker;
+        while (IPCDescriptors::receive(connection.fd, &marker, sizeof(marker), fds) == -1 && errno == EINTR) { }
+        if (!fds.empty()) {
+            connection.descriptors.push_back(std::move(fds));
+        }
+    }
+
+    if (connection.descriptors.empty()) {
+        return;
+    }
+
+    auto fds = std::move(connection.descriptors.front());
+    connection.descriptors.pop_front();
+    onDescriptorsReceived(connection.id, IPCDescriptors::share(std::move(fds)));
+}
+
+void IPCServer::dispatchStream(Connection& connection, const IPCFrameHeader& header, const void* data, size_t bytes) {
+    bool first;
+    bool last = connection.chunks.stream(header, first);
+
+    if (first && mStreamHandler.begin) {
+        mStreamHandler.begin(connection.id, header.channel, header.type);
+    }
+    if (bytes) {
+        mStreamHandler.chunk(connection.id, header.channel, data, bytes);
+    }
+    if (last) {
+        countDispatched(connection);
+        if (mStreamHandler.end) {
+            mStreamHandler.end(connection.id, header.channel, true);
+        }
+    }
+}
+
+void IPCServer::abortStreams(Connection& connection) {
+    if (mStreamHandler.end) {
+        for (auto channel : connection.chunks.getStreams()) {
+            mStreamHandler.end(connection.id, channel, false);
+        }
+    }
+    connection.chunks.reset();
+}
+
+std::shared_ptr<int> IPCServer::duplicate(int fd, mode_t type) const {
+    if (mTransport != IPCTransport::kSocket || mSocketType != IPCSocketType::kStream) {
+        throw std::invalid_argument("zero-copy relays need the socket transport with SOCK_STREAM");
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) == -1) {
+        throw std::runtime_error("fstat(...) failed, errno: " + std::to_string(errno));
+    }
+    if ((status.st_mode & S_IFMT) != type) {
+        throw std::invalid_argument(type == S_IFREG ? "not a regular file" : "not a pipe");
+    }
+
+    int copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (copy == -1) {
+        throw std::runtime_error("fcntl(...) failed, errno: " + std::to_string(errno));
+    }
+
+    return std::shared_ptr<int>(new int(copy), [] (int* fd) {
+        close(*fd);
+        delete fd;
+    });
+}
+
+void IPCServer::relay(Reactor& reactor, Connection& connection) {
+    unwatch(reactor, connection);
+    if (connection.relays.empty()) {
+        return;
+    }
+
+    // Only this reactor reads the pipe, so what's available now is there
+    // when the queue gets to it
+    auto& relay = connection.relays.front();
+    int available = 0;
+    if (ioctl(*relay.pipe, FIONREAD, &available) == -1) {
+        available = 0;
+    }
+
+    auto it = reactor.connections.find(connection.fd);
+    std::unique_lock lock(connection.mutex);
+    if (connection.closed) {
+        return;
+    }
+
+    // Readable with nothing in it, the write end is closed
+    IPCFrameHeader header = { static_cast<uint32_t>(available), relay.type, IPCFrameHeader::kPartial, 0, relay.channel };
+    if (!available) {
+        header.flags = 0;
+    }
+    if (available || mFramed) {
+        connection.queue.pushPipe(mFramed ? &header : nullptr, relay.pipe, available);
+    }
+
+    bool ended = !available;
+    if (ended) {
+        connection.relays.pop_front();
+    }
+
+    if (available || mFramed) {
+        schedule(it->second, lock);
+    } else {
+        lock.unlock();
+    }
+
+    if (ended) {
+        watch(reactor, connection);
+    }
+}
+
+void IPCServer::watch(Reactor& reactor, Connection& connection) {
+    // Queued chunks of the pipe hold a reference to it
+    if (connection.watching || connection.relays.empty() || connection.relays.front().pipe.use_count() > 1) {
+        return;
+    }
+
+    int pipe = *connection.relays.front().pipe;
+    if (reactor.ring) {
+        reactor.ring->preparePoll(pipe, POLLIN, false, tag(&connection, kRelay));
+        ++connection.operations;
+    } else {
+        reactor.poller->add(pipe, POLLIN);
+        reactor.relays.emplace(pipe, connection.fd);
+    }
+    connection.watching = true;
+}
+
+void IPCServer::unwatch(Reactor& reactor, Connection& connection) {
+    // io_uring polls are one-shot
+    if (!connection.watching || reactor.ring) {
+        connection.watching = false;
+        return;
+    }
+
+    int pipe = *connection.relays.front().pipe;
+    reactor.poller->remove(pipe);
+    reactor.relays.erase(pipe);
+    connection.watching = false;
+}
+
+std::shared_ptr<const IPCServer::Subscribers> IPCServer::findSubscribers(const std::string& topic) {
+    std::shared_lock lock(mTopicsMutex);
+    auto it = mTopics.find(topic);
+    if (it == mTopics.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void IPCServer::unsubscribe(Connection& connection, const std::string& topic) {
+    // mTopicsMutex has to be held
+    auto it = mTopics.find(topic);
+    if (it == mTopics.end()) {
+        return;
+    }
+
+    auto subscribers = std::make_shared<Subscribers>();
+    subscribers->reserve(it->second->size());
+    for (auto& subscriber : *it->second) {
+        if (subscriber.get() != &connection) {
+            subscribers->push_back(subscriber);
+        }
+    }
+
+    if (subscribers->empty()) {
+        mTopics.erase(it);
+    } else {
+        it->second = std::move(subscribers);
+    }
+}
+
+bool IPCServer::admit(Connection& connection, std::unique_lock<std::mutex>& lock, size_t bytes) {
+    if (connection.queue.getBytes() + bytes <= mHighWatermark) {
+        return true;
+    }
+
+    switch (mSlowConsumerPolicy) {
+    case SlowConsumerPolicy::kDropOldest:
+        connection.counters.add(IPCCounters::kDroppedBytes, connection.queue.drop(connection.queue.getBytes() + bytes - mHighWatermark));
+        return true;
+    case SlowConsumerPolicy::kDisconnect:
+        // The reactor sees the end of the stream and disconnects as usual
+        connection.closed = true;
+        connection.queue.clear();
+        shutdown(connection.fd, SHUT_RDWR);
+        return false;
+    case SlowConsumerPolicy::kBlock:
+        // Timed, so stop() can't leave a publisher hanging
+        while (mRunning && !connection.closed && !connection.queue.isEmpty() && connection.queue.getBytes() + bytes > mHighWatermark) {
+            connection.drained.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        return mRunning && !connection.closed;
+    }
+
+    return true;
+}
+
+void IPCServer::enqueue(const std::shared_ptr<Connection>& connection, std::shared_ptr<void> data, size_t bytes, std::vector<int> fds, bool published) {
+    std::unique_lock lock(connection->mutex);
+    if (connection->closed || (published && !admit(*connection, lock, bytes))) {
+        IPCDescriptors::close(fds);
+        return;
+    }
+
+    if (published) {
+        connection->queue.publish(std::move(data), bytes);
+    } else {
+        connection->queue.push(std::move(data), bytes, std::move(fds));
+    }
+    schedule(connection, lock);
+}
+
+void IPCServer::schedule(const std::shared_ptr<Connection>& connection, std::unique_lock<std::mutex>& lock) {
+    bool schedule = false;
+    bool congested = false;
+
+    connection->counters.add(IPCCounters::kMessagesSent);
+
+    if (!connection->scheduled) {
+        connection->scheduled = true;
+        schedule = true;
+    }
+
+    if (!connection->congested && connection->queue.getBytes() > mHighWatermark) {
+        connection->congested = true;
+        congested = true;
+    }
+    lock.unlock();
+
+    if (congested) {
+        reportCongestion(*connection);
+    }
+
+    // One command per burst, everything queued until the reactor gets to it
+    // leaves in a single sendmsg(...)
+    if (schedule) {
+        post(*connection->reactor, { Command::Type::kFlush, connection->fd, connection, {} });
+    }
+}
+
+void IPCServer::flush(Reactor& reactor, Connection& connection) {
+    if (reactor.ring) {
+        submitSend(reactor, connection);
+        return;
+    }
+
+    IPCSendQueue::RetCode ret;
+    bool recovered = false;
+    {
+        std::unique_lock lock(connection.mutex);
+        ret = connection.queue.flush(connection.fd);
+
+        // Stays scheduled until POLLOUT drains the rest
+        if (ret != IPCSendQueue::RetCode::kPending) {
+            connection.scheduled = false;
+        }
+
+        if (connection.congested && connection.queue.getBytes() <= mLowWatermark) {
+            connection.congested = false;
+            recovered = true;
+        }
+    }
+    connection.drained.notify_all();
+
+    if (ret == IPCSendQueue::RetCode::kPending && !connection.writing) {
+        reactor.poller->modify(connection.fd, POLLIN | POLLOUT);
+        connection.writing = true;
+    } else if (ret != IPCSendQueue::RetCode::kPending && connection.writing) {
+        reactor.poller->modify(connection.fd, POLLIN);
+        connection.writing = false;
+    }
+
+    if (recovered) {
+        reportCongestion(connection);
+    }
+
+    if (ret == IPCSendQueue::RetCode::kFailed) {
+        disconnect(reactor, connection.fd);
+        return;
+    }
+
+    watch(reactor, connection);
+}
+
+void IPCServer::submitSend(Reactor& reactor, Connection& connection) {
+    // One send in flight per connection keeps the stream ordered
+    if (connection.sending) {
+        return;
+    }
+
+    IPCSendQueue::RetCode ret;
+    bool recovered = false;
+    bool gathered = false;
+    {
+        std::unique_lock lock(connection.mutex);
+
+        // sendfile(...) has no ring counterpart, file and pipe chunks at the
+        // head are spliced directly since the socket is non-blocking
+        ret = connection.queue.splice(connection.fd);
+        if (ret == IPCSendQueue::RetCode::kSuccess) {
+            gathered = connection.queue.gather(connection.message, connection.iov, connection.control);
+            if (!gathered) {
+                connection.scheduled = false;
+            }
+        }
+
+        if (connection.congested && connection.queue.getBytes() <= mLowWatermark) {
+            connection.congested = false;
+            recovered = true;
+        }
+    }
+    connection.drained.notify_all();
+
+    if (recovered) {
+        reportCongestion(connection);
+    }
+
+    if (ret == IPCSendQueue::RetCode::kFailed) {
+        disconnect(reactor, connection.fd);
+        return;
+    }
+
+    if (ret == IPCSendQueue::RetCode::kPending) {
+        reactor.ring->preparePoll(connection.fd, POLLOUT, false, tag(&connection, kWritable));
+        ++connection.operations;
+        return;
+    }
+
+    if (!gathered) {
+        watch(reactor, connection);
+        return;
+    }
+
+    reactor.ring->prepareSend(connection.fd, &connection.message, tag(&connection, kSend));
+    ++connection.operations;
+    connection.sending = true;
+}
+
+void IPCServer::completeSend(Reactor& reactor, Connection& connection, int result) {
+    bool recovered = false;
+    {
+        std::unique_lock lock(connection.mutex);
+        connection.queue.commit(result > 0 ? result : 0);
+
+        if (connection.congested && connection.queue.getBytes() <= mLowWatermark) {
+            connection.congested = false;
+            recovered = true;
+        }
+    }
+    connection.drained.notify_all();
+    connection.sending = false;
+
+    if (recovered) {
+        reportCongestion(connection);
+    }
+
+    // Full socket buffer, resumed once it drains
+    if (result == -EAGAIN) {
+        reactor.ring->preparePoll(connection.fd, POLLOUT, false, tag(&connection, kWritable));
+        ++connection.operations;
+        return;
+    }
+
+    if (result < 0) {
+        disconnect(reactor, connection.fd);
+        return;
+    }
+
+    submitSend(reactor, connection);
+}
+
+void IPCServer::reportCongestion(Connection& connection) {
+    // Publishers and the reactor change the state concurrently, raising it
+    // from one thread at a time keeps the last event current
+    std::unique_lock lock(connection.mutex);
+    if (connection.reporting) {
+        return;
+    }
+
+    connection.reporting = true;
+    while (connection.reported != connection.congested) {
+        bool congested = connection.reported = connection.congested;
+        lock.unlock();
+        onClientCongestionChanged(connection.id, congested);
+        lock.lock();
+    }
+    connection.reporting = false;
+}
+
+void IPCServer::disconnect(Reactor& reactor, int fd) {
+    auto it = reactor.connections.find(fd);
+    if (it == reactor.connections.end()) {
+        return;
+    }
+
+    // Requests on the ring are cancelled while the socket is still open,
+    // the connection outlives them since they point at it
+    if (reactor.ring) {
+        auto& ring = *reactor.ring;
+        ring.prepareCancel(fd, tag(nullptr, kCancel));
+        if (it->second->channel) {
+            ring.prepareCancel(it->second->channel->getEventFd(), tag(nullptr, kCancel));
+        }
+        if (it->second->watching) {
+            ring.prepareCancel(*it->second->relays.front().pipe, tag(nullptr, kCancel));
+        }
+        ring.submit(0);
+
+        if (it->second->operations) {
+            reactor.retired.emplace(it->second.get(), it->second);
+        }
+    }
+
+    if (it->second->channel) {
+        auto& channel = it->second->channel;
+        channel->close();
+        if (reactor.poller) {
+            reactor.poller->remove(channel->getEventFd());
+        }
+        reactor.channels.erase(channel->getEventFd());
+    }
+
+    // stop(...) already counted the clients it took out of the registry
+    {
+        auto& shard = getShard(it->second->id);
+        std::unique_lock lock(shard.mutex);
+        if (shard.connections.erase(toHandle(it->second->id))) {
+            depart(mDeparted, it->second->counters);
+            ++mDisconnected;
+        }
+    }
+
+    // Releases blocked publishers and keeps new data out of the queue
+    auto& connection = *it->second;
+    {
+        std::unique_lock lock(connection.mutex);
+        connection.closed = true;
+    }
+    connection.drained.notify_all();
+
+    {
+        std::unique_lock lock(mTopicsMutex);
+        for (auto& topic : connection.topics) {
+            unsubscribe(connection, topic);
+        }
+        connection.topics.clear();
+    }
+
+    abortStreams(connection);
+
+    unwatch(reactor, connection);
+    connection.relays.clear();
+
+    if (reactor.poller) {
+        reactor.poller->remove(fd);
+    }
+    // Erasing may drop the last reference to the connection
+    IPCClientId id = connection.id;
+    reactor.connections.erase(it);
+    if (&reactor != mReactors[0].get()) {
+        --reactor.load;
+    }
+
+    // The client's last data goes out before it's reported gone
+    if (currentBatch) {
+        dispatchBatch(*currentBatch);
+    }
+    onClientDisconnected(id);
+    close(fd);
+}
+
 } // namespace UT
\ No newline at end of file
@@ -24,10 +24,37 @@
 #define UT_IPC_SERVER_H
 
 #define UT_IPC_BACKLOG 16
+#define UT_IPC_BATCH_MAX 4096 // entries, a full batch is handed over early
+#define UT_IPC_CONNECTION_SHARDS 16 // power of two
 
+#if defined(UT_IPC_USE_URING)
+#define UT_IPC_DEFAULT_BACKEND IPCPoller::Backend::kUring
+#elif defined(UT_IPC_USE_EPOLL)
+#define UT_IPC_DEFAULT_BACKEND IPCPoller::Backend::kEpoll
+#else
+#define UT_IPC_DEFAULT_BACKEND IPCPoller::Backend::kPoll
+#endif
+
+#include "ut/ipc/address.h"
+#include "ut/ipc/chunkassembler.h"
+#include "ut/ipc/commandqueue.h"
 #include "ut/ipc/common.h"
+#include "ut/ipc/descriptors.h"
+#include "ut/ipc/framedecoder.h"
+#include "ut/ipc/metrics.h"
+#include "ut/ipc/packetbatch.h"
+#include "ut/ipc/poller.h"
+#include "ut/ipc/sendqueue.h"
+#include "ut/ipc/shmchannel.h"
+#include "ut/ipc/slotmap.h"
+#include "ut/ipc/uring.h"
 
-#include <poll.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <shared_mutex>
+#include <unordered_map>
 #include <ut/core/event.h>
 
 namespace UT {
@@ -36,6 +63,43 @@ class IPCServer {
 public:
     enum class RetCode;
 
+    // Strategy for handing accepted clients out to workers
+    enum class Balancing {
+        kRoundRobin,
+        kLeastLoaded
+    }; // enum class Balancing
+
+    // What publish(...) does with a subscriber whose send queue would grow
+    // past the high watermark, or whose shared memory ring is full. A full
+    // ring can't give back what it holds, kDropOldest drops the new record
+    enum class SlowConsumerPolicy {
+        kDropOldest,
+        kDisconnect,
+        kBlock
+    }; // enum class SlowConsumerPolicy
+
+    // Direct handlers, see setDataHandler(...)
+    using DataHandler = std::function<void(IPCClientId, const void*, size_t)>;
+    using MessageHandler = std::function<void(IPCClientId, uint32_t, const void*, size_t)>;
+    // Destination of a frame's payload, see setBufferProvider(...)
+    using BufferProvider = std::function<std::shared_ptr<void>(IPCClientId, const IPCFrameHeader&)>;
+
+    // Entry of onBatchReceived, channel and type are 0 unless framed
+    struct Received {
+        IPCClientId client;
+        uint32_t channel;
+        uint32_t type;
+        std::shared_ptr<void> data;
+        ssize_t bytes;
+    }; // struct Received
+
+    // Streaming receive, see setStreamHandler(...)
+    struct StreamHandler {
+        std::function<void(IPCClientId, uint32_t, uint32_t)> begin; // client, channel, type
+        std::function<void(IPCClientId, uint32_t, const void*, size_t)> chunk; // client, channel, data
+        std::function<void(IPCClientId, uint32_t, bool)> end; // client, channel, complete
+    }; // struct StreamHandler
+
     /**************************************************************************
      * Constructors / Destructors
      *************************************************************************/
@@ -43,43 +107,370 @@ public:
     IPCServer() = default;
     IPCServer(const IPCServer&) = delete;
     IPCServer(IPCServer&&) = delete;
-    ~IPCServer();
+    virtual ~IPCServer();
 
     /**************************************************************************
      * Methods
      *************************************************************************/
 
-    void send(int to, const void* data, size_t bytes);
+    void send(IPCClientId to, const void* data, size_t bytes);
+    // Passes "fds" along with the data, the caller keeps ownership of them
+    void sendDescriptors(IPCClientId to, const void* data, size_t bytes, const std::vector<int>& fds);
+    void sendMessage(IPCClientId to, uint32_t type, const void* data, size_t bytes);
+    void sendMessage(IPCClientId to, uint32_t type, const void* data, size_t bytes, const std::vector<int>& fds);
+    // Queues the message on logical channel "channel", 0 is the same as
+    // sendMessage(...). See setChannelPriority(...)
+    void sendChannel(IPCClientId to, uint32_t channel, uint32_t type, const void* data, size_t bytes);
+    // Streaming send of a message of any size on logical channel "channel"
+    // (not 0), see IPCClient::sendStream(...). Memory stays bounded as long
+    // as the caller holds off while the client is congested
+    void sendStream(IPCClientId to, uint32_t channel, uint32_t type, const void* data, size_t bytes, bool last);
+    // Zero-copy relays: the data goes from "fd" to the client's socket with
+    // sendfile(...) / splice(...) in turn with the rest of its send queue,
+    // never through user space. "fd" is duplicated, the caller keeps
+    // ownership. Framed, the data is a message of type "type" on logical
+    // channel "channel". Socket transport with SOCK_STREAM only
+    //
+    // "bytes" of regular file "fd" from "offset". Messages over
+    // UT_IPC_FRAME_MAX_SIZE are streamed, which takes a channel other than 0
+    void sendFile(IPCClientId to, int fd, off_t offset, size_t bytes, uint32_t type = 0, uint32_t channel = 0);
+    // Everything written to pipe "fd" until its write end is closed, relayed
+    // by the client's reactor as it comes in. Framed, it's streamed on
+    // "channel" (not 0) and ends with the pipe. Pipes forwarded to the same
+    // client are relayed one after another
+    void forward(IPCClientId to, int fd, uint32_t type = 0, uint32_t channel = 0);
+    // Asks the client's reactor to drop the connection, onClientDisconnected
+    // follows as usual
+    void disconnectClient(IPCClientId client);
+    void subscribe(IPCClientId client, const std::string& topic);
+    void unsubscribe(IPCClientId client, const std::string& topic);
+    // Encodes once and queues the same buffer to every subscriber of "topic"
+    void publish(const std::string& topic, const void* data, size_t bytes);
+    void publishMessage(const std::string& topic, uint32_t type, const void* data, size_t bytes);
+    // Listens at getSocketPath() + "name"
     RetCode start(const std::string& name);
     RetCode stop();
+    // Counters of the connected clients, totals and latency histograms since
+    // construction, safe to call from any thread
+    IPCServerMetrics getMetrics();
+    // Pointer kept along with the client until it disconnects, nullptr once
+    // it did. Safe to call from any thread
+    void* getUserData(IPCClientId client);
+    void setUserData(IPCClientId client, void* data);
+
+    /**************************************************************************
+     * Accessors / Mutators
+     *************************************************************************/
+
+    // Takes effect on the next start()
+    bool getFramed() const;
+    void setFramed(bool framed);
+
+    // Hands everything a reactor received in one wakeup to onBatchReceived
+    // at once instead of raising onDataReceived / onMessageReceived /
+    // onChannelMessageReceived per message. Direct handlers take precedence.
+    // Takes effect on the next start()
+    bool getBatched() const;
+    void setBatched(bool batched);
+
+    // Takes effect on the next start()
+    IPCPoller::Backend getBackend() const;
+    void setBackend(IPCPoller::Backend backend);
+
+    // Number of worker reactors serving clients, with 0 the accepting thread
+    // serves clients itself. Takes effect on the next start()
+    unsigned int getWorkers() const;
+    void setWorkers(unsigned int workers);
+
+    Balancing getBalancing() const;
+    void setBalancing(Balancing balancing);
+
+    // Takes effect on the next start()
+    IPCTransport getTransport() const;
+    void setTransport(IPCTransport transport);
+
+    // Prefix of endpoint names, UT_IPC_SOCKET_PATH by default. Takes effect
+    // on the next start(), has to match the clients
+    const std::string& getSocketPath() const;
+    void setSocketPath(const std::string& path);
+
+    // Takes effect on the next start(), has to match the clients
+    IPCNamespace getNamespace() const;
+    void setNamespace(IPCNamespace ns);
+
+    // Takes effect on the next start(), has to match the clients
+    IPCSocketType getSocketType() const;
+    void setSocketType(IPCSocketType type);
+
+    // Capacity of every shared memory ring, one per direction and client
+    size_t getRingSize() const;
+    void setRingSize(size_t size);
+
+    // Queued bytes per client above which it's reported as congested and
+    // below which it's reported as recovered
+    size_t getLowWatermark() const;
+    size_t getHighWatermark() const;
+    void setWatermarks(size_t low, size_t high);
+
+    SlowConsumerPolicy getSlowConsumerPolicy() const;
+    void setSlowConsumerPolicy(SlowConsumerPolicy policy);
+
+    // Framed mode only: logical channels multiplex independent streams of
+    // messages over a client's connection, see IPCClient. Priorities (higher
+    // first, 0 by default) and the chunk size apply to clients connecting
+    // afterwards
+    int getChannelPriority(uint32_t channel) const;
+    void setChannelPriority(uint32_t channel, int priority);
+    size_t getChunkSize() const;
+    void setChunkSize(size_t bytes);
+
+    // Replace onDataReceived / onMessageReceived (and dispatchMessage(...))
+    // with a call on the reactor thread, "data" borrowed from the receive
+    // buffer or ring for the duration of the call only. Saves the copy, the
+    // allocation and the thread handoff per message, but a slow handler
+    // stalls every client of its reactor and must not call stop().
+    // Descriptors and messages on logical channels still go through the
+    // events. Takes effect on the next start()
+    void setDataHandler(DataHandler handler);
+    void setMessageHandler(MessageHandler handler);
+
+    // Framed mode only: messages on logical channels are handed over on the
+    // reactor thread as they arrive instead of being joined first, see
+    // IPCClient::setStreamHandler(...). end(...) reports a message as
+    // incomplete when its client disconnects. Must not call stop(). Takes
+    // effect on the next start()
+    void setStreamHandler(StreamHandler handler);
+
+    // Framed mode only: called on the reactor thread once a frame's header
+    // arrived, the payload is received straight into the returned buffer
+    // (header.size bytes, e.g. a slot of the consumer's own store) and handed
+    // to onMessageReceived as is. nullptr falls back to a pooled block.
+    // Unused with a message handler. Takes effect on the next start()
+    void setBufferProvider(BufferProvider provider);
 
     /**************************************************************************
      * Events
      *************************************************************************/
 
-    Event<int> onClientConnected;
-    Event<int> onClientDisconnected;
-    Event<int, std::shared_ptr<void>, ssize_t> onDataReceived;
+    // Clients are identified by IPCClientId handles instead of their
+    // descriptors, which the system reuses right away. A handle practically
+    // never comes back once its client is gone, calls with it are ignored
+    Event<IPCClientId> onClientConnected;
+    Event<IPCClientId> onClientDisconnected;
+    Event<IPCClientId, std::shared_ptr<void>, ssize_t> onDataReceived;
+    Event<IPCClientId, uint32_t, std::shared_ptr<void>, ssize_t> onMessageReceived;
+    // Client, channel and type of messages sent with sendChannel(...)
+    Event<IPCClientId, uint32_t, uint32_t, std::shared_ptr<void>, ssize_t> onChannelMessageReceived;
+    Event<IPCClientId, bool> onClientCongestionChanged;
+    // Fired right before the data or message the descriptors came with
+    Event<IPCClientId, std::shared_ptr<const std::vector<int>>> onDescriptorsReceived;
+    // Received in one reactor iteration in arrival order, see setBatched(...)
+    Event<std::shared_ptr<const std::vector<Received>>> onBatchReceived;
 
 protected:
+    struct Reactor;
+
+    // Pipe passed to forward(...), its chunks in the send queue share "pipe"
+    struct Relay {
+        std::shared_ptr<int> pipe;
+        uint32_t type;
+        uint32_t channel;
+    }; // struct Relay
+
+    // Aligned so io_uring requests can tag a pointer to it with their kind
+    struct alignas(16) Connection {
+        ~Connection();
+
+        IPCClientId id = 0; // handle in mShards, the client's identity
+        int fd = 0;
+        Reactor* reactor = nullptr;
+        std::atomic<void*> userData = nullptr;
+        IPCFrameDecoder decoder;
+        IPCChunkAssembler chunks; // reactor only
+        std::shared_ptr<IPCShmChannel> channel;
+        bool writing = false; // POLLOUT requested, reactor only
+        std::deque<std::vector<int>> descriptors; // waiting for their frame, reactor only
+        std::vector<std::string> topics; // guarded by mTopicsMutex
+        IPCCounters counters;
+        std::chrono::steady_clock::time_point received; // last receive, reactor only
+        std::deque<Relay> relays; // front one in progress, reactor only
+        bool watching = false; // the front relay's pipe is polled, reactor only
+
+        // io_uring backend, reactor only
+        unsigned int operations = 0; // requests in flight
+        bool sending = false;
+        msghdr message;
+        iovec iov[UT_IPC_IOV_MAX];
+        alignas(cmsghdr) char control[IPCDescriptors::kControlSize];
+
+        std::mutex mutex; // guards everything below
+        std::condition_variable drained; // signaled whenever the queue shrinks
+        IPCSendQueue queue;
+        bool scheduled = false;
+        bool congested = false;
+        bool reported = false; // last state raised by onClientCongestionChanged
+        bool reporting = false;
+        bool closed = false;
+    }; // struct Connection
+
+    // Part of the client registry, the low bits of a client's handle index
+    // pick its shard, so looking up clients of different shards doesn't
+    // contend on one lock. Padded to keep the locks on their own lines
+    struct alignas(64) Shard {
+        std::shared_mutex mutex;
+        IPCSlotMap<std::shared_ptr<Connection>> connections;
+    }; // struct Shard
+
+    static constexpr uint32_t kShards = UT_IPC_CONNECTION_SHARDS;
+    static_assert((kShards & (kShards - 1)) == 0, "UT_IPC_CONNECTION_SHARDS must be a power of two");
+
+    // Rebuilt on every change, so publishers only hold a reference while
+    // iterating instead of a lock
+    using Subscribers = std::vector<std::shared_ptr<Connection>>;
+
+    // Work handed to a reactor by other threads
+    struct Command {
+        enum class Type {
+            kAdd,
+            kFlush,
+            kDisconnect,
+            kForward
+        }; // enum class Type
+
+        Type type;
+        int fd;
+        std::shared_ptr<Connection> connection; // all but kAdd
+        Relay relay; // kForward
+    }; // struct Command
+
+    // Thread with its own wakeup eventfd, command queue, receive buffer and
+    // descriptor set
+    struct Reactor {
+        Reactor() = default;
+        Reactor(const Reactor&) = delete;
+        Reactor(Reactor&&) = delete;
+        ~Reactor();
+
+        int efd = -1;
+        void* buffer = nullptr;
+        std::thread* thread = nullptr;
+        std::unique_ptr<IPCPoller> poller;
+        std::vector<IPCPoller::Event> events;
+        std::unique_ptr<IPCUring> ring; // replaces the poller
+        std::unique_ptr<IPCPacketBatch> packets; // SOCK_SEQPACKET sockets only
+        std::vector<io_uring_cqe> completions;
+        bool accepting = false; // the multishot accept is armed, io_uring only
+        std::unordered_map<int, std::shared_ptr<Connection>> connections;
+        // Disconnected, kept until their requests on the ring complete
+        std::unordered_map<Connection*, std::shared_ptr<Connection>> retired;
+        std::unordered_map<int, int> channels; // event fd -> client fd
+        std::unordered_map<int, int> relays; // pipe fd -> client fd, poller only
+        std::vector<Received> batch; // this iteration's, batching only
+        std::atomic<size_t> load = 0;
+        IPCCommandQueue<Command> commands;
+    }; // struct Reactor
+
     /**************************************************************************
      * Methods
      *************************************************************************/
 
-    void loop();
+    void sendFrame(IPCClientId to, IPCFrameHeader header, const void* data, const std::vector<int>& fds);
+    // Called on the reactor thread for every complete frame
+    virtual void dispatchMessage(IPCClientId client, const IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes);
+    void dispatchData(IPCClientId client, std::shared_ptr<void> data, ssize_t bytes);
+    void collect(Received entry);
+    // Raises onBatchReceived with what "batch" collected
+    void dispatchBatch(std::vector<Received>& batch);
+    std::unique_ptr<Reactor> createReactor();
+    // Queues "command" and wakes the reactor up unless a wakeup is pending
+    void post(Reactor& reactor, Command command);
+    void wakeUp(Reactor& reactor);
+    void loop(Reactor* reactor);
+    void loopUring(Reactor* reactor);
+    void processCommands(Reactor& reactor);
+    void complete(Reactor& reactor, const io_uring_cqe& cqe);
+    void acceptClients(Reactor& reactor);
+    void assignClient(Reactor& reactor, int fd);
+    void addClient(Reactor& reactor, int fd);
+    void receive(Reactor& reactor, int fd);
+    void receiveShm(Reactor& reactor, int fd);
+    void receiveUring(Reactor& reactor, Connection& connection, const io_uring_cqe& cqe);
+    bool receivePacket(Connection& connection, void* data, size_t bytes, std::vector<int>& fds);
+    bool decode(Connection& connection, const void* chunk, size_t size);
+    void countReceived(Connection& connection, size_t bytes);
+    void countDispatched(Connection& connection);
+    // Throws when a message would not fit into a single packet
+    void checkPacket(size_t bytes) const;
+    // Published records follow the slow consumer policy instead of waiting
+    // for room on the ring
+    void writeShm(Connection& connection, const IPCFrameHeader& header, const void* data, const std::vector<int>& fds = {}, bool published = false);
+    std::shared_ptr<Connection> findConnection(IPCClientId client);
+    Shard& getShard(IPCClientId client);
+    // The shard's index goes below the handle's, 0 when that doesn't fit
+    static IPCClientId toClientId(uint32_t shard, IPCSlotMap<std::shared_ptr<Connection>>::Handle handle);
+    static IPCSlotMap<std::shared_ptr<Connection>>::Handle toHandle(IPCClientId client);
+    void dispatchDescriptors(Connection& connection);
+    // Validates and duplicates a descriptor for sendFile(...) / forward(...)
+    std::shared_ptr<int> duplicate(int fd, mode_t type) const;
+    // Queues what the front relay's pipe holds, or ends the relay
+    void relay(Reactor& reactor, Connection& connection);
+    // Polls the front relay's pipe once none of its data is queued anymore
+    void watch(Reactor& reactor, Connection& connection);
+    void unwatch(Reactor& reactor, Connection& connection);
+    void dispatchStream(Connection& connection, const IPCFrameHeader& header, const void* data, size_t bytes);
+    // Ends the streamed messages in progress as incomplete
+    void abortStreams(Connection& connection);
+    std::shared_ptr<const Subscribers> findSubscribers(const std::string& topic);
+    void unsubscribe(Connection& connection, const std::string& topic);
+    bool admit(Connection& connection, std::unique_lock<std::mutex>& lock, size_t bytes);
+    void enqueue(const std::shared_ptr<Connection>& connection, std::shared_ptr<void> data, size_t bytes, std::vector<int> fds = {}, bool published = false);
+    // Hands what was just queued to the reactor, releases "lock"
+    void schedule(const std::shared_ptr<Connection>& connection, std::unique_lock<std::mutex>& lock);
+    void flush(Reactor& reactor, Connection& connection);
+    void submitSend(Reactor& reactor, Connection& connection);
+    void completeSend(Reactor& reactor, Connection& connection, int result);
+    // Raises onClientCongestionChanged until it caught up with "congested"
+    void reportCongestion(Connection& connection);
+    void disconnect(Reactor& reactor, int fd);
 
     /**************************************************************************
      * Members
      *************************************************************************/
 
-    bool mRunning = false;
-    int mPipe[2];
+    bool mFramed = false;
+    bool mBatched = false;
+    std::atomic<bool> mRunning = false;
     int mSfd = 0;
     std::mutex mMutex;
     std::string mServerName;
-    std::thread* mThread = nullptr;
-    std::vector<pollfd> mPfds;
-    void* mBuffer = nullptr;
+    std::string mSocketPath = UT_IPC_SOCKET_PATH;
+    IPCNamespace mNamespace = IPCNamespace::kFilesystem;
+    std::vector<std::unique_ptr<Reactor>> mReactors;
+    IPCPoller::Backend mBackend = UT_IPC_DEFAULT_BACKEND;
+    unsigned int mWorkers = 0;
+    size_t mNextWorker = 0;
+    Balancing mBalancing = Balancing::kRoundRobin;
+    IPCTransport mTransport = IPCTransport::kSocket;
+    IPCSocketType mSocketType = IPCSocketType::kStream;
+    size_t mRingSize = UT_IPC_SHM_RING_SIZE;
+    size_t mLowWatermark = UT_IPC_LOW_WATERMARK;
+    size_t mHighWatermark = UT_IPC_HIGH_WATERMARK;
+    Shard mShards[kShards];
+    std::atomic<uint32_t> mNextShard = 0;
+    SlowConsumerPolicy mSlowConsumerPolicy = SlowConsumerPolicy::kDropOldest;
+    std::unordered_map<uint32_t, int> mPriorities; // of logical channels
+    size_t mChunkSize = UT_IPC_CHUNK_SIZE;
+    DataHandler mDataHandler;
+    MessageHandler mMessageHandler;
+    StreamHandler mStreamHandler;
+    BufferProvider mBufferProvider;
+    std::shared_mutex mTopicsMutex;
+    std::unordered_map<std::string, std::shared_ptr<const Subscribers>> mTopics;
+    std::atomic<uint64_t> mAccepted = 0;
+    std::atomic<uint64_t> mDisconnected = 0;
+    IPCCounters mDeparted; // of clients no longer connected, under their shard's lock
+    IPCHistogram mDispatchLatency;
+    IPCHistogram mQueueWait;
 }; // class IPCServer
 
 enum class IPCServer::RetCode {
@@ -88,6 +479,58 @@ enum class IPCServer::RetCode {
     kNotStarted
 }; // IPCServer::RetCode
 
+/******************************************************************************
+ * Inline Definition: Accessors / Mutators
+ *****************************************************************************/
+
+inline bool IPCServer::getFramed() const { return mFramed; }
+inline void IPCServer::setFramed(bool framed) { mFramed = framed; }
+
+inline bool IPCServer::getBatched() const { return mBatched; }
+inline void IPCServer::setBatched(bool batched) { mBatched = batched; }
+
+inline IPCPoller::Backend IPCServer::getBackend() const { return mBackend; }
+inline void IPCServer::setBackend(IPCPoller::Backend backend) { mBackend = backend; }
+
+inline unsigned int IPCServer::getWorkers() const { return mWorkers; }
+inline void IPCServer::setWorkers(unsigned int workers) { mWorkers = workers; }
+
+inline IPCServer::Balancing IPCServer::getBalancing() const { return mBalancing; }
+inline void IPCServer::setBalancing(Balancing balancing) { mBalancing = balancing; }
+
+inline IPCTransport IPCServer::getTransport() const { return mTransport; }
+inline void IPCServer::setTransport(IPCTransport transport) { mTransport = transport; }
+
+inline const std::string& IPCServer::getSocketPath() const { return mSocketPath; }
+inline void IPCServer::setSocketPath(const std::string& path) { mSocketPath = path; }
+
+inline IPCNamespace IPCServer::getNamespace() const { return mNamespace; }
+inline void IPCServer::setNamespace(IPCNamespace ns) { mNamespace = ns; }
+
+inline IPCSocketType IPCServer::getSocketType() const { return mSocketType; }
+inline void IPCServer::setSocketType(IPCSocketType type) { mSocketType = type; }
+
+inline size_t IPCServer::getRingSize() const { return mRingSize; }
+inline void IPCServer::setRingSize(size_t size) { mRingSize = size; }
+
+inline size_t IPCServer::getLowWatermark() const { return mLowWatermark; }
+inline size_t IPCServer::getHighWatermark() const { return mHighWatermark; }
+inline void IPCServer::setWatermarks(size_t low, size_t high) { mLowWatermark = low; mHighWatermark = high; }
+
+inline IPCServer::SlowConsumerPolicy IPCServer::getSlowConsumerPolicy() const { return mSlowConsumerPolicy; }
+inline void IPCServer::setSlowConsumerPolicy(SlowConsumerPolicy policy) { mSlowConsumerPolicy = policy; }
+
+inline int IPCServer::getChannelPriority(uint32_t channel) const { auto it = mPriorities.find(channel); return it != mPriorities.end() ? it->second : 0; }
+inline void IPCServer::setChannelPriority(uint32_t channel, int priority) { mPriorities[channel] = priority; }
+inline size_t IPCServer::getChunkSize() const { return mChunkSize; }
+inline void IPCServer::setChunkSize(size_t bytes) { mChunkSize = bytes; }
+
+inline void IPCServer::setDataHandler(DataHandler handler) { mDataHandler = std::move(handler); }
+inline void IPCServer::setMessageHandler(MessageHandler handler) { mMessageHandler = std::move(handler); }
+inline void IPCServer::setStreamHandler(StreamHandler handler) { mStreamHandler = std::move(handler); }
+
+inline void IPCServer::setBufferProvider(BufferProvider provider) { mBufferProvider = std::move(provider); }
+
 } // namespace UT
 
 #endif // UT_IPC_SERVER_H
\ No newline at end of file
@@ -0,0 +1,111 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+#include "sharedblob.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace UT {
+
+/******************************************************************************
+ * Constructors / Destructors
+ *****************************************************************************/
+
+IPCSharedBlob::IPCSharedBlob(size_t bytes) : mSize(bytes) {
+    mFd = memfd_create("ut.ipc.blob", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mFd == -1) {
+        throw std::runtime_error("memfd_create(...) failed, errno: " + std::to_string(errno));
+    }
+
+    if (ftruncate(mFd, bytes) == -1) {
+        int error = errno;
+        close(mFd);
+        throw std::runtime_error("ftruncate(...) failed, errno: " + std::to_string(error));
+    }
+
+    if (!bytes) {
+        return;
+    }
+
+    mData = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (mData == MAP_FAILED) {
+        int error = errno;
+        close(mFd);
+        throw std::runtime_error("mmap(...) failed, errno: " + std::to_string(error));
+    }
+}
+
+IPCSharedBlob::~IPCSharedBlob() {
+    if (mData) {
+        munmap(mData, mSize);
+    }
+    close(mFd);
+}
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+void IPCSharedBlob::seal() {
+    // F_SEAL_WRITE is refused while a writable shared mapping exists
+    if (mData) {
+        munmap(mData, mSize);
+        mData = nullptr;
+    }
+
+    if (fcntl(mFd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) {
+        throw std::runtime_error("fcntl(..., F_ADD_SEALS, ...) failed, errno: " + std::to_string(errno));
+    }
+}
+
+std::shared_ptr<const void> IPCSharedBlob::map(int fd, size_t& bytes) {
+    // Without the seals the sender could still shrink the file under the
+    // mapping or change the contents while they are being read
+    int seals = fcntl(fd, F_GET_SEALS);
+    int required = F_SEAL_WRITE | F_SEAL_SHRINK;
+    if (seals == -1 || (seals & required) != required) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !st.st_size) {
+        return nullptr;
+    }
+    bytes = static_cast<size_t>(st.st_size);
+
+    void* data = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+
+    return std::shared_ptr<const void>(data, [bytes] (const void* data) {
+        munmap(const_cast<void*>(data), bytes);
+    });
+}
+
+} // namespace UT
\ No newline at end of file
@@ -0,0 +1,85 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+#ifndef UT_IPC_SHARED_BLOB_H
+#define UT_IPC_SHARED_BLOB_H
+
+#include <cstddef>
+#include <memory>
+
+namespace UT {
+
+// Anonymous memory file meant to be filled once and passed to peers with
+// sendDescriptors(...). Sealing it makes the contents immutable, so readers
+// can map it without copying or guarding against later modification
+class IPCSharedBlob {
+public:
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    explicit IPCSharedBlob(size_t bytes);
+    IPCSharedBlob(const IPCSharedBlob&) = delete;
+    IPCSharedBlob(IPCSharedBlob&&) = delete;
+    ~IPCSharedBlob();
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Drops the writable mapping and seals size and contents, getData()
+    // returns nullptr afterwards
+    void seal();
+
+    // Maps a received blob read-only, unmapped once the last reference is
+    // dropped. Returns nullptr when "fd" isn't a sealed memory file
+    static std::shared_ptr<const void> map(int fd, size_t& bytes);
+
+    /**************************************************************************
+     * Accessors / Mutators
+     *************************************************************************/
+
+    void* getData() const;
+    size_t getSize() const;
+    int getFd() const;
+
+protected:
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    int mFd = -1;
+    void* mData = nullptr;
+    size_t mSize = 0;
+}; // class IPCSharedBlob
+
+/******************************************************************************
+ * Inline Definition: Accessors / Mutators
+ *****************************************************************************/
+
+inline void* IPCSharedBlob::getData() const { return mData; }
+inline size_t IPCSharedBlob::getSize() const { return mSize; }
+inline int IPCSharedBlob::getFd() const { return mFd; }
+
+} // namespace UT
+
+#endif // UT_IPC_SHARED_BLOB_H
\ No newline at end of file
@@ -0,0 +1,427 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#include "shmchannel.h"
+#include "descriptors.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace UT {
+
+/******************************************************************************
+ * Shared layout
+ *****************************************************************************/
+
+// Lives in the first page of every ring, the data area follows it and is
+// mapped twice back to back so records never wrap
+struct IPCShmChannel::Control {
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint32_t> consumerParked;
+    std::atomic<uint32_t> producerParked;
+    std::atomic<uint32_t> space; // futex word bumped when space is freed
+}; // struct IPCShmChannel::Control
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock-free");
+
+namespace {
+
+constexpr uint32_t kMagic = 0x48535455; // "UTSH"
+
+struct Handshake {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t capacity;
+}; // struct Handshake
+
+size_t getPageSize() {
+    static size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+size_t align(size_t bytes) {
+    return (bytes + 7) & ~size_t(7);
+}
+
+void futexWait(std::atomic<uint32_t>* word, uint32_t value, long nanoseconds) {
+    timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = nanoseconds;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, value, &ts, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+} // namespace
+
+/******************************************************************************
+ * Constructors / Destructors
+ *****************************************************************************/
+
+IPCShmChannel::~IPCShmChannel() {
+    close();
+
+    size_t length = getPageSize() + mCapacity * 2;
+    if (mTx.mapping) {
+        munmap(mTx.mapping, length);
+    }
+    if (mRx.mapping) {
+        munmap(mRx.mapping, length);
+    }
+    if (mMemFd != -1) {
+        ::close(mMemFd);
+    }
+    if (mLocalEfd != -1) {
+        ::close(mLocalEfd);
+    }
+    if (mRemoteEfd != -1) {
+        ::close(mRemoteEfd);
+    }
+}
+
+std::unique_ptr<IPCShmChannel> IPCShmChannel::create(int sfd, size_t capacity) {
+    std::unique_ptr<IPCShmChannel> channel(new IPCShmChannel());
+    channel->mSfd = sfd;
+
+    // Round capacity up to a power of two of at least one page
+    channel->mCapacity = getPageSize();
+    while (channel->mCapacity < capacity) {
+        channel->mCapacity <<= 1;
+    }
+    size_t ringSize = getPageSize() + channel->mCapacity;
+
+    channel->mMemFd = memfd_create("ut.ipc.shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (channel->mMemFd == -1) {
+        throw std::runtime_error("memfd_create(...) failed, errno: " + std::to_string(errno));
+    }
+
+    if (ftruncate(channel->mMemFd, ringSize * 2) == -1) {
+        throw std::runtime_error("ftruncate(...) failed, errno: " + std::to_string(errno));
+    }
+
+    // Size is fixed from now on, so the peer can't be hit by SIGBUS
+    if (fcntl(channel->mMemFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) {
+        throw std::runtime_error("fcntl(..., F_ADD_SEALS, ...) failed, errno: " + std::to_string(errno));
+    }
+
+    channel->mLocalEfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (channel->mLocalEfd == -1) {
+        throw std::runtime_error("eventfd(...) failed, errno: " + std::to_string(errno));
+    }
+
+    channel->mRemoteEfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (channel->mRemoteEfd == -1) {
+        throw std::runtime_error("eventfd(...) failed, errno: " + std::to_string(errno));
+    }
+
+    // The first ring carries server to client traffic, the second one the
+    // opposite direction
+    channel->map(channel->mTx, 0);
+    channel->map(channel->mRx, ringSize);
+
+    for (Ring* ring : { &channel->mTx, &channel->mRx }) {
+        new (ring->control) Control();
+        ring->control->head = 0;
+        ring->control->tail = 0;
+        ring->control->consumerParked = 1;
+        ring->control->producerParked = 0;
+        ring->control->space = 0;
+    }
+
+    Handshake handshake;
+    handshake.magic = kMagic;
+    handshake.reserved = 0;
+    handshake.capacity = channel->mCapacity;
+
+    // The client waits on what is the remote descriptor for the server
+    int fds[3] = { channel->mMemFd, channel->mRemoteEfd, channel->mLocalEfd };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+
+    iovec iov;
+    iov.iov_base = &handshake;
+    iov.iov_len = sizeof(handshake);
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(sfd, &msg, MSG_NOSIGNAL) != sizeof(handshake)) {
+        throw std::runtime_error("sendmsg(...) failed, errno: " + std::to_string(errno));
+    }
+
+    return channel;
+}
+
+std::unique_ptr<IPCShmChannel> IPCShmChannel::accept(int sfd, int timeout) {
+    pollfd pfd;
+    pfd.fd = sfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ret = poll(&pfd, 1, timeout);
+    if (ret <= 0) {
+        return nullptr;
+    }
+
+    Handshake handshake;
+    int fds[3] = { -1, -1, -1 };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+
+    iovec iov;
+    iov.iov_base = &handshake;
+    iov.iov_len = sizeof(handshake);
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t bytes = recvmsg(sfd, &msg, MSG_CMSG_CLOEXEC);
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(fds, CMSG_DATA(cmsg), std::min(sizeof(fds), cmsg->cmsg_len - CMSG_LEN(0)));
+    }
+
+    std::unique_ptr<IPCShmChannel> channel(new IPCShmChannel());
+    channel->mSfd = sfd;
+    channel->mMemFd = fds[0];
+    channel->mLocalEfd = fds[1];
+    channel->mRemoteEfd = fds[2];
+
+    if (bytes != sizeof(handshake) || handshake.magic != kMagic || fds[0] == -1 || fds[1] == -1 || fds[2] == -1) {
+        return nullptr;
+    }
+
+    // Capacity has to be a power of two of at least one page
+    channel->mCapacity = handshake.capacity;
+    if (channel->mCapacity < getPageSize() || (channel->mCapacity & (channel->mCapacity - 1))) {
+        return nullptr;
+    }
+    size_t ringSize = getPageSize() + channel->mCapacity;
+
+    struct stat st;
+    if (fstat(channel->mMemFd, &st) == -1 || static_cast<size_t>(st.st_size) != ringSize * 2) {
+        return nullptr;
+    }
+
+    try {
+        channel->map(channel->mRx, 0);
+        channel->map(channel->mTx, ringSize);
+    } catch (const std::runtime_error&) {
+        return nullptr;
+    }
+
+    return channel;
+}
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+IPCShmChannel::RetCode IPCShmChannel::write(const IPCFrameHeader& header, const void* data, const std::vector<int>& fds, bool wait) {
+    size_t bytes = header.size;
+    size_t required = align(sizeof(IPCFrameHeader) + bytes);
+    if (required > mCapacity) {
+        return RetCode::kTooLarge;
+    }
+
+    std::unique_lock lock(mWriteMutex);
+
+    Control* control = mTx.control;
+    uint64_t head = control->head.load(std::memory_order_relaxed);
+
+    while (mCapacity - (head - control->tail.load(std::memory_order_acquire)) < required) {
+        if (mClosed) {
+            return RetCode::kClosed;
+        }
+        if (!wait) {
+            return RetCode::kFull;
+        }
+
+        // Park until the consumer frees some space, the timeout covers a
+        // peer that went away without notice
+        uint32_t space = control->space.load(std::memory_order_acquire);
+        control->producerParked.store(1, std::memory_order_seq_cst);
+        if (mCapacity - (head - control->tail.load(std::memory_order_seq_cst)) >= required) {
+            control->producerParked.store(0, std::memory_order_relaxed);
+            break;
+        }
+        futexWait(&control->space, space, 100 * 1000 * 1000);
+    }
+
+    // Sent under the write lock, so descriptor groups stay in record order
+    if (!fds.empty()) {
+        char marker = 0;
+        ssize_t ret;
+        do {
+            ret = IPCDescriptors::send(mSfd, &marker, sizeof(marker), fds);
+        } while (ret == -1 && errno == EINTR);
+
+        if (ret != sizeof(marker)) {
+            return RetCode::kClosed;
+        }
+    }
+
+    IPCFrameHeader stored = header;
+    if (!fds.empty()) {
+        stored.flags |= IPCFrameHeader::kDescriptors;
+    }
+
+    char* record = mTx.data + (head & (mCapacity - 1));
+    memcpy(record, &stored, sizeof(stored));
+    if (bytes) {
+        memcpy(record + sizeof(stored), data, bytes);
+    }
+    control->head.store(head + required, std::memory_order_release);
+
+    wakePeer(control->consumerParked);
+
+    return RetCode::kSuccess;
+}
+
+IPCShmChannel::RetCode IPCShmChannel::read(const Callback& callback) {
+    uint64_t counter = 0;
+    ::read(mLocalEfd, &counter, sizeof(counter));
+
+    Control* control = mRx.control;
+
+    while (true) {
+        uint64_t tail = control->tail.load(std::memory_order_relaxed);
+        uint64_t head = control->head.load(std::memory_order_acquire);
+
+        // The peer writes head and the records, a record reaching past head
+        // or the ring past the capacity would be read outside the mapping
+        if (head - tail > mCapacity) {
+            return RetCode::kCorrupted;
+        }
+
+        while (tail != head) {
+            const char* record = mRx.data + (tail & (mCapacity - 1));
+
+            IPCFrameHeader header;
+            memcpy(&header, record, sizeof(header));
+
+            size_t required = align(sizeof(header) + header.size);
+            if (required > head - tail) {
+                return RetCode::kCorrupted;
+            }
+
+            callback(header, record + sizeof(header), header.size);
+            tail += required;
+        }
+        control->tail.store(tail, std::memory_order_release);
+
+        // Producer blocked on a full ring
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (control->producerParked.load(std::memory_order_relaxed) && control->producerParked.exchange(0)) {
+            control->space.fetch_add(1, std::memory_order_release);
+            futexWake(&control->space);
+        }
+
+        // Park and re-check, a record published in between would be missed
+        // by the producer otherwise
+        control->consumerParked.store(1, std::memory_order_seq_cst);
+        if (control->head.load(std::memory_order_seq_cst) == tail) {
+            break;
+        }
+        control->consumerParked.store(0, std::memory_order_relaxed);
+    }
+
+    return RetCode::kSuccess;
+}
+
+void IPCShmChannel::close() {
+    mClosed = true;
+    if (mTx.control) {
+        mTx.control->space.fetch_add(1, std::memory_order_release);
+        futexWake(&mTx.control->space);
+    }
+}
+
+/******************************************************************************
+ * Methods (Protected)
+ *****************************************************************************/
+
+void IPCShmChannel::map(Ring& ring, size_t offset) {
+    size_t page = getPageSize();
+
+    // Reserve the whole range first, then place the control page with the
+    // data area and the second view of the data area right after it
+    void* base = mmap(nullptr, page + mCapacity * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("mmap(...) failed, errno: " + std::to_string(errno));
+    }
+    ring.mapping = base;
+
+    void* ret = mmap(base, page + mCapacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, mMemFd, offset);
+    if (ret == MAP_FAILED) {
+        throw std::runtime_error("mmap(...) failed, errno: " + std::to_string(errno));
+    }
+
+    ret = mmap(static_cast<char*>(base) + page + mCapacity, mCapacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, mMemFd, offset + page);
+    if (ret == MAP_FAILED) {
+        throw std::runtime_error("mmap(...) failed, errno: " + std::to_string(errno));
+    }
+
+    ring.control = static_cast<Control*>(base);
+    ring.data = static_cast<char*>(base) + page;
+}
+
+void IPCShmChannel::wakePeer(std::atomic<uint32_t>& parked) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked.load(std::memory_order_relaxed) && parked.exchange(0)) {
+        uint64_t counter = 1;
+        ::write(mRemoteEfd, &counter, sizeof(counter));
+    }
+}
+
+} // namespace UT
\ No newline at end of file
@@ -0,0 +1,141 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_SHM_CHANNEL_H
+#define UT_IPC_SHM_CHANNEL_H
+
+#define UT_IPC_SHM_RING_SIZE (4 * 1024 * 1024)
+#define UT_IPC_SHM_HANDSHAKE_TIMEOUT 1000 // ms
+
+#include "ut/ipc/common.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace UT {
+
+// Pair of single producer / single consumer rings in a sealed memfd mapped
+// by both processes. The socket carries only the handshake, wakeups go
+// through eventfds and are issued only when the peer is parked
+class IPCShmChannel {
+public:
+    enum class RetCode;
+
+    using Callback = std::function<void(const IPCFrameHeader&, const void*, size_t)>;
+
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    IPCShmChannel(const IPCShmChannel&) = delete;
+    IPCShmChannel(IPCShmChannel&&) = delete;
+    ~IPCShmChannel();
+
+    // Server side: creates the shared region and sends it over the socket
+    static std::unique_ptr<IPCShmChannel> create(int sfd, size_t capacity);
+    // Client side: waits for the handshake on the socket and maps the region
+    static std::unique_ptr<IPCShmChannel> accept(int sfd, int timeout);
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Blocks while the ring is full unless "wait" is false, which returns
+    // RetCode::kFull instead. Safe to call from several threads.
+    // Descriptors go over the socket ahead of the record, which is flagged
+    // with IPCFrameHeader::kDescriptors so the reader can pair them up
+    RetCode write(const IPCFrameHeader& header, const void* data, const std::vector<int>& fds = {}, bool wait = true);
+    // Drains every available record and parks the consumer, called by the
+    // reactor when the event descriptor becomes readable. RetCode::kCorrupted
+    // when the peer published more than the ring holds or a record reaching
+    // past the head, the channel is unusable from then on
+    RetCode read(const Callback& callback);
+    // Wakes up writers blocked on a full ring and makes them fail
+    void close();
+
+    /**************************************************************************
+     * Accessors / Mutators
+     *************************************************************************/
+
+    int getEventFd() const;
+    size_t getCapacity() const;
+
+protected:
+    struct Control;
+    struct Ring {
+        Control* control = nullptr;
+        char* data = nullptr;
+        void* mapping = nullptr;
+    }; // struct Ring
+
+    /**************************************************************************
+     * Constructors / Destructors (Protected)
+     *************************************************************************/
+
+    IPCShmChannel() = default;
+
+    /**************************************************************************
+     * Methods (Protected)
+     *************************************************************************/
+
+    void map(Ring& ring, size_t offset);
+    void wakePeer(std::atomic<uint32_t>& parked);
+
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    int mSfd = -1; // not owned
+    int mMemFd = -1;
+    int mLocalEfd = -1;
+    int mRemoteEfd = -1;
+    size_t mCapacity = 0;
+    Ring mTx;
+    Ring mRx;
+    std::mutex mWriteMutex;
+    std::atomic<bool> mClosed = false;
+}; // class IPCShmChannel
+
+enum class IPCShmChannel::RetCode {
+    kSuccess,
+    kTooLarge,
+    kFull,
+    kClosed,
+    kCorrupted
+}; // IPCShmChannel::RetCode
+
+/******************************************************************************
+ * Inline Definition: Accessors / Mutators
+ *****************************************************************************/
+
+inline int IPCShmChannel::getEventFd() const { return mLocalEfd; }
+inline size_t IPCShmChannel::getCapacity() const { return mCapacity; }
+
+} // namespace UT
+
+#endif // UT_IPC_SHM_CHANNEL_H
\ No newline at end of file
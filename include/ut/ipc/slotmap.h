@@ -0,0 +1,209 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+
+#ifndef UT_IPC_SLOT_MAP_H
+#define UT_IPC_SLOT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace UT {
+
+// Values stored contiguously and addressed by handles that carry a slot index
+// and the slot's generation. Erasing bumps the generation, so a handle that
+// outlived its value never finds the one stored in the slot afterwards.
+// Insert, erase and find are O(1), erase moves the last value into the gap.
+// Freed slots are reused oldest first and only once enough of them piled
+// up, so with 32 bit generations a handle comes back after some 4 * 10^12
+// erases at the earliest
+template <typename T>
+class IPCSlotMap {
+public:
+    // Never 0, 32 bits of index below 32 bits of generation
+    using Handle = uint64_t;
+
+    static constexpr size_t kMaxSize = UINT32_MAX;
+    static constexpr size_t kMinFree = 1024;
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    // Returns 0 with kMaxSize values stored
+    Handle insert(T value);
+    // Returns false when "handle" is stale
+    bool erase(Handle handle);
+    T* find(Handle handle);
+    const T* find(Handle handle) const;
+    size_t size() const;
+    bool empty() const;
+    void clear();
+    // Calls "handler" with the handle and value of every entry
+    template <typename Handler>
+    void forEach(Handler&& handler) const;
+
+protected:
+    struct Slot {
+        uint32_t generation = 1;
+        uint32_t position = 0; // of the value, kNone when free
+        uint32_t next = 0; // free slots only
+    }; // struct Slot
+
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    static Handle makeHandle(uint32_t generation, uint32_t index);
+    uint32_t locate(Handle handle) const;
+
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    std::vector<Slot> mSlots;
+    std::vector<T> mValues;
+    std::vector<uint32_t> mOwners; // slot of every value
+    uint32_t mFreeHead = kNone;
+    uint32_t mFreeTail = kNone;
+    size_t mFree = 0;
+}; // class IPCSlotMap
+
+/******************************************************************************
+ * Inline Definition: Methods
+ *****************************************************************************/
+
+template <typename T>
+typename IPCSlotMap<T>::Handle IPCSlotMap<T>::insert(T value) {
+    uint32_t index;
+    if (mFree > kMinFree || (mFree && mSlots.size() == kMaxSize)) {
+        index = mFreeHead;
+        mFreeHead = mSlots[index].next;
+        if (mFreeHead == kNone) {
+            mFreeTail = kNone;
+        }
+        --mFree;
+    } else if (mSlots.size() < kMaxSize) {
+        index = static_cast<uint32_t>(mSlots.size());
+        mSlots.emplace_back();
+    } else {
+        return 0;
+    }
+
+    auto& slot = mSlots[index];
+    slot.position = static_cast<uint32_t>(mValues.size());
+    mValues.push_back(std::move(value));
+    mOwners.push_back(index);
+    return makeHandle(slot.generation, index);
+}
+
+template <typename T>
+bool IPCSlotMap<T>::erase(Handle handle) {
+    uint32_t index = locate(handle);
+    if (index == kNone) {
+        return false;
+    }
+
+    auto& slot = mSlots[index];
+    uint32_t position = slot.position;
+    if (position != mValues.size() - 1) {
+        mValues[position] = std::move(mValues.back());
+        mOwners[position] = mOwners.back();
+        mSlots[mOwners[position]].position = position;
+    }
+    mValues.pop_back();
+    mOwners.pop_back();
+
+    slot.generation = slot.generation == UINT32_MAX ? 1 : slot.generation + 1;
+    slot.position = kNone;
+    slot.next = kNone;
+    if (mFreeTail != kNone) {
+        mSlots[mFreeTail].next = index;
+    } else {
+        mFreeHead = index;
+    }
+    mFreeTail = index;
+    ++mFree;
+    return true;
+}
+
+template <typename T>
+T* IPCSlotMap<T>::find(Handle handle) {
+    uint32_t index = locate(handle);
+    return index != kNone ? &mValues[mSlots[index].position] : nullptr;
+}
+
+template <typename T>
+const T* IPCSlotMap<T>::find(Handle handle) const {
+    uint32_t index = locate(handle);
+    return index != kNone ? &mValues[mSlots[index].position] : nullptr;
+}
+
+template <typename T>
+size_t IPCSlotMap<T>::size() const {
+    return mValues.size();
+}
+
+template <typename T>
+bool IPCSlotMap<T>::empty() const {
+    return mValues.empty();
+}
+
+template <typename T>
+void IPCSlotMap<T>::clear() {
+    // Generations survive, handles handed out before stay stale
+    while (!mOwners.empty()) {
+        uint32_t index = mOwners.back();
+        erase(makeHandle(mSlots[index].generation, index));
+    }
+}
+
+template <typename T>
+template <typename Handler>
+void IPCSlotMap<T>::forEach(Handler&& handler) const {
+    for (size_t i = 0; i < mValues.size(); ++i) {
+        handler(makeHandle(mSlots[mOwners[i]].generation, mOwners[i]), mValues[i]);
+    }
+}
+
+/******************************************************************************
+ * Inline Definition: Methods (Protected)
+ *****************************************************************************/
+
+template <typename T>
+typename IPCSlotMap<T>::Handle IPCSlotMap<T>::makeHandle(uint32_t generation, uint32_t index) {
+    return (static_cast<Handle>(generation) << 32) | index;
+}
+
+template <typename T>
+uint32_t IPCSlotMap<T>::locate(Handle handle) const {
+    uint32_t index = static_cast<uint32_t>(handle);
+    uint32_t generation = static_cast<uint32_t>(handle >> 32);
+    if (index >= mSlots.size() || mSlots[index].generation != generation || mSlots[index].position == kNone) {
+        return kNone;
+    }
+    return index;
+}
+
+} // namespace UT
+
+#endif // UT_IPC_SLOT_MAP_H
\ No newline at end of file
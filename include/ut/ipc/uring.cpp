@@ -0,0 +1,337 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+#include "uring.h"
+#include "descriptors.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace UT {
+
+static_assert((UT_IPC_URING_BUFFERS & (UT_IPC_URING_BUFFERS - 1)) == 0, "buffer count has to be a power of two");
+
+/******************************************************************************
+ * Constructors / Destructors
+ *****************************************************************************/
+
+IPCUring::IPCUring(unsigned int entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+
+    mFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (mFd == -1) {
+        throw std::runtime_error("io_uring_setup(...) failed, errno: " + std::to_string(errno));
+    }
+
+    // Both rings share a single mapping, IORING_FEAT_SINGLE_MMAP is checked
+    // by isSupported()
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    mRingSize = std::max(sqSize, cqSize);
+
+    mRing = mmap(nullptr, mRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mFd, IORING_OFF_SQ_RING);
+    if (mRing == MAP_FAILED) {
+        int error = errno;
+        mRing = nullptr;
+        release();
+        throw std::runtime_error("mmap(...) failed, errno: " + std::to_string(error));
+    }
+
+    char* ring = static_cast<char*>(mRing);
+    mSqHead = reinterpret_cast<unsigned int*>(ring + params.sq_off.head);
+    mSqTail = reinterpret_cast<unsigned int*>(ring + params.sq_off.tail);
+    mSqArray = reinterpret_cast<unsigned int*>(ring + params.sq_off.array);
+    mSqMask = *reinterpret_cast<unsigned int*>(ring + params.sq_off.ring_mask);
+    mSqEntries = params.sq_entries;
+    mSqLocalTail = *mSqTail;
+    mCqHead = reinterpret_cast<unsigned int*>(ring + params.cq_off.head);
+    mCqTail = reinterpret_cast<unsigned int*>(ring + params.cq_off.tail);
+    mCqes = reinterpret_cast<io_uring_cqe*>(ring + params.cq_off.cqes);
+    mCqMask = *reinterpret_cast<unsigned int*>(ring + params.cq_off.ring_mask);
+
+    mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        int error = errno;
+        release();
+        throw std::runtime_error("mmap(...) failed, errno: " + std::to_string(error));
+    }
+    mSqes = static_cast<io_uring_sqe*>(sqes);
+
+    // Receive buffers are picked by the kernel when data arrives, so idle
+    // connections don't pin any memory
+    mBufferRingSize = UT_IPC_URING_BUFFERS * sizeof(io_uring_buf);
+    void* bufferRing = mmap(nullptr, mBufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufferRing == MAP_FAILED) {
+        int error = errno;
+        release();
+        throw std::runtime_error("mmap(...) failed, errno: " + std::to_string(error));
+    }
+    mBufferRing = static_cast<io_uring_buf_ring*>(bufferRing);
+
+    mBuffers = static_cast<char*>(malloc(UT_IPC_URING_BUFFERS * UT_IPC_URING_BUFFER_SIZE));
+    if (!mBuffers) {
+        release();
+        throw std::runtime_error("malloc(...) failed, errno: " + std::to_string(errno));
+    }
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uintptr_t>(mBufferRing);
+    reg.ring_entries = UT_IPC_URING_BUFFERS;
+    reg.bgid = 0;
+
+    if (syscall(__NR_io_uring_register, mFd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+        int error = errno;
+        release();
+        throw std::runtime_error("io_uring_register(...) failed, errno: " + std::to_string(error));
+    }
+
+    for (uint16_t id = 0; id < UT_IPC_URING_BUFFERS; ++id) {
+        provide(id);
+    }
+    __atomic_store_n(&mBufferRing->tail, mBufferTail, __ATOMIC_RELEASE);
+
+    // Only room for the control message is reserved ahead of the payload
+    memset(&mReceiveHeader, 0, sizeof(mReceiveHeader));
+    mReceiveHeader.msg_controllen = IPCDescriptors::kControlSize;
+}
+
+IPCUring::~IPCUring() {
+    release();
+}
+
+bool IPCUring::isSupported() {
+    static const bool supported = [] {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        // Fails when io_uring is disabled by sysctl or filtered by seccomp
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, 4, &params));
+        if (fd == -1) {
+            return false;
+        }
+
+        bool ret = (params.features & IORING_FEAT_SINGLE_MMAP) && (params.features & IORING_FEAT_NODROP);
+
+        std::vector<char> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (ret && syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+            // IORING_OP_SEND_ZC came with multishot receive, it stands in for
+            // the latter which can't be probed
+            for (int op : { IORING_OP_ACCEPT, IORING_OP_RECVMSG, IORING_OP_SENDMSG, IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL, IORING_OP_SEND_ZC }) {
+                if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                    ret = false;
+                }
+            }
+        } else {
+            ret = false;
+        }
+
+        close(fd);
+        return ret;
+    }();
+
+    return supported;
+}
+
+/******************************************************************************
+ * Methods
+ *****************************************************************************/
+
+void IPCUring::prepareAccept(int fd, uint64_t data) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK;
+    sqe->user_data = data;
+}
+
+void IPCUring::prepareReceive(int fd, uint64_t data) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(&mReceiveHeader);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_CMSG_CLOEXEC;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = data;
+}
+
+void IPCUring::prepareSend(int fd, const msghdr* msg, uint64_t data) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = data;
+}
+
+void IPCUring::preparePoll(int fd, uint32_t events, bool multishot, uint64_t data) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = data;
+}
+
+void IPCUring::prepareCancel(int fd, uint64_t data) {
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = data;
+}
+
+int IPCUring::submit(unsigned int wait) {
+    __atomic_store_n(mSqTail, mSqLocalTail, __ATOMIC_RELEASE);
+
+    unsigned int pending = mSqLocalTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE);
+    if (!pending && !wait) {
+        return 0;
+    }
+
+    return static_cast<int>(syscall(__NR_io_uring_enter, mFd, pending, wait, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+}
+
+void IPCUring::reap(std::vector<io_uring_cqe>& cqes) {
+    cqes.clear();
+
+    unsigned int head = *mCqHead;
+    unsigned int tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        cqes.push_back(mCqes[head & mCqMask]);
+    }
+    __atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+}
+
+const char* IPCUring::getPayload(const io_uring_cqe& cqe, size_t& bytes, std::vector<int>& fds) {
+    bytes = 0;
+    if (cqe.res <= 0 || !(cqe.flags & IORING_CQE_F_BUFFER)) {
+        return nullptr;
+    }
+
+    // Header, reserved name and control areas, then the payload
+    char* buffer = mBuffers + (cqe.flags >> IORING_CQE_BUFFER_SHIFT) * UT_IPC_URING_BUFFER_SIZE;
+    auto* out = reinterpret_cast<io_uring_recvmsg_out*>(buffer);
+    size_t offset = sizeof(*out) + mReceiveHeader.msg_namelen + mReceiveHeader.msg_controllen;
+    if (static_cast<size_t>(cqe.res) < offset) {
+        return nullptr;
+    }
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = buffer + sizeof(*out) + mReceiveHeader.msg_namelen;
+    msg.msg_controllen = out->controllen;
+    IPCDescriptors::collect(msg, fds);
+
+    // Descriptors that didn't fit are gone, and the rest can't be paired
+    // with their data anymore
+    if (out->flags & MSG_CTRUNC) {
+        IPCDescriptors::close(fds);
+        fds.clear();
+        return nullptr;
+    }
+
+    bytes = std::min<size_t>(out->payloadlen, cqe.res - offset);
+    return buffer + offset;
+}
+
+void IPCUring::recycle(const io_uring_cqe& cqe) {
+    if (!(cqe.flags & IORING_CQE_F_BUFFER)) {
+        return;
+    }
+
+    provide(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+    __atomic_store_n(&mBufferRing->tail, mBufferTail, __ATOMIC_RELEASE);
+}
+
+/******************************************************************************
+ * Methods (Protected)
+ *****************************************************************************/
+
+void IPCUring::provide(uint16_t id) {
+    // Entries overlay the ring header, "bufs" itself is misplaced in C++ by
+    // the empty struct behind __DECLARE_FLEX_ARRAY(...)
+    auto* entries = reinterpret_cast<io_uring_buf*>(mBufferRing);
+    io_uring_buf& buffer = entries[mBufferTail++ & (UT_IPC_URING_BUFFERS - 1)];
+    buffer.addr = reinterpret_cast<uintptr_t>(mBuffers + id * UT_IPC_URING_BUFFER_SIZE);
+    buffer.len = UT_IPC_URING_BUFFER_SIZE;
+    buffer.bid = id;
+}
+
+void IPCUring::release() {
+    if (mFd != -1) {
+        close(mFd);
+        mFd = -1;
+    }
+    if (mSqes) {
+        munmap(mSqes, mSqesSize);
+        mSqes = nullptr;
+    }
+    if (mRing) {
+        munmap(mRing, mRingSize);
+        mRing = nullptr;
+    }
+    if (mBufferRing) {
+        munmap(mBufferRing, mBufferRingSize);
+        mBufferRing = nullptr;
+    }
+    free(mBuffers);
+    mBuffers = nullptr;
+}
+
+io_uring_sqe* IPCUring::getSqe() {
+    // Hand what is queued to the kernel first when the queue is full
+    if (mSqLocalTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE) >= mSqEntries) {
+        if (submit(0) == -1 && errno != EINTR && errno != EBUSY) {
+            throw std::runtime_error("io_uring_enter(...) failed, errno: " + std::to_string(errno));
+        }
+        if (mSqLocalTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE) >= mSqEntries) {
+            throw std::runtime_error("io_uring submission queue is full");
+        }
+    }
+
+    unsigned int index = mSqLocalTail & mSqMask;
+    io_uring_sqe* sqe = &mSqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    mSqArray[index] = index;
+    ++mSqLocalTail;
+
+    return sqe;
+}
+
+} // namespace UT
\ No newline at end of file
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * 
+ * Copyright (C) 2023 Dmitry Plastinin
+ * Contact: uncellon@yandex.ru, uncellon@gmail.com, uncellon@mail.ru
+ * 
+ * This file is part of the UT IPC library.
+ * 
+ * UT IPC is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as pubblished by the
+ * Free Software Foundation, either version 3 of the License, or (at your 
+ * option) any later version.
+ * 
+ * UT IPC is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser Public License for more
+ * details
+ * 
+ * You should have received a copy of the GNU Lesset General Public License
+ * along with UT IPC. If not, see <https://www.gnu.org/licenses/>.
+ * 
+ *****************************************************************************/
+
+#ifndef UT_IPC_URING_H
+#define UT_IPC_URING_H
+
+#define UT_IPC_URING_ENTRIES 1024
+#define UT_IPC_URING_BUFFERS 256 // provided receive buffers per ring
+#define UT_IPC_URING_BUFFER_SIZE (16 * 1024)
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <vector>
+
+namespace UT {
+
+// Minimal io_uring wrapper over the raw system calls, owned by a single
+// reactor thread. Submissions are queued and only handed to the kernel by
+// submit(...), so everything prepared while handling one batch of
+// completions costs a single io_uring_enter(...)
+class IPCUring {
+public:
+    /**************************************************************************
+     * Constructors / Destructors
+     *************************************************************************/
+
+    explicit IPCUring(unsigned int entries);
+    IPCUring(const IPCUring&) = delete;
+    IPCUring(IPCUring&&) = delete;
+    ~IPCUring();
+
+    // Whether the running kernel provides everything used here, multishot
+    // receive with provided buffers being the most recent (Linux 6.0)
+    static bool isSupported();
+
+    /**************************************************************************
+     * Methods
+     *************************************************************************/
+
+    void prepareAccept(int fd, uint64_t data);
+    // Multishot recvmsg(...) into the provided buffers, passed descriptors
+    // included
+    void prepareReceive(int fd, uint64_t data);
+    // "msg" has to stay valid until the completion
+    void prepareSend(int fd, const msghdr* msg, uint64_t data);
+    void preparePoll(int fd, uint32_t events, bool multishot, uint64_t data);
+    // Cancels every pending request on "fd"
+    void prepareCancel(int fd, uint64_t data);
+
+    // Hands queued submissions to the kernel and waits for "wait"
+    // completions, returns -1 with errno set on failure
+    int submit(unsigned int wait);
+    // Moves every available completion into "cqes"
+    void reap(std::vector<io_uring_cqe>& cqes);
+
+    // Payload of a completed receive, descriptors passed along are appended
+    // to "fds". nullptr when nothing arrived, or when the message is
+    // malformed or its descriptors were cut off. The buffer has to be handed
+    // back with recycle(...)
+    const char* getPayload(const io_uring_cqe& cqe, size_t& bytes, std::vector<int>& fds);
+    void recycle(const io_uring_cqe& cqe);
+
+protected:
+    /**************************************************************************
+     * Methods (Protected)
+     *************************************************************************/
+
+    io_uring_sqe* getSqe();
+    // Queues buffer "id" for the kernel, published by the next tail update
+    void provide(uint16_t id);
+    // Also undoes a partially completed constructor
+    void release();
+
+    /**************************************************************************
+     * Members
+     *************************************************************************/
+
+    int mFd = -1;
+    void* mRing = nullptr;
+    size_t mRingSize = 0;
+    io_uring_sqe* mSqes = nullptr;
+    size_t mSqesSize = 0;
+
+    unsigned int* mSqHead = nullptr;
+    unsigned int* mSqTail = nullptr;
+    unsigned int* mSqArray = nullptr;
+    unsigned int mSqMask = 0;
+    unsigned int mSqEntries = 0;
+    unsigned int mSqLocalTail = 0;
+
+    unsigned int* mCqHead = nullptr;
+    unsigned int* mCqTail = nullptr;
+    io_uring_cqe* mCqes = nullptr;
+    unsigned int mCqMask = 0;
+
+    io_uring_buf_ring* mBufferRing = nullptr;
+    size_t mBufferRingSize = 0;
+    char* mBuffers = nullptr;
+    uint16_t mBufferTail = 0;
+    msghdr mReceiveHeader;
+}; // class IPCUring
+
+} // namespace UT
+
+#endif // UT_IPC_URING_H
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <ut/ipc/address.h>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// Abstract names are exactly as long as the name, with no terminator, and
+// leave nothing on the filesystem, so a name is free again as soon as its
+// server stopped. Filesystem sockets go where setSocketPath(...) says and
+// are removed by stop(). Names that don't fit are refused rather than cut
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static bool exists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+static void testResolve() {
+    sockaddr_un addr;
+    size_t capacity = sizeof(addr.sun_path);
+
+    socklen_t length = UT::IPCAddress::resolve("name", UT::IPCNamespace::kAbstract, addr);
+    UT_CHECK(length == offsetof(sockaddr_un, sun_path) + 5);
+    UT_CHECK(addr.sun_family == AF_UNIX && addr.sun_path[0] == '\0' && memcmp(addr.sun_path + 1, "name", 4) == 0);
+
+    length = UT::IPCAddress::resolve("/tmp/name", UT::IPCNamespace::kFilesystem, addr);
+    UT_CHECK(length == sizeof(addr));
+    UT_CHECK(strcmp(addr.sun_path, "/tmp/name") == 0);
+
+    // The longest that fit, and one more
+    UT_CHECK(UT::IPCAddress::resolve(std::string(capacity - 1, 'a'), UT::IPCNamespace::kAbstract, addr) == sizeof(addr));
+    UT_CHECK(UT::IPCAddress::resolve(std::string(capacity - 1, 'a'), UT::IPCNamespace::kFilesystem, addr) == sizeof(addr));
+    for (auto ns : { UT::IPCNamespace::kAbstract, UT::IPCNamespace::kFilesystem }) {
+        bool thrown = false;
+        try {
+            UT::IPCAddress::resolve(std::string(capacity, 'a'), ns, addr);
+        } catch (const std::length_error&) {
+            thrown = true;
+        }
+        UT_CHECK(thrown);
+    }
+
+    UT::IPCServer server;
+    bool thrown = false;
+    try {
+        server.start(std::string(capacity, 'a'));
+    } catch (const std::length_error&) {
+        thrown = true;
+    }
+    UT_CHECK(thrown);
+}
+
+// Serves a client with the same settings, which gets its message echoed
+static bool echo(UT::IPCNamespace ns, const std::string& path, const std::string& name) {
+    std::atomic<bool> echoed = false;
+
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setNamespace(ns);
+    client.setSocketPath(path);
+    client.setMessageHandler([&echoed] (uint32_t type, const void*, size_t) {
+        echoed = type == 7;
+    });
+    client.start(name);
+    bool ready = waitFor([&] { return client.getReady(); });
+    if (ready) {
+        client.sendMessage(7, "x", 1);
+    }
+    bool ret = ready && waitFor([&] { return echoed.load(); });
+    client.stop();
+    return ret;
+}
+
+static void testAbstract() {
+    const std::string path = "ut.ipc.test.";
+    const std::string name = "address-abstract";
+
+    auto serve = [&path] (UT::IPCServer& server) {
+        server.setFramed(true);
+        server.setNamespace(UT::IPCNamespace::kAbstract);
+        server.setSocketPath(path);
+        server.setMessageHandler([&server] (UT::IPCClientId client, uint32_t type, const void* data, size_t bytes) {
+            server.sendMessage(client, type, data, bytes);
+        });
+    };
+
+    UT::IPCServer server;
+    serve(server);
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+    UT_CHECK(!exists(path + name) && !exists(UT_IPC_SOCKET_PATH + name));
+    UT_CHECK(echo(UT::IPCNamespace::kAbstract, path, name));
+
+    // Taken while the server listens
+    {
+        UT::IPCServer other;
+        serve(other);
+        bool thrown = false;
+        try {
+            other.start(name);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        UT_CHECK(thrown);
+    }
+
+    // Free again right after stop(), nothing to clean up
+    UT_CHECK(server.stop() == UT::IPCServer::RetCode::kSuccess);
+    UT::IPCServer next;
+    serve(next);
+    UT_CHECK(next.start(name) == UT::IPCServer::RetCode::kSuccess);
+    UT_CHECK(echo(UT::IPCNamespace::kAbstract, path, name));
+    next.stop();
+}
+
+static void testFilesystem() {
+    const std::string path = "/tmp/ut.ipc.test.custom.";
+    const std::string name = "address-filesystem";
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setSocketPath(path);
+    server.setMessageHandler([&server] (UT::IPCClientId client, uint32_t type, const void* data, size_t bytes) {
+        server.sendMessage(client, type, data, bytes);
+    });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+    UT_CHECK(exists(path + name));
+    UT_CHECK(echo(UT::IPCNamespace::kFilesystem, path, name));
+
+    UT_CHECK(server.stop() == UT::IPCServer::RetCode::kSuccess);
+    UT_CHECK(!exists(path + name));
+}
+
+int main() {
+    testResolve();
+    testAbstract();
+    testFilesystem();
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
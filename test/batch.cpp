@@ -0,0 +1,124 @@
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <ut/ipc/address.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// Batched dispatch keeps the order of every client's messages, and reports a
+// client connected before and disconnected after any batch holding its data.
+// The clients write blocking and close right away, so their last frames and
+// the end of the stream are mostly read in the same reactor iteration
+
+static constexpr int kClients = 8;
+static constexpr int kMessages = 2000; // per client
+static constexpr uint32_t kType = 4;
+static constexpr size_t kPayload = 64;
+
+static void produce(const std::string& path) {
+    sockaddr_un addr;
+    socklen_t length = UT::IPCAddress::resolve(path, UT::IPCNamespace::kFilesystem, addr);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), length) == 0) {
+        char frame[sizeof(UT::IPCFrameHeader) + kPayload] = {};
+        UT::IPCFrameHeader header = { kPayload, kType, 0, 0, 0 };
+        memcpy(frame, &header, sizeof(header));
+        for (int i = 0; i < kMessages; ++i) {
+            memcpy(frame + sizeof(header), &i, sizeof(i));
+            if (write(fd, frame, sizeof(frame)) != sizeof(frame)) {
+                break;
+            }
+        }
+    }
+    close(fd);
+}
+
+int main() {
+    const std::string name = "test-batch";
+
+    std::mutex mutex;
+    std::set<UT::IPCClientId> connected;
+    std::map<UT::IPCClientId, int> next; // sequence expected from each client
+    int disconnected = 0;
+    int received = 0;
+    int single = 0;
+    bool ordered = true;
+    bool connectedFirst = true;
+    bool disconnectedLast = true;
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setBatched(true);
+    server.onClientConnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId id) {
+            std::lock_guard lock(mutex);
+            connected.insert(id);
+        });
+    server.onClientDisconnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId id) {
+            std::lock_guard lock(mutex);
+            disconnectedLast &= next[id] == kMessages;
+            ++disconnected;
+        });
+    server.onMessageReceived.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId, uint32_t, std::shared_ptr<void>, ssize_t) {
+            std::lock_guard lock(mutex);
+            ++single;
+        });
+    server.onBatchReceived.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (std::shared_ptr<const std::vector<UT::IPCServer::Received>> batch) {
+            std::lock_guard lock(mutex);
+            for (const auto& entry : *batch) {
+                int sequence = -1;
+                if (entry.bytes == kPayload) {
+                    memcpy(&sequence, entry.data.get(), sizeof(sequence));
+                }
+                ordered &= entry.type == kType && sequence == next[entry.client]++;
+                connectedFirst &= connected.count(entry.client) == 1;
+                ++received;
+            }
+        });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    std::vector<std::thread> clients;
+    for (int i = 0; i < kClients; ++i) {
+        clients.emplace_back(produce, UT_IPC_SOCKET_PATH + name);
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard lock(mutex);
+            if (disconnected == kClients && received == kClients * kMessages) {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    server.stop();
+
+    std::lock_guard lock(mutex);
+    UT_CHECK(connected.size() == kClients);
+    UT_CHECK(disconnected == kClients);
+    UT_CHECK(received == kClients * kMessages);
+    UT_CHECK(single == 0);
+    UT_CHECK(ordered);
+    UT_CHECK(connectedFirst);
+    UT_CHECK(disconnectedLast);
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
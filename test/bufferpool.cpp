@@ -0,0 +1,60 @@
+#include <thread>
+#include <vector>
+#include <ut/ipc/bufferpool.h>
+#include "check.h"
+
+// Blocks cached by a thread go back to the shared lists when it exits, where
+// other threads pick them up again
+
+static constexpr size_t kBlockSize = 1024;
+static constexpr int kBlocks = 8; // fewer than a thread cache holds
+
+int main() {
+    auto& pool = UT::IPCBufferPool::getInstance();
+
+    // Exits with kBlocks blocks in its cache, one more released by a thread
+    // local dropped on the way out
+    std::thread([&pool] {
+        std::vector<void*> blocks;
+        for (int i = 0; i < kBlocks; ++i) {
+            blocks.push_back(pool.allocate(kBlockSize));
+        }
+        for (void* block : blocks) {
+            pool.release(block, kBlockSize);
+        }
+        thread_local auto held = pool.acquire(kBlockSize);
+    }).join();
+
+    auto before = pool.getStats();
+    std::thread([&pool] {
+        std::vector<void*> blocks;
+        for (int i = 0; i < kBlocks; ++i) {
+            blocks.push_back(pool.allocate(kBlockSize));
+        }
+        for (void* block : blocks) {
+            pool.release(block, kBlockSize);
+        }
+    }).join();
+    auto after = pool.getStats();
+
+    UT_CHECK(after.hits - before.hits == kBlocks);
+    UT_CHECK(after.misses == before.misses);
+
+    // Many short-lived threads cycling blocks of every class
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 16; ++t) {
+        threads.emplace_back([&pool] {
+            for (int round = 0; round < 100; ++round) {
+                std::vector<std::shared_ptr<void>> blocks;
+                for (size_t bytes = 1; bytes <= (size_t(1) << UT_IPC_POOL_MAX_SHIFT); bytes <<= 3) {
+                    blocks.push_back(pool.acquire(bytes));
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
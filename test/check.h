@@ -0,0 +1,21 @@
+#ifndef UT_IPC_TEST_CHECK_H
+#define UT_IPC_TEST_CHECK_H
+
+#include <iostream>
+
+namespace UT::Test {
+
+inline int failures = 0;
+
+} // namespace UT::Test
+
+// Reports a failed expectation and carries on, main() returns the count
+#define UT_CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #condition << " failed\n"; \
+            ++UT::Test::failures; \
+        } \
+    } while (0)
+
+#endif // UT_IPC_TEST_CHECK_H
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include <memory>
+#include <string>
+#include <vector>
+#include <ut/ipc/chunkassembler.h>
+#include "check.h"
+
+// Chunks of interleaved channels are joined back into whole messages, and a
+// message growing past the frame limit is dropped without affecting others
+
+struct Assembled {
+    UT::IPCFrameHeader header;
+    std::string payload;
+}; // struct Assembled
+
+static UT::IPCFrameHeader chunk(uint32_t channel, uint32_t type, size_t bytes, bool partial) {
+    return { static_cast<uint32_t>(bytes), type, partial ? UT::IPCFrameHeader::kPartial : 0, 0, channel };
+}
+
+int main() {
+    std::vector<Assembled> messages;
+    auto callback = [&messages] (const UT::IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+        messages.push_back({ header, std::string(static_cast<const char*>(data.get()), bytes) });
+    };
+
+    {
+        UT::IPCChunkAssembler assembler;
+        UT_CHECK(!assembler.isChunk(chunk(1, 7, 5, false)));
+        UT_CHECK(assembler.isChunk(chunk(1, 7, 5, true)));
+
+        UT_CHECK(assembler.add(chunk(1, 7, 5, true), "hello", callback));
+        UT_CHECK(assembler.add(chunk(2, 9, 3, true), "abc", callback));
+        UT_CHECK(assembler.isChunk(chunk(1, 7, 1, false)));
+        UT_CHECK(assembler.add(chunk(1, 7, 1, true), " ", callback));
+        UT_CHECK(assembler.add(chunk(2, 9, 3, false), "def", callback));
+        UT_CHECK(assembler.add(chunk(1, 7, 5, false), "world", callback));
+
+        UT_CHECK(messages.size() == 2);
+        if (messages.size() == 2) {
+            UT_CHECK(messages[0].header.channel == 2 && messages[0].header.type == 9);
+            UT_CHECK(messages[0].header.size == 6 && messages[0].payload == "abcdef");
+            UT_CHECK(!(messages[0].header.flags & UT::IPCFrameHeader::kPartial));
+            UT_CHECK(messages[1].header.channel == 1 && messages[1].header.type == 7);
+            UT_CHECK(messages[1].header.size == 11 && messages[1].payload == "hello world");
+        }
+        UT_CHECK(!assembler.isChunk(chunk(1, 7, 1, false)));
+        UT_CHECK(!assembler.isChunk(chunk(2, 9, 1, false)));
+    }
+
+    {
+        // Checked before anything is copied, "data" is never read
+        messages.clear();
+        UT::IPCChunkAssembler assembler;
+        UT_CHECK(assembler.add(chunk(1, 7, 4, true), "head", callback));
+        UT_CHECK(assembler.add(chunk(2, 9, 2, true), "ok", callback));
+        UT_CHECK(!assembler.add(chunk(1, 7, UT_IPC_FRAME_MAX_SIZE, true), nullptr, callback));
+        UT_CHECK(!assembler.isChunk(chunk(1, 7, 1, false)));
+        UT_CHECK(assembler.add(chunk(2, 9, 0, false), nullptr, callback));
+        UT_CHECK(messages.size() == 1 && messages[0].payload == "ok");
+    }
+
+    {
+        UT::IPCChunkAssembler assembler;
+        bool first;
+        UT_CHECK(!assembler.stream(chunk(3, 1, 8, true), first) && first);
+        UT_CHECK(!assembler.stream(chunk(3, 1, 8, true), first) && !first);
+        UT_CHECK(assembler.getStreams().count(3));
+        UT_CHECK(assembler.stream(chunk(3, 1, 8, false), first) && !first);
+        UT_CHECK(assembler.getStreams().empty());
+        UT_CHECK(assembler.stream(chunk(4, 1, 8, false), first) && first);
+    }
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
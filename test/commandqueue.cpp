@@ -0,0 +1,75 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <ut/ipc/commandqueue.h>
+#include "check.h"
+
+// Commands of every producer are drained in the order they were pushed, none
+// lost or duplicated while producers and the consumer race
+
+static constexpr int kProducers = 4;
+static constexpr int kCommands = 100000; // per producer
+
+int main() {
+    {
+        UT::IPCCommandQueue<int> queue;
+        UT_CHECK(queue.push(1));
+        UT_CHECK(!queue.push(2));
+        UT_CHECK(!queue.push(3));
+
+        std::vector<int> drained;
+        queue.drain([&drained] (int value) { drained.push_back(value); });
+        UT_CHECK((drained == std::vector<int> { 1, 2, 3 }));
+
+        // Empty again, the next push needs a wakeup
+        UT_CHECK(queue.push(4));
+    }
+
+    {
+        // Commands left behind are released with the queue
+        auto value = std::make_shared<int>(0);
+        {
+            UT::IPCCommandQueue<std::shared_ptr<int>> queue;
+            queue.push(value);
+            queue.push(value);
+            UT_CHECK(value.use_count() == 3);
+        }
+        UT_CHECK(value.use_count() == 1);
+    }
+
+    {
+        UT::IPCCommandQueue<std::pair<int, int>> queue;
+        std::atomic<int> running = kProducers;
+        std::vector<std::thread> producers;
+        for (int producer = 0; producer < kProducers; ++producer) {
+            producers.emplace_back([&queue, &running, producer] {
+                for (int i = 0; i < kCommands; ++i) {
+                    queue.push({ producer, i });
+                }
+                --running;
+            });
+        }
+
+        std::vector<int> next(kProducers, 0);
+        int drained = 0;
+        bool ordered = true;
+        auto handler = [&] (const std::pair<int, int>& command) {
+            ordered &= command.second == next[command.first]++;
+            ++drained;
+        };
+        while (running) {
+            queue.drain(handler);
+        }
+        queue.drain(handler);
+
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        UT_CHECK(ordered);
+        UT_CHECK(drained == kProducers * kCommands);
+    }
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ut/ipc/coroutine.h>
+#include <ut/ipc/rpcserver.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// Coroutines resume once connected, get messages in arrival order whether
+// they were waiting or the message was, and send on the channel they name.
+// A lost connection or stop() resumes them with std::runtime_error. RPC calls
+// resume with their response, a timeout or, without a connection, at once.
+// Tasks pass results and exceptions to whoever awaits them
+
+using Status = UT::IPCRpcStatus;
+
+static constexpr auto kWait = std::chrono::seconds(10);
+
+static std::string toString(const std::shared_ptr<void>& data, ssize_t bytes) {
+    return std::string(static_cast<const char*>(data.get()), bytes > 0 ? static_cast<size_t>(bytes) : 0);
+}
+
+// What the client saw, in order
+static UT::IPCTask<> converse(UT::IPCCoClient& client, const std::string& name,
+                              std::promise<std::vector<std::string>>& done, std::promise<void>& lost) {
+    std::vector<std::string> seen;
+    try {
+        co_await client.connect(name);
+        co_await client.send(7, "ping", 4);
+        for (int i = 0; i < 4; ++i) {
+            auto message = co_await client.receive();
+            seen.push_back(std::to_string(message.channel) + ":" + std::to_string(message.type) + ":" +
+                           toString(message.data, message.bytes));
+        }
+    } catch (const std::exception& e) {
+        seen.push_back(e.what());
+    }
+    done.set_value(seen);
+
+    // Waits until the server goes away
+    try {
+        co_await client.receive();
+    } catch (const std::runtime_error&) {
+        lost.set_value();
+    }
+}
+
+static void testConversation() {
+    const std::string name = "test-coroutine";
+
+    // Three on a channel, then the echo on the same one
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setMessageHandler([&server] (UT::IPCClientId id, uint32_t type, const void* data, size_t bytes) {
+        for (uint32_t i = 1; i <= 3; ++i) {
+            server.sendChannel(id, 2, i, "c", 1);
+        }
+        server.sendChannel(id, 2, type, data, bytes);
+    });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    UT::IPCCoClient client;
+    std::promise<std::vector<std::string>> done;
+    std::promise<void> lost;
+    converse(client, name, done, lost).detach();
+
+    auto future = done.get_future();
+    UT_CHECK(future.wait_for(kWait) == std::future_status::ready);
+    UT_CHECK(future.get() == std::vector<std::string>({ "2:1:c", "2:2:c", "2:3:c", "2:7:ping" }));
+
+    server.stop();
+    UT_CHECK(lost.get_future().wait_for(kWait) == std::future_status::ready);
+
+    // Refused right away while disconnected
+    bool refused = false;
+    [] (UT::IPCCoClient& client, bool& refused) -> UT::IPCTask<> {
+        try {
+            co_await client.send(1, "x", 1);
+        } catch (const std::runtime_error&) {
+            refused = true;
+        }
+    }(client, refused).detach();
+    UT_CHECK(refused);
+
+    client.stop();
+}
+
+static void testStopWhileConnecting() {
+    UT::IPCCoClient client;
+    bool stopped = false;
+    [] (UT::IPCCoClient& client, bool& stopped) -> UT::IPCTask<> {
+        try {
+            co_await client.connect("test-coroutine-nobody");
+        } catch (const std::runtime_error&) {
+            stopped = true;
+        }
+    }(client, stopped).detach();
+    UT_CHECK(!stopped);
+
+    // Resumed by stop() on this thread
+    client.stop();
+    UT_CHECK(stopped);
+}
+
+static void testRpc() {
+    const std::string name = "test-coroutine-rpc";
+
+    UT::IPCRpcServer server;
+    server.bind(1, [&server] (UT::IPCClientId client, uint32_t id, std::shared_ptr<void> data, ssize_t bytes) {
+        server.reply(client, id, data.get(), static_cast<size_t>(bytes));
+    });
+    server.bind(2, [] (UT::IPCClientId, uint32_t, std::shared_ptr<void>, ssize_t) { });
+
+    // Completes before suspending
+    UT::IPCRpcClient client;
+    Status status = Status::kSuccess;
+    [] (UT::IPCRpcClient& client, Status& status) -> UT::IPCTask<> {
+        status = (co_await UT::IPCRpcAwaiter(client, 1, "x", 1)).status;
+    }(client, status).detach();
+    UT_CHECK(status == Status::kDisconnected);
+
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+    client.start(name);
+    auto deadline = std::chrono::steady_clock::now() + kWait;
+    while (!client.getReady() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::promise<std::vector<std::string>> done;
+    [] (UT::IPCRpcClient& client, std::promise<std::vector<std::string>>& done) -> UT::IPCTask<> {
+        auto echoed = co_await UT::IPCRpcAwaiter(client, 1, "hello", 5);
+        auto silent = co_await UT::IPCRpcAwaiter(client, 2, "x", 1, 100);
+        done.set_value({ toString(echoed.data, echoed.bytes), silent.status == Status::kTimeout ? "timeout" : "?" });
+    }(client, done).detach();
+
+    auto future = done.get_future();
+    UT_CHECK(future.wait_for(kWait) == std::future_status::ready);
+    UT_CHECK(future.get() == std::vector<std::string>({ "hello", "timeout" }));
+
+    client.stop();
+    server.stop();
+}
+
+static UT::IPCTask<int> answer(bool fail) {
+    if (fail) {
+        throw std::logic_error("no answer");
+    }
+    co_return 42;
+}
+
+static void testTask() {
+    int result = 0;
+    bool thrown = false;
+    [] (int& result, bool& thrown) -> UT::IPCTask<> {
+        result = co_await answer(false) + 1;
+        try {
+            co_await answer(true);
+        } catch (const std::logic_error&) {
+            thrown = true;
+        }
+    }(result, thrown).detach();
+
+    UT_CHECK(result == 43);
+    UT_CHECK(thrown);
+}
+
+int main() {
+    testConversation();
+    testStopWhileConnecting();
+    testRpc();
+    testTask();
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <ut/ipc/client.h>
+#include <ut/ipc/descriptors.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// Descriptors passed with SCM_RIGHTS arrive close-on-exec and refer to the
+// sender's files, both directions between client and server over every
+// backend and transport. A control message carrying more descriptors than
+// fit fails the receive without leaking the ones that did
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static int countDescriptors() {
+    int count = 0;
+    DIR* dir = opendir("/proc/self/fd");
+    while (readdir(dir)) {
+        ++count;
+    }
+    closedir(dir);
+    return count;
+}
+
+static bool sameFile(int a, int b) {
+    struct stat first;
+    struct stat second;
+    return fstat(a, &first) == 0 && fstat(b, &second) == 0 && first.st_dev == second.st_dev && first.st_ino == second.st_ino;
+}
+
+static void testRoundTrip() {
+    int fds[2];
+    int pipe[2];
+    UT_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    UT_CHECK(pipe2(pipe, O_CLOEXEC) == 0);
+
+    UT_CHECK(UT::IPCDescriptors::send(fds[0], "x", 1, { pipe[0], pipe[1] }) == 1);
+
+    char byte = 0;
+    std::vector<int> received;
+    UT_CHECK(UT::IPCDescriptors::receive(fds[1], &byte, 1, received) == 1);
+    UT_CHECK(byte == 'x');
+    UT_CHECK(received.size() == 2);
+    if (received.size() == 2) {
+        UT_CHECK(received[0] != pipe[0] && received[1] != pipe[1]);
+        UT_CHECK(sameFile(received[0], pipe[0]) && sameFile(received[1], pipe[1]));
+        UT_CHECK(fcntl(received[0], F_GETFD) & FD_CLOEXEC);
+        UT_CHECK(fcntl(received[1], F_GETFD) & FD_CLOEXEC);
+
+        char data[4] = {};
+        UT_CHECK(write(received[1], "ping", 4) == 4);
+        UT_CHECK(read(pipe[0], data, 4) == 4 && memcmp(data, "ping", 4) == 0);
+    }
+    UT::IPCDescriptors::close(received);
+
+    // Too many to send
+    std::vector<int> many(UT_IPC_MAX_DESCRIPTORS + 1, pipe[0]);
+    UT_CHECK(UT::IPCDescriptors::send(fds[0], "x", 1, many) == -1 && errno == EINVAL);
+
+    close(pipe[0]);
+    close(pipe[1]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void testTruncated() {
+    int fds[2];
+    UT_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    int before = countDescriptors();
+
+    // Sent around IPCDescriptors::send(...), which refuses that many
+    constexpr size_t kCount = UT_IPC_MAX_DESCRIPTORS + 8;
+    std::vector<int> many(kCount, fds[0]);
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kCount)] = {};
+    char byte = 'x';
+    iovec iov = { &byte, 1 };
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * kCount);
+    memcpy(CMSG_DATA(cmsg), many.data(), sizeof(int) * kCount);
+    UT_CHECK(sendmsg(fds[0], &msg, 0) == 1);
+
+    std::vector<int> received = { -1 };
+    errno = 0;
+    UT_CHECK(UT::IPCDescriptors::receive(fds[1], &byte, 1, received) == -1);
+    UT_CHECK(errno == EMSGSIZE);
+    UT_CHECK(received.size() == 1 && received[0] == -1);
+    UT_CHECK(countDescriptors() == before);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void testEndToEnd(UT::IPCTransport transport, UT::IPCPoller::Backend backend, const std::string& name) {
+    std::mutex mutex;
+    std::vector<std::string> serverGot; // read through the passed descriptors
+    std::vector<std::string> clientGot;
+    std::atomic<UT::IPCClientId> id = 0;
+
+    auto readAll = [] (int fd) {
+        char data[64] = {};
+        ssize_t ret = pread(fd, data, sizeof(data), 0);
+        return std::string(data, ret > 0 ? static_cast<size_t>(ret) : 0);
+    };
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setTransport(transport);
+    server.setBackend(backend);
+    server.onClientConnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId client) {
+            id = client;
+        });
+    server.onDescriptorsReceived.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId, std::shared_ptr<const std::vector<int>> fds) {
+            std::lock_guard lock(mutex);
+            for (int fd : *fds) {
+                serverGot.push_back(readAll(fd));
+            }
+        });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setTransport(transport);
+    client.onDescriptorsReceived.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (std::shared_ptr<const std::vector<int>> fds) {
+            std::lock_guard lock(mutex);
+            for (int fd : *fds) {
+                clientGot.push_back(readAll(fd));
+            }
+        });
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady() && id; }));
+
+    auto file = [] (const char* content) {
+        int fd = memfd_create("ut.ipc.test", MFD_CLOEXEC);
+        write(fd, content, strlen(content));
+        return fd;
+    };
+    int first = file("first");
+    int second = file("second");
+    int third = file("third");
+
+    // The sender keeps its descriptors, they may be closed right away
+    client.sendMessage(1, "a", 1, { first, second });
+    server.sendMessage(id, 2, "b", 1, { third });
+    close(first);
+    close(second);
+    close(third);
+
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return serverGot.size() == 2 && clientGot.size() == 1;
+    }));
+    {
+        std::lock_guard lock(mutex);
+        UT_CHECK(serverGot == std::vector<std::string>({ "first", "second" }));
+        UT_CHECK(clientGot == std::vector<std::string>({ "third" }));
+    }
+
+    client.stop();
+    server.stop();
+}
+
+int main() {
+    testRoundTrip();
+    testTruncated();
+
+    testEndToEnd(UT::IPCTransport::kSocket, UT::IPCPoller::Backend::kPoll, "test-descriptors-poll");
+    testEndToEnd(UT::IPCTransport::kSocket, UT::IPCPoller::Backend::kUring, "test-descriptors-uring");
+    testEndToEnd(UT::IPCTransport::kSharedMemory, UT::IPCPoller::Backend::kPoll, "test-descriptors-shm");
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
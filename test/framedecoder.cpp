@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ut/ipc/framedecoder.h>
+#include "check.h"
+
+// The decoder hands out exactly one message per frame however the stream is
+// cut: headers split across reads, many frames in one read, empty payloads.
+// Oversized frames are rejected before anything is allocated for them, and
+// reassembling a large one doesn't pin its memory afterwards
+
+struct Decoded {
+    uint32_t type;
+    std::string payload;
+}; // struct Decoded
+
+static void append(std::string& stream, uint32_t type, const std::string& payload) {
+    UT::IPCFrameHeader header = { static_cast<uint32_t>(payload.size()), type, 0, 0, 0 };
+    stream.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.append(payload);
+}
+
+static std::string frames() {
+    std::string stream;
+    append(stream, 1, "first");
+    append(stream, 2, "");
+    append(stream, 3, std::string(10000, 'x'));
+    append(stream, 4, "last");
+    return stream;
+}
+
+static bool expected(const std::vector<Decoded>& decoded) {
+    return decoded.size() == 4
+        && decoded[0].type == 1 && decoded[0].payload == "first"
+        && decoded[1].type == 2 && decoded[1].payload.empty()
+        && decoded[2].type == 3 && decoded[2].payload == std::string(10000, 'x')
+        && decoded[3].type == 4 && decoded[3].payload == "last";
+}
+
+int main() {
+    const std::string stream = frames();
+
+    // Every read size from one byte up to the whole stream at once
+    for (size_t step : { size_t(1), size_t(3), sizeof(UT::IPCFrameHeader) - 1, size_t(4096), stream.size() }) {
+        UT::IPCFrameDecoder decoder;
+        std::vector<Decoded> decoded;
+        auto callback = [&decoded] (const UT::IPCFrameHeader& header, std::shared_ptr<void> data, ssize_t bytes) {
+            decoded.push_back({ header.type, std::string(static_cast<const char*>(data.get()), bytes) });
+        };
+        bool success = true;
+        for (size_t offset = 0; offset < stream.size(); offset += step) {
+            size_t bytes = std::min(step, stream.size() - offset);
+            success &= decoder.decode(stream.data() + offset, bytes, callback) == UT::IPCFrameDecoder::RetCode::kSuccess;
+        }
+        UT_CHECK(success);
+        UT_CHECK(expected(decoded));
+
+        UT::IPCFrameDecoder viewer;
+        std::vector<Decoded> viewed;
+        auto view = [&viewed] (const UT::IPCFrameHeader& header, const void* data, size_t bytes) {
+            viewed.push_back({ header.type, std::string(static_cast<const char*>(data), bytes) });
+        };
+        success = true;
+        for (size_t offset = 0; offset < stream.size(); offset += step) {
+            size_t bytes = std::min(step, stream.size() - offset);
+            success &= viewer.decodeView(stream.data() + offset, bytes, view) == UT::IPCFrameDecoder::RetCode::kSuccess;
+        }
+        UT_CHECK(success);
+        UT_CHECK(expected(viewed));
+    }
+
+    {
+        // The rest of a payload can be received in place
+        UT::IPCFrameDecoder decoder;
+        std::string message;
+        auto callback = [&message] (const UT::IPCFrameHeader&, std::shared_ptr<void> data, ssize_t bytes) {
+            message.assign(static_cast<const char*>(data.get()), bytes);
+        };
+        std::string stream;
+        append(stream, 1, "received in place");
+        size_t split = sizeof(UT::IPCFrameHeader) + 4;
+        decoder.decode(stream.data(), split, callback);
+
+        size_t missing;
+        void* pending = decoder.getPending(missing);
+        UT_CHECK(pending && missing == stream.size() - split);
+        if (pending && missing == stream.size() - split) {
+            memcpy(pending, stream.data() + split, missing);
+            decoder.decode(pending, missing, callback);
+        }
+        UT_CHECK(message == "received in place");
+        UT_CHECK(!decoder.getPending(missing) && missing == 0);
+    }
+
+    {
+        UT::IPCFrameHeader header = { UT_IPC_FRAME_MAX_SIZE + 1, 1, 0, 0, 0 };
+        int calls = 0;
+        UT::IPCFrameDecoder decoder;
+        UT_CHECK(decoder.decode(&header, sizeof(header), [&calls] (const UT::IPCFrameHeader&, std::shared_ptr<void>, ssize_t) { ++calls; }) == UT::IPCFrameDecoder::RetCode::kFrameTooLarge);
+        UT::IPCFrameDecoder viewer;
+        UT_CHECK(viewer.decodeView(&header, sizeof(header), [&calls] (const UT::IPCFrameHeader&, const void*, size_t) { ++calls; }) == UT::IPCFrameDecoder::RetCode::kFrameTooLarge);
+        UT_CHECK(calls == 0);
+
+        // Split header, the limit applies once it's complete
+        UT::IPCFrameDecoder split;
+        auto ignore = [] (const UT::IPCFrameHeader&, const void*, size_t) { };
+        UT_CHECK(split.decodeView(&header, 4, ignore) == UT::IPCFrameDecoder::RetCode::kSuccess);
+        UT_CHECK(split.decodeView(reinterpret_cast<const char*>(&header) + 4, sizeof(header) - 4, ignore) == UT::IPCFrameDecoder::RetCode::kFrameTooLarge);
+    }
+
+    {
+        // The reassembly buffer is kept for small frames, a large one doesn't
+        // leave its memory behind
+        UT::IPCFrameDecoder viewer;
+        std::vector<std::string> viewed;
+        auto view = [&viewed] (const UT::IPCFrameHeader&, const void* data, size_t bytes) {
+            viewed.emplace_back(static_cast<const char*>(data), bytes);
+        };
+        auto split = [&viewer, &view] (const std::string& stream) {
+            size_t half = stream.size() / 2;
+            return viewer.decodeView(stream.data(), half, view) == UT::IPCFrameDecoder::RetCode::kSuccess
+                && viewer.decodeView(stream.data() + half, stream.size() - half, view) == UT::IPCFrameDecoder::RetCode::kSuccess;
+        };
+
+        std::string small;
+        append(small, 1, std::string(1000, 's'));
+        UT_CHECK(split(small));
+        size_t retained = viewer.getRetained();
+        UT_CHECK(retained >= 1000 && retained <= UT_IPC_ASSEMBLY_RETAINED);
+
+        std::string large;
+        append(large, 2, std::string(4 * UT_IPC_ASSEMBLY_RETAINED, 'l'));
+        UT_CHECK(split(large));
+        UT_CHECK(viewer.getRetained() == 0);
+
+        UT_CHECK(split(small));
+        UT_CHECK(viewer.getRetained() >= 1000 && viewer.getRetained() <= UT_IPC_ASSEMBLY_RETAINED);
+        UT_CHECK(viewed.size() == 3);
+        if (viewed.size() == 3) {
+            UT_CHECK(viewed[0] == std::string(1000, 's'));
+            UT_CHECK(viewed[1] == std::string(4 * UT_IPC_ASSEMBLY_RETAINED, 'l'));
+            UT_CHECK(viewed[2] == viewed[0]);
+        }
+    }
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <ut/ipc/metrics.h>
+#include "check.h"
+
+// Percentiles are bucket upper bounds, exact below kSubBuckets and within the
+// bucket width (1 / kSubBuckets of the value) above
+
+static bool near(uint64_t bound, uint64_t value) {
+    return bound >= value && bound - value <= value / UT::IPCHistogram::kSubBuckets;
+}
+
+int main() {
+    using UT::IPCHistogram;
+
+    {
+        IPCHistogram::Snapshot empty;
+        UT_CHECK(empty.getPercentile(50) == 0);
+        UT_CHECK(empty.getMax() == 0);
+        UT_CHECK(empty.getMean() == 0);
+    }
+
+    {
+        // Every value lands in a bucket whose upper bound covers it
+        bool covered = true;
+        size_t previous = 0;
+        for (uint64_t value = 1; value && value < UINT64_MAX / 3; value = value * 3 / 2 + 1) {
+            size_t bucket = IPCHistogram::getBucket(value);
+            covered &= bucket < IPCHistogram::kBuckets && bucket >= previous;
+            covered &= value <= IPCHistogram::getUpperBound(bucket);
+            covered &= bucket == 0 || value > IPCHistogram::getUpperBound(bucket - 1);
+            previous = bucket;
+        }
+        UT_CHECK(covered);
+        UT_CHECK(IPCHistogram::getBucket(UINT64_MAX) == IPCHistogram::kBuckets - 1);
+        UT_CHECK(IPCHistogram::getUpperBound(IPCHistogram::kBuckets - 1) == UINT64_MAX);
+    }
+
+    {
+        IPCHistogram histogram;
+        for (uint64_t value = 1; value <= 1000; ++value) {
+            histogram.record(value);
+        }
+
+        auto snapshot = histogram.getSnapshot();
+        UT_CHECK(snapshot.count == 1000);
+        UT_CHECK(snapshot.sum == 500500);
+        UT_CHECK(snapshot.getMean() == 500.5);
+        UT_CHECK(snapshot.getPercentile(0.1) == 1);
+        UT_CHECK(near(snapshot.getPercentile(50), 500));
+        UT_CHECK(near(snapshot.getPercentile(99), 990));
+        UT_CHECK(near(snapshot.getPercentile(100), 1000));
+        UT_CHECK(snapshot.getMax() == snapshot.getPercentile(100));
+
+        // Small values have a bucket each
+        IPCHistogram small;
+        for (uint64_t value = 0; value < IPCHistogram::kSubBuckets; ++value) {
+            small.record(value);
+        }
+        auto exact = small.getSnapshot();
+        UT_CHECK(exact.getPercentile(50) == IPCHistogram::kSubBuckets / 2 - 1);
+        UT_CHECK(exact.getMax() == IPCHistogram::kSubBuckets - 1);
+
+        snapshot.merge(exact);
+        UT_CHECK(snapshot.count == 1000 + IPCHistogram::kSubBuckets);
+        UT_CHECK(snapshot.getMax() == IPCHistogram::getUpperBound(IPCHistogram::getBucket(1000)));
+    }
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <ut/ipc/address.h>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// A subscriber that doesn't keep up never holds back the others. Over
+// sockets kDropOldest drops its queued records, kDisconnect drops the
+// subscriber and kBlock waits for it to drain. Over shared memory a full ring
+// drops the new record, or the subscriber
+
+using Policy = UT::IPCServer::SlowConsumerPolicy;
+
+static constexpr int kMessages = 2000;
+static constexpr size_t kPayload = 1000;
+static constexpr size_t kFrame = sizeof(UT::IPCFrameHeader) + kPayload;
+static constexpr size_t kLowWatermark = 16 * 1024;
+static constexpr size_t kHighWatermark = 64 * 1024;
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static int connectTo(const std::string& name, int receiveBuffer) {
+    sockaddr_un addr;
+    socklen_t length = UT::IPCAddress::resolve(UT_IPC_SOCKET_PATH + name, UT::IPCNamespace::kFilesystem, addr);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (receiveBuffer) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    }
+    connect(fd, reinterpret_cast<sockaddr*>(&addr), length);
+    return fd;
+}
+
+// Reads until "bytes" arrived or the stream ended, counting into "total"
+static void drain(int fd, size_t bytes, std::atomic<size_t>& total) {
+    char buffer[64 * 1024];
+    while (total < bytes) {
+        ssize_t ret = recv(fd, buffer, sizeof(buffer), 0);
+        if (ret <= 0) {
+            break;
+        }
+        total += static_cast<size_t>(ret);
+    }
+}
+
+static void testSocket(Policy policy, const std::string& name) {
+    std::mutex mutex;
+    std::vector<UT::IPCClientId> clients;
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setWatermarks(kLowWatermark, kHighWatermark);
+    server.setSlowConsumerPolicy(policy);
+    server.onClientConnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId id) {
+            server.subscribe(id, "topic");
+            std::lock_guard lock(mutex);
+            clients.push_back(id);
+        });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    auto subscribed = [&] (size_t count) {
+        return [&, count] {
+            std::lock_guard lock(mutex);
+            return clients.size() == count;
+        };
+    };
+    int fast = connectTo(name, 0);
+    UT_CHECK(waitFor(subscribed(1)));
+    int slow = connectTo(name, 4096);
+    UT_CHECK(waitFor(subscribed(2)));
+
+    std::atomic<size_t> fastBytes = 0;
+    std::atomic<size_t> slowBytes = 0;
+    std::thread fastReader(drain, fast, kMessages * kFrame, std::ref(fastBytes));
+    std::thread slowReader;
+    if (policy == Policy::kBlock) {
+        slowReader = std::thread([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            drain(slow, kMessages * kFrame, slowBytes);
+        });
+    }
+
+    // Paced by the fast subscriber, so only the slow one falls behind
+    std::vector<char> payload(kPayload, 1);
+    for (int i = 0; i < kMessages; ++i) {
+        UT_CHECK(waitFor([&] { return fastBytes + 16 * kFrame >= i * kFrame; }));
+        server.publishMessage("topic", 1, payload.data(), payload.size());
+    }
+    fastReader.join();
+    UT_CHECK(fastBytes == kMessages * kFrame);
+
+    if (policy == Policy::kBlock) {
+        slowReader.join();
+        UT_CHECK(slowBytes == kMessages * kFrame);
+        UT_CHECK(server.getMetrics().droppedBytes == 0);
+    } else if (policy == Policy::kDisconnect) {
+        UT_CHECK(waitFor([&] { return server.getMetrics().disconnected == 1; }));
+        drain(slow, kMessages * kFrame, slowBytes);
+        UT_CHECK(slowBytes < kMessages * kFrame);
+    } else {
+        auto metrics = server.getMetrics();
+        UT_CHECK(metrics.disconnected == 0);
+        UT_CHECK(metrics.droppedBytes > 0);
+        UT_CHECK(metrics.connections.size() == 2);
+        for (auto& connection : metrics.connections) {
+            UT_CHECK(connection.queuedBytes <= kHighWatermark);
+        }
+    }
+
+    server.stop();
+    close(fast);
+    close(slow);
+}
+
+static void testShm(Policy policy, const std::string& name) {
+    std::atomic<int> subscribed = 0;
+    std::atomic<bool> released = false;
+    std::atomic<int> received = 0;
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setTransport(UT::IPCTransport::kSharedMemory);
+    server.setRingSize(64 * 1024);
+    server.setSlowConsumerPolicy(policy);
+    server.onClientConnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId id) {
+            server.subscribe(id, "topic");
+            ++subscribed;
+        });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    // Stuck in its first message until released, so the ring fills up
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setTransport(UT::IPCTransport::kSharedMemory);
+    client.setMessageHandler([&] (uint32_t, const void*, size_t) {
+        while (!released) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ++received;
+    });
+    client.start(name);
+    UT_CHECK(waitFor([&] { return subscribed == 1; }));
+
+    std::vector<char> payload(kPayload, 1);
+    for (int i = 0; i < kMessages; ++i) {
+        server.publishMessage("topic", 1, payload.data(), payload.size());
+    }
+
+    if (policy == Policy::kDisconnect) {
+        UT_CHECK(waitFor([&] { return server.getMetrics().disconnected == 1; }));
+        // Publishing to the dropped subscriber is a no-op
+        server.publishMessage("topic", 1, payload.data(), payload.size());
+    } else {
+        auto metrics = server.getMetrics();
+        UT_CHECK(metrics.disconnected == 0);
+        UT_CHECK(metrics.droppedBytes > 0);
+        UT_CHECK(metrics.messagesSent > 0 && metrics.messagesSent < kMessages);
+    }
+
+    released = true;
+    if (policy == Policy::kDropOldest) {
+        UT_CHECK(waitFor([&] { return received == static_cast<int>(server.getMetrics().messagesSent); }));
+    }
+    client.stop();
+    server.stop();
+}
+
+int main() {
+    testSocket(Policy::kDropOldest, "test-pubsub-drop");
+    testSocket(Policy::kDisconnect, "test-pubsub-disconnect");
+    testSocket(Policy::kBlock, "test-pubsub-block");
+    testShm(Policy::kDropOldest, "test-pubsub-shm-drop");
+    testShm(Policy::kDisconnect, "test-pubsub-shm-disconnect");
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
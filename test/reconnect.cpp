@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <dirent.h>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// A client backing off connects within its capped delay once the server
+// shows up, without leaking a socket per failed attempt, retries a lost
+// connection right away and leaves a long wait as soon as stop() is called
+// or, watching the socket, as soon as the server binds
+
+using Clock = std::chrono::steady_clock;
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// The fewest seen over a few samples, an attempt in flight holds one more
+static int countDescriptors() {
+    int fewest = -1;
+    for (int i = 0; i < 20; ++i) {
+        int count = 0;
+        DIR* dir = opendir("/proc/self/fd");
+        while (readdir(dir)) {
+            ++count;
+        }
+        closedir(dir);
+        fewest = fewest < 0 ? count : std::min(fewest, count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return fewest;
+}
+
+static void testDefaults() {
+    UT::IPCClient client;
+    UT_CHECK(client.getReconnectInitial() == UT_IPC_RECONNECT_INITIAL);
+    UT_CHECK(client.getReconnectMax() == UT_IPC_RECONNECT_MAX);
+    UT_CHECK(client.getReconnectTimeout() == UT_IPC_RECONNECT_TIMEOUT);
+
+    client.setReconnectTimeout(3);
+    UT_CHECK(client.getReconnectInitial() == 3000 && client.getReconnectMax() == 3000);
+    UT_CHECK(client.getReconnectJitter() == 0);
+    UT_CHECK(client.getReconnectTimeout() == 3);
+}
+
+static void testBackoff() {
+    const std::string name = "test-reconnect-backoff";
+
+    UT::IPCClient client;
+    client.setReconnectBackoff(1, 50, 0.2);
+    client.start(name);
+
+    // Many failed attempts by now, their sockets closed
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int before = countDescriptors();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    UT_CHECK(countDescriptors() == before);
+    UT_CHECK(!client.getReady());
+
+    // Within the capped delay
+    UT::IPCServer server;
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+    auto start = Clock::now();
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+    UT_CHECK(Clock::now() - start < std::chrono::seconds(1));
+
+    // Lost and retried, the backoff starts over
+    server.stop();
+    UT_CHECK(waitFor([&] { return !client.getReady(); }));
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+    start = Clock::now();
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+    UT_CHECK(Clock::now() - start < std::chrono::seconds(1));
+
+    client.stop();
+    server.stop();
+}
+
+static void testInterrupted() {
+    const std::string name = "test-reconnect-interrupted";
+
+    // Waiting a minute between attempts
+    UT::IPCClient client;
+    client.setReconnectTimeout(60);
+    client.start(name);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto start = Clock::now();
+    UT_CHECK(client.stop() == UT::IPCClient::RetCode::kSuccess);
+    UT_CHECK(Clock::now() - start < std::chrono::seconds(1));
+
+    // The same wait cut short by the socket showing up
+    client.setWatchSocket(true);
+    client.start(name);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    UT_CHECK(!client.getReady());
+
+    UT::IPCServer server;
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+    start = Clock::now();
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+    UT_CHECK(Clock::now() - start < std::chrono::seconds(5));
+
+    client.stop();
+    server.stop();
+}
+
+int main() {
+    testDefaults();
+    testBackoff();
+    testInterrupted();
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
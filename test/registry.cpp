@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <ut/ipc/address.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// Every connected client is found by its id whichever shard of the registry
+// holds it, while several threads look clients up at once. The id of a client
+// that left finds nothing anymore, also after new clients took its place
+
+static constexpr int kClients = 64;
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static int connectTo(const std::string& name) {
+    sockaddr_un addr;
+    socklen_t length = UT::IPCAddress::resolve(UT_IPC_SOCKET_PATH + name, UT::IPCNamespace::kFilesystem, addr);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    connect(fd, reinterpret_cast<sockaddr*>(&addr), length);
+    return fd;
+}
+
+int main() {
+    const std::string name = "test-registry";
+
+    std::mutex mutex;
+    std::vector<UT::IPCClientId> connected;
+    std::set<UT::IPCClientId> gone;
+
+    UT::IPCServer server;
+    server.setWorkers(4);
+    server.onClientConnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId id) {
+            std::lock_guard lock(mutex);
+            connected.push_back(id);
+        });
+    server.onClientDisconnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId id) {
+            std::lock_guard lock(mutex);
+            gone.insert(id);
+        });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    std::vector<int> fds;
+    for (int i = 0; i < kClients; ++i) {
+        fds.push_back(connectTo(name));
+    }
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return connected.size() == kClients;
+    }));
+
+    std::vector<UT::IPCClientId> ids;
+    {
+        std::lock_guard lock(mutex);
+        ids = connected;
+    }
+    UT_CHECK(std::set<UT::IPCClientId>(ids.begin(), ids.end()).size() == kClients);
+    auto metrics = server.getMetrics();
+    UT_CHECK(metrics.connections.size() == kClients);
+    for (auto& connection : metrics.connections) {
+        UT_CHECK(std::find(ids.begin(), ids.end(), connection.client) != ids.end());
+    }
+
+    // Each thread tags and reads back its own clients, the others' stay put
+    std::vector<int> tags(kClients);
+    std::atomic<bool> found = true;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (int round = 0; round < 1000; ++round) {
+                for (int i = t; i < kClients; i += 4) {
+                    server.setUserData(ids[static_cast<size_t>(i)], &tags[static_cast<size_t>(i)]);
+                    found = found && server.getUserData(ids[static_cast<size_t>(i)]) == &tags[static_cast<size_t>(i)];
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    UT_CHECK(found);
+
+    // Gone, then replaced by as many new clients
+    for (int i = 0; i < kClients / 2; ++i) {
+        close(fds[static_cast<size_t>(i)]);
+    }
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return gone.size() == kClients / 2;
+    }));
+    for (int i = 0; i < kClients / 2; ++i) {
+        fds[static_cast<size_t>(i)] = connectTo(name);
+    }
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return connected.size() == kClients + kClients / 2;
+    }));
+    std::set<UT::IPCClientId> left;
+    {
+        std::lock_guard lock(mutex);
+        left = gone;
+    }
+    for (auto id : left) {
+        UT_CHECK(std::find(ids.begin(), ids.end(), id) != ids.end());
+    }
+
+    metrics = server.getMetrics();
+    UT_CHECK(metrics.connections.size() == kClients);
+    UT_CHECK(metrics.disconnected == kClients / 2);
+    std::set<UT::IPCClientId> live;
+    for (auto& connection : metrics.connections) {
+        live.insert(connection.client);
+    }
+    for (int i = 0; i < kClients; ++i) {
+        auto id = ids[static_cast<size_t>(i)];
+        if (left.count(id)) {
+            UT_CHECK(!live.count(id));
+            UT_CHECK(server.getUserData(id) == nullptr);
+            server.setUserData(id, &tags[0]);
+            UT_CHECK(server.getUserData(id) == nullptr);
+        } else {
+            UT_CHECK(live.count(id));
+            UT_CHECK(server.getUserData(id) == &tags[static_cast<size_t>(i)]);
+        }
+    }
+    UT_CHECK(server.getUserData(0) == nullptr);
+
+    server.stop();
+    for (int fd : fds) {
+        close(fd);
+    }
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
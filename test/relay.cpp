@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// File ranges and pipes relayed by the server arrive byte for byte, in turn
+// with what was sent around them, on every backend. Framed, a file is one
+// message and a pipe a message on its channel. The caller's descriptors may
+// be closed right away, and sources relays can't take are refused
+
+using Backend = UT::IPCPoller::Backend;
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static std::string pattern(size_t bytes, char seed) {
+    std::string data;
+    for (size_t i = 0; i < bytes; ++i) {
+        data.push_back(static_cast<char>(seed + i % 97));
+    }
+    return data;
+}
+
+static int file(const std::string& content) {
+    int fd = memfd_create("ut.ipc.test", MFD_CLOEXEC);
+    write(fd, content.data(), content.size());
+    return fd;
+}
+
+// Writes "content" into the pipe in pieces, then closes it
+static std::thread produce(int fd, std::string content) {
+    return std::thread([fd, content = std::move(content)] {
+        for (size_t offset = 0; offset < content.size(); ) {
+            ssize_t ret = write(fd, content.data() + offset, std::min<size_t>(content.size() - offset, 10000));
+            if (ret <= 0) {
+                break;
+            }
+            offset += static_cast<size_t>(ret);
+        }
+        close(fd);
+    });
+}
+
+static void testUnframed(Backend backend, const std::string& name) {
+    std::mutex mutex;
+    std::string received;
+    std::atomic<UT::IPCClientId> id = 0;
+
+    UT::IPCServer server;
+    server.setBackend(backend);
+    server.onClientConnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId client) {
+            id = client;
+        });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    UT::IPCClient client;
+    client.setDataHandler([&] (const void* data, size_t bytes) {
+        std::lock_guard lock(mutex);
+        received.append(static_cast<const char*>(data), bytes);
+    });
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady() && id; }));
+
+    // A range from the middle, the descriptor closed at once
+    std::string content = pattern(300000, 'f');
+    int fd = file(content);
+    server.send(id, "head", 4);
+    server.sendFile(id, fd, 100, 200000);
+    close(fd);
+    server.send(id, "tail", 4);
+    std::string expected = "head" + content.substr(100, 200000) + "tail";
+
+    int pipe[2];
+    UT_CHECK(pipe2(pipe, O_CLOEXEC) == 0);
+    std::string piped = pattern(500000, 'p');
+    server.forward(id, pipe[0]);
+    close(pipe[0]);
+    auto producer = produce(pipe[1], piped);
+    expected += piped;
+
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return received.size() >= expected.size();
+    }));
+    producer.join();
+    {
+        std::lock_guard lock(mutex);
+        UT_CHECK(received == expected);
+    }
+
+    client.stop();
+    server.stop();
+}
+
+static void testFramed(Backend backend, const std::string& name) {
+    std::mutex mutex;
+    std::string message;
+    std::string channelMessage;
+    std::atomic<UT::IPCClientId> id = 0;
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setBackend(backend);
+    server.onClientConnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId client) {
+            id = client;
+        });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setMessageHandler([&] (uint32_t type, const void* data, size_t bytes) {
+        std::lock_guard lock(mutex);
+        if (type == 4) {
+            message.assign(static_cast<const char*>(data), bytes);
+        }
+    });
+    client.onChannelMessageReceived.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (uint32_t channel, uint32_t type, std::shared_ptr<void> data, ssize_t bytes) {
+            std::lock_guard lock(mutex);
+            if (channel == 2 && type == 5) {
+                channelMessage.assign(static_cast<const char*>(data.get()), static_cast<size_t>(bytes));
+            }
+        });
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady() && id; }));
+
+    std::string content = pattern(70000, 'F');
+    int fd = file(content);
+    server.sendFile(id, fd, 0, content.size(), 4);
+
+    int pipe[2];
+    UT_CHECK(pipe2(pipe, O_CLOEXEC) == 0);
+    std::string piped = pattern(300000, 'P');
+    server.forward(id, pipe[0], 5, 2);
+    auto producer = produce(pipe[1], piped);
+
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return !message.empty() && !channelMessage.empty();
+    }));
+    producer.join();
+    {
+        std::lock_guard lock(mutex);
+        UT_CHECK(message == content);
+        UT_CHECK(channelMessage == piped);
+    }
+
+    // Pipes have no size to frame, files are too large for one frame
+    auto refused = [] (const std::function<void()>& call) {
+        try {
+            call();
+        } catch (const std::invalid_argument&) {
+            return true;
+        } catch (const std::length_error&) {
+            return true;
+        }
+        return false;
+    };
+    UT_CHECK(refused([&] { server.forward(id, pipe[0], 5, 0); }));
+    UT_CHECK(refused([&] { server.sendFile(id, fd, 0, UT_IPC_FRAME_MAX_SIZE + 1, 4, 0); }));
+    UT_CHECK(refused([&] { server.sendFile(id, pipe[0], 0, 1, 4); }));
+    UT_CHECK(refused([&] { server.forward(id, fd, 5, 2); }));
+
+    close(fd);
+    close(pipe[0]);
+    client.stop();
+    server.stop();
+}
+
+static void testShmRefused() {
+    UT::IPCServer server;
+    server.setTransport(UT::IPCTransport::kSharedMemory);
+    int fd = file("x");
+    bool thrown = false;
+    try {
+        server.sendFile(1, fd, 0, 1);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    UT_CHECK(thrown);
+    close(fd);
+}
+
+int main() {
+    testUnframed(Backend::kPoll, "test-relay-poll");
+    testUnframed(Backend::kEpoll, "test-relay-epoll");
+    testUnframed(Backend::kUring, "test-relay-uring");
+    testFramed(Backend::kPoll, "test-relay-framed-poll");
+    testFramed(Backend::kUring, "test-relay-framed-uring");
+    testShmRefused();
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
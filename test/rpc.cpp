@@ -0,0 +1,161 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ut/ipc/rpcclient.h>
+#include <ut/ipc/rpcserver.h>
+#include "check.h"
+
+// Calls pipelined over one connection are matched to their responses by id,
+// whatever order the replies come in. A call not answered in time times out
+// and a late reply to it is ignored, unknown methods and throwing handlers
+// fail the call, handlers may be bound and unbound while calls arrive, and
+// calls in flight or issued without a connection complete as disconnected
+
+using Status = UT::IPCRpcStatus;
+
+enum Method : uint32_t {
+    kEcho = 1,
+    kDeferred,
+    kImmediate,
+    kThrowing,
+    kToggled
+};
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static std::string toString(const UT::IPCRpcClient::Response& response) {
+    return std::string(static_cast<const char*>(response.data.get()), response.bytes > 0 ? static_cast<size_t>(response.bytes) : 0);
+}
+
+int main() {
+    const std::string name = "test-rpc";
+
+    // Answered later from this thread
+    std::mutex mutex;
+    std::vector<std::pair<UT::IPCClientId, uint32_t>> deferred;
+
+    UT::IPCRpcServer server;
+    server.bind(kEcho, [&server] (UT::IPCClientId client, uint32_t id, std::shared_ptr<void> data, ssize_t bytes) {
+        server.reply(client, id, data.get(), static_cast<size_t>(bytes));
+    });
+    server.bind(kDeferred, [&] (UT::IPCClientId client, uint32_t id, std::shared_ptr<void>, ssize_t) {
+        std::lock_guard lock(mutex);
+        deferred.emplace_back(client, id);
+    });
+    server.bind(kImmediate, [&server] (UT::IPCClientId client, uint32_t id, std::shared_ptr<void>, ssize_t) {
+        server.reply(client, id, "now", 3);
+    });
+    server.bind(kThrowing, [] (UT::IPCClientId, uint32_t, std::shared_ptr<void>, ssize_t) {
+        throw std::runtime_error("boom");
+    });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    UT::IPCRpcClient client;
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+
+    // Pipelined
+    std::vector<std::future<UT::IPCRpcClient::Response>> futures;
+    for (int i = 0; i < 100; ++i) {
+        std::string payload = "echo " + std::to_string(i);
+        futures.push_back(client.call(kEcho, payload.data(), payload.size()));
+    }
+    for (int i = 0; i < 100; ++i) {
+        auto response = futures[static_cast<size_t>(i)].get();
+        UT_CHECK(response.status == Status::kSuccess);
+        UT_CHECK(toString(response) == "echo " + std::to_string(i));
+    }
+
+    // Replied out of order
+    std::vector<std::string> order;
+    client.call(kDeferred, "first", 5, [&] (UT::IPCRpcClient::Response response) {
+        std::lock_guard lock(mutex);
+        order.push_back(response.status == Status::kSuccess ? toString(response) : "failed");
+    });
+    auto immediate = client.call(kImmediate, nullptr, 0).get();
+    UT_CHECK(immediate.status == Status::kSuccess && toString(immediate) == "now");
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return deferred.size() == 1;
+    }));
+    server.reply(deferred[0].first, deferred[0].second, "later", 5);
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return order.size() == 1;
+    }));
+    UT_CHECK(order == std::vector<std::string>({ "later" }));
+
+    // Timed out, then replied
+    std::atomic<int> completions = 0;
+    std::atomic<Status> status = Status::kSuccess;
+    client.call(kDeferred, nullptr, 0, [&] (UT::IPCRpcClient::Response response) {
+        status = response.status;
+        ++completions;
+    }, 50);
+    UT_CHECK(waitFor([&] { return completions == 1; }));
+    UT_CHECK(status == Status::kTimeout);
+    {
+        std::lock_guard lock(mutex);
+        UT_CHECK(deferred.size() == 2);
+        server.reply(deferred[1].first, deferred[1].second, "late", 4);
+    }
+    UT_CHECK(client.call(kEcho, "x", 1).get().status == Status::kSuccess);
+    UT_CHECK(completions == 1);
+
+    UT_CHECK(client.call(99, nullptr, 0).get().status == Status::kUnknownMethod);
+    auto thrown = client.call(kThrowing, nullptr, 0).get();
+    UT_CHECK(thrown.status == Status::kFailed && toString(thrown) == "boom");
+
+    // Bound and unbound under incoming calls
+    std::atomic<bool> toggling = true;
+    std::thread toggler([&] {
+        while (toggling) {
+            server.bind(kToggled, [&server] (UT::IPCClientId client, uint32_t id, std::shared_ptr<void>, ssize_t) {
+                server.reply(client, id, nullptr, 0);
+            });
+            server.unbind(kToggled);
+        }
+    });
+    for (int i = 0; i < 1000; ++i) {
+        auto response = client.call(kToggled, nullptr, 0).get();
+        UT_CHECK(response.status == Status::kSuccess || response.status == Status::kUnknownMethod);
+    }
+    toggling = false;
+    toggler.join();
+    UT_CHECK(client.call(kToggled, nullptr, 0).get().status == Status::kUnknownMethod);
+
+    // Pending when the server goes away, and issued after
+    auto pending = client.call(kDeferred, nullptr, 0, 10000);
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return deferred.size() == 3;
+    }));
+    server.stop();
+    UT_CHECK(pending.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    UT_CHECK(pending.get().status == Status::kDisconnected);
+
+    auto start = std::chrono::steady_clock::now();
+    auto orphan = client.call(kEcho, "x", 1, 10000);
+    UT_CHECK(orphan.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    UT_CHECK(orphan.get().status == Status::kDisconnected);
+    UT_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+    client.stop();
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// A batching client holds small messages until the oldest one waited the
+// delay, the batch reached its size or flush() is called, and never longer.
+// Messages carrying descriptors wait with the batch and keep their place in
+// the stream
+
+using Clock = std::chrono::steady_clock;
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+class Receiver {
+public:
+    explicit Receiver(const std::string& name) {
+        mServer.setFramed(true);
+        mServer.setMessageHandler([this] (UT::IPCClientId, uint32_t type, const void*, size_t) {
+            std::lock_guard lock(mMutex);
+            mTypes.push_back(type);
+        });
+        mServer.onDescriptorsReceived.addEventHandler(
+            UT::EventLoop::getMainInstance(),
+            [this] (UT::IPCClientId, std::shared_ptr<const std::vector<int>> fds) {
+                std::lock_guard lock(mMutex);
+                mDescriptors += static_cast<int>(fds->size());
+            });
+        mServer.start(name);
+    }
+
+    ~Receiver() { mServer.stop(); }
+
+    std::vector<uint32_t> getTypes() {
+        std::lock_guard lock(mMutex);
+        return mTypes;
+    }
+
+    int getDescriptors() {
+        std::lock_guard lock(mMutex);
+        return mDescriptors;
+    }
+
+private:
+    UT::IPCServer mServer;
+    std::mutex mMutex;
+    std::vector<uint32_t> mTypes;
+    int mDescriptors = 0;
+}; // class Receiver
+
+static void testDeadline() {
+    const std::string name = "test-send-batch-deadline";
+    Receiver receiver(name);
+
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setBatching(1024 * 1024, 300 * 1000);
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < 5; ++i) {
+        client.sendMessage(i, "x", 1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    UT_CHECK(receiver.getTypes().empty());
+
+    UT_CHECK(waitFor([&] { return receiver.getTypes().size() == 5; }));
+    auto elapsed = Clock::now() - start;
+    UT_CHECK(elapsed >= std::chrono::milliseconds(250) && elapsed < std::chrono::seconds(3));
+    UT_CHECK(receiver.getTypes() == std::vector<uint32_t>({ 0, 1, 2, 3, 4 }));
+
+    client.stop();
+}
+
+static void testThreshold() {
+    const std::string name = "test-send-batch-threshold";
+    Receiver receiver(name);
+
+    // The delay alone would hold them for a minute
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setBatching(4096, 60 * 1000 * 1000);
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+
+    std::string payload(1000, 'x');
+    client.sendMessage(0, payload.data(), payload.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    UT_CHECK(receiver.getTypes().empty());
+
+    for (uint32_t i = 1; i < 5; ++i) {
+        client.sendMessage(i, payload.data(), payload.size());
+    }
+    UT_CHECK(waitFor([&] { return receiver.getTypes().size() == 5; }));
+
+    // Below the threshold again, up to flush()
+    client.sendMessage(5, "x", 1);
+    int fds[2];
+    UT_CHECK(pipe2(fds, O_CLOEXEC) == 0);
+    client.sendMessage(6, "x", 1, { fds[0], fds[1] });
+    client.sendMessage(7, "x", 1);
+    close(fds[0]);
+    close(fds[1]);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    UT_CHECK(receiver.getTypes().size() == 5 && receiver.getDescriptors() == 0);
+
+    client.flush();
+    UT_CHECK(waitFor([&] { return receiver.getTypes().size() == 8 && receiver.getDescriptors() == 2; }));
+    UT_CHECK(receiver.getTypes() == std::vector<uint32_t>({ 0, 1, 2, 3, 4, 5, 6, 7 }));
+
+    client.stop();
+}
+
+int main() {
+    testDeadline();
+    testThreshold();
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
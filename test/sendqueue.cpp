@@ -0,0 +1,183 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <ut/ipc/address.h>
+#include <ut/ipc/client.h>
+#include <ut/ipc/sendqueue.h>
+#include "check.h"
+
+// A socket taking only part of the queue leaves the rest pending, and the
+// stream comes out whole and in order across partial writes. The client is
+// reported congested above the high watermark and recovered below the low
+// one, and a restart drops what was queued for the old connection instead of
+// sending it over the new one
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Reads whatever is there without blocking
+static void drain(int fd, std::string& received) {
+    char buffer[64 * 1024];
+    ssize_t ret;
+    while ((ret = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        received.append(buffer, static_cast<size_t>(ret));
+    }
+}
+
+static void testPartialWrites() {
+    int fds[2];
+    UT_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    int small = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    // Pushed blocks and appended pieces, every byte tells its position
+    std::string expected;
+    UT::IPCSendQueue queue;
+    for (int i = 0; i < 64; ++i) {
+        size_t bytes = i % 2 ? 10000 : 100;
+        std::string piece;
+        for (size_t j = 0; j < bytes; ++j) {
+            piece.push_back(static_cast<char>((expected.size() + j) % 251));
+        }
+        expected += piece;
+
+        if (i % 2) {
+            std::shared_ptr<void> block(new char[bytes], std::default_delete<char[]>());
+            memcpy(block.get(), piece.data(), bytes);
+            queue.push(std::move(block), bytes);
+        } else {
+            queue.append(piece.data(), bytes, 1024);
+        }
+    }
+    UT_CHECK(queue.getBytes() == expected.size());
+
+    std::string received;
+    int pending = 0;
+    while (true) {
+        auto ret = queue.flush(fds[0]);
+        UT_CHECK(ret != UT::IPCSendQueue::RetCode::kFailed);
+        if (ret != UT::IPCSendQueue::RetCode::kPending) {
+            break;
+        }
+        ++pending;
+        UT_CHECK(queue.getBytes() == expected.size() - received.size() - [&] {
+            // Written by the last flush, not received yet
+            int queued = 0;
+            ioctl(fds[1], FIONREAD, &queued);
+            return static_cast<size_t>(queued);
+        }());
+        drain(fds[1], received);
+    }
+    drain(fds[1], received);
+
+    UT_CHECK(pending > 0);
+    UT_CHECK(queue.isEmpty() && queue.getBytes() == 0);
+    UT_CHECK(received == expected);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void testWatermarks() {
+    const std::string name = "test-send-queue";
+    const std::string path = UT_IPC_SOCKET_PATH + name;
+
+    sockaddr_un addr;
+    socklen_t length = UT::IPCAddress::resolve(path, UT::IPCNamespace::kFilesystem, addr);
+    int sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    UT_CHECK(bind(sfd, reinterpret_cast<sockaddr*>(&addr), length) == 0);
+    UT_CHECK(listen(sfd, 4) == 0);
+
+    std::atomic<bool> congested = false; // last reported
+    UT::IPCClient client;
+    client.setWatermarks(16 * 1024, 64 * 1024);
+    client.onCongestionChanged.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (bool state) {
+            congested = state;
+        });
+    client.start(name);
+    int peer = accept(sfd, nullptr, nullptr);
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+
+    // Nobody reads, so the queue grows past the high watermark and stays
+    // there once the socket buffer is full as well
+    std::string payload(1000, 'x');
+    auto congest = [&] {
+        size_t sent = 0;
+        while (!congested && sent < 64 * 1024 * 1024) {
+            client.send(payload.data(), payload.size());
+            sent += payload.size();
+        }
+        for (int i = 0; i < 1024; ++i) {
+            client.send(payload.data(), payload.size());
+            sent += payload.size();
+        }
+        return sent;
+    };
+    size_t sent = congest();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    UT_CHECK(congested);
+
+    std::string received;
+    UT_CHECK(waitFor([&] {
+        drain(peer, received);
+        return received.size() == sent;
+    }));
+    UT_CHECK(waitFor([&] { return !congested; }));
+    UT_CHECK(received == std::string(sent, 'x'));
+
+    // Congested again, then restarted with the backlog still queued
+    congest();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    UT_CHECK(congested);
+    client.stop();
+    UT_CHECK(waitFor([&] { return !congested; }));
+    close(peer);
+
+    client.start(name);
+    peer = accept(sfd, nullptr, nullptr);
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+    client.send("fresh", 5);
+
+    received.clear();
+    UT_CHECK(waitFor([&] {
+        drain(peer, received);
+        return received.size() >= 5;
+    }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    drain(peer, received);
+    UT_CHECK(received == "fresh");
+
+    client.stop();
+    close(peer);
+    close(sfd);
+    unlink(path.c_str());
+}
+
+int main() {
+    testPartialWrites();
+    testWatermarks();
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <ut/ipc/address.h>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// Over SOCK_SEQPACKET every send arrives as one piece of exactly its size,
+// unframed data as well as frames, on every backend. Messages over the packet
+// limit are refused by the sender, and a peer sending a larger packet anyway
+// is disconnected instead of having it delivered cut short
+
+static const std::vector<size_t> kSizes = { 1, 7, 100, 4095, 4097, 30000, UT_IPC_PACKET_MAX_SIZE };
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static int connectTo(const std::string& name) {
+    sockaddr_un addr;
+    socklen_t length = UT::IPCAddress::resolve(UT_IPC_SOCKET_PATH + name, UT::IPCNamespace::kFilesystem, addr);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    connect(fd, reinterpret_cast<sockaddr*>(&addr), length);
+    return fd;
+}
+
+static std::string payload(size_t bytes, char seed) {
+    std::string data;
+    for (size_t i = 0; i < bytes; ++i) {
+        data.push_back(static_cast<char>(seed + i % 13));
+    }
+    return data;
+}
+
+// Packets back to back keep their boundaries, the oversized one ends the peer
+static void testUnframed(UT::IPCPoller::Backend backend, const std::string& name) {
+    std::mutex mutex;
+    std::vector<std::string> received;
+    std::atomic<UT::IPCClientId> id = 0;
+
+    UT::IPCServer server;
+    server.setSocketType(UT::IPCSocketType::kSeqPacket);
+    server.setBackend(backend);
+    server.setDataHandler([&] (UT::IPCClientId, const void* data, size_t bytes) {
+        std::lock_guard lock(mutex);
+        received.emplace_back(static_cast<const char*>(data), bytes);
+    });
+    server.onClientConnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId client) {
+            id = client;
+        });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    int fd = connectTo(name);
+    UT_CHECK(waitFor([&] { return id != 0; }));
+
+    std::vector<std::string> sent;
+    for (int round = 0; round < 4; ++round) {
+        for (size_t bytes : kSizes) {
+            sent.push_back(payload(bytes, static_cast<char>('a' + sent.size() % 20)));
+            UT_CHECK(::send(fd, sent.back().data(), bytes, 0) == static_cast<ssize_t>(bytes));
+        }
+    }
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return received.size() == sent.size();
+    }));
+    {
+        std::lock_guard lock(mutex);
+        UT_CHECK(received == sent);
+    }
+
+    // The other direction, one read per packet
+    std::string reply = payload(3000, 'r');
+    server.send(id, reply.data(), reply.size());
+    server.send(id, "x", 1);
+    std::vector<char> buffer(UT_IPC_PACKET_MAX_SIZE);
+    UT_CHECK(recv(fd, buffer.data(), buffer.size(), 0) == static_cast<ssize_t>(reply.size()));
+    UT_CHECK(std::string(buffer.data(), reply.size()) == reply);
+    UT_CHECK(recv(fd, buffer.data(), buffer.size(), 0) == 1 && buffer[0] == 'x');
+
+    std::string large(UT_IPC_PACKET_MAX_SIZE + 1, 'l');
+    bool thrown = false;
+    try {
+        server.send(id, large.data(), large.size());
+    } catch (const std::length_error&) {
+        thrown = true;
+    }
+    UT_CHECK(thrown);
+
+    // Cut short by the receiving slot, so it's dropped with the peer
+    UT_CHECK(::send(fd, large.data(), large.size(), 0) == static_cast<ssize_t>(large.size()));
+    UT_CHECK(waitFor([&] { return server.getMetrics().disconnected == 1; }));
+    UT_CHECK(recv(fd, buffer.data(), buffer.size(), 0) == 0);
+    {
+        std::lock_guard lock(mutex);
+        UT_CHECK(received.size() == sent.size());
+    }
+
+    close(fd);
+    server.stop();
+}
+
+// Messages of every size echoed, each read back whole
+static void testFramed(UT::IPCPoller::Backend backend, const std::string& name) {
+    std::mutex mutex;
+    std::vector<std::pair<uint32_t, std::string>> echoed;
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setSocketType(UT::IPCSocketType::kSeqPacket);
+    server.setBackend(backend);
+    server.setMessageHandler([&server] (UT::IPCClientId client, uint32_t type, const void* data, size_t bytes) {
+        server.sendMessage(client, type, data, bytes);
+    });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setSocketType(UT::IPCSocketType::kSeqPacket);
+    client.setMessageHandler([&] (uint32_t type, const void* data, size_t bytes) {
+        std::lock_guard lock(mutex);
+        echoed.emplace_back(type, std::string(static_cast<const char*>(data), bytes));
+    });
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+
+    std::vector<std::pair<uint32_t, std::string>> sent;
+    sent.emplace_back(0, std::string());
+    for (size_t bytes : kSizes) {
+        // The largest one fills the packet along with its header
+        bytes = std::min(bytes, UT_IPC_PACKET_MAX_SIZE - sizeof(UT::IPCFrameHeader));
+        sent.emplace_back(static_cast<uint32_t>(sent.size()), payload(bytes, 'm'));
+    }
+    for (auto& [type, data] : sent) {
+        client.sendMessage(type, data.data(), data.size());
+    }
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return echoed.size() == sent.size();
+    }));
+    {
+        std::lock_guard lock(mutex);
+        UT_CHECK(echoed == sent);
+    }
+
+    // Header and payload have to fit into one packet
+    std::string large(UT_IPC_PACKET_MAX_SIZE - sizeof(UT::IPCFrameHeader) + 1, 'l');
+    bool thrown = false;
+    try {
+        client.sendMessage(1, large.data(), large.size());
+    } catch (const std::length_error&) {
+        thrown = true;
+    }
+    UT_CHECK(thrown);
+
+    client.stop();
+    server.stop();
+}
+
+int main() {
+    testUnframed(UT::IPCPoller::Backend::kPoll, "test-seqpacket-poll");
+    testUnframed(UT::IPCPoller::Backend::kEpoll, "test-seqpacket-epoll");
+    testUnframed(UT::IPCPoller::Backend::kUring, "test-seqpacket-uring");
+    testFramed(UT::IPCPoller::Backend::kPoll, "test-seqpacket-framed-poll");
+    testFramed(UT::IPCPoller::Backend::kUring, "test-seqpacket-framed-uring");
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
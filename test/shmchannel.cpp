@@ -0,0 +1,198 @@
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <ut/ipc/descriptors.h>
+#include <ut/ipc/shmchannel.h>
+#include "check.h"
+
+// Records of every size come out of a ring in order and intact while head
+// and tail wrap around it many times. A peer publishing more than the ring
+// holds, or a record reaching past head, gets the channel rejected instead
+// of the reader leaving the mapping
+
+using RetCode = UT::IPCShmChannel::RetCode;
+
+static const size_t kPage = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+static void testWraparound() {
+    int fds[2];
+    UT_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    auto server = UT::IPCShmChannel::create(fds[0], kPage);
+    auto client = UT::IPCShmChannel::accept(fds[1], 1000);
+    UT_CHECK(server && client);
+    if (!server || !client) {
+        return;
+    }
+    UT_CHECK(server->getCapacity() == kPage && client->getCapacity() == kPage);
+
+    UT::IPCFrameHeader header = { static_cast<uint32_t>(kPage), 0, 0, 0, 0 };
+    UT_CHECK(server->write(header, nullptr) == RetCode::kTooLarge);
+
+    // Sizes coprime to the capacity, so records straddle its end all along
+    uint32_t written = 0;
+    uint32_t read = 0;
+    bool intact = true;
+    auto callback = [&] (const UT::IPCFrameHeader& header, const void* data, size_t bytes) {
+        std::string expected(bytes, static_cast<char>('a' + read % 26));
+        intact &= header.type == read++ && bytes == header.size && memcmp(data, expected.data(), bytes) == 0;
+    };
+    for (int round = 0; round < 200; ++round) {
+        int full = 0;
+        while (true) {
+            size_t bytes = 1 + (written * 37) % 700;
+            std::string payload(bytes, static_cast<char>('a' + written % 26));
+            header = { static_cast<uint32_t>(bytes), written, 0, 0, 0 };
+            if (server->write(header, payload.data(), {}, false) == RetCode::kFull) {
+                ++full;
+                break;
+            }
+            ++written;
+        }
+        UT_CHECK(full == 1);
+        UT_CHECK(client->read(callback) == RetCode::kSuccess);
+        UT_CHECK(read == written);
+    }
+    UT_CHECK(intact);
+    UT_CHECK(written > 200 * kPage / 700);
+
+    // The other direction is a separate ring
+    header = { 5, 42, 0, 0, 0 };
+    UT_CHECK(client->write(header, "hello") == RetCode::kSuccess);
+    bool received = false;
+    UT_CHECK(server->read([&] (const UT::IPCFrameHeader& header, const void* data, size_t bytes) {
+        received = header.type == 42 && bytes == 5 && memcmp(data, "hello", 5) == 0;
+    }) == RetCode::kSuccess);
+    UT_CHECK(received);
+
+    client.reset();
+    server.reset();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// Plays a peer writing whatever it likes into the client's receiving ring
+class Peer {
+public:
+    Peer() {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, mFds);
+
+        // Two rings, each a control page followed by the data area
+        size_t size = (kPage + kCapacity) * 2;
+        mMemFd = memfd_create("ut.ipc.test", MFD_CLOEXEC);
+        ftruncate(mMemFd, static_cast<off_t>(size));
+        mRegion = static_cast<char*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mMemFd, 0));
+        mLocalEfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        mRemoteEfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        // Wire format of the handshake, see shmchannel.cpp
+        struct {
+            uint32_t magic = 0x48535455;
+            uint32_t reserved = 0;
+            uint64_t capacity = kCapacity;
+        } handshake;
+        UT::IPCDescriptors::send(mFds[0], &handshake, sizeof(handshake), { mMemFd, mRemoteEfd, mLocalEfd });
+        mChannel = UT::IPCShmChannel::accept(mFds[1], 1000);
+    }
+
+    ~Peer() {
+        mChannel.reset();
+        munmap(mRegion, (kPage + kCapacity) * 2);
+        close(mMemFd);
+        close(mLocalEfd);
+        close(mRemoteEfd);
+        close(mFds[0]);
+        close(mFds[1]);
+    }
+
+    // Head sits at the start of the control page, tail a cache line later
+    void publish(uint64_t tail, uint64_t head, uint32_t size) {
+        UT::IPCFrameHeader header = { size, 0, 0, 0, 0 };
+        memcpy(mRegion + kPage + (tail & (kCapacity - 1)), &header, sizeof(header));
+        memcpy(mRegion + 64, &tail, sizeof(tail));
+        memcpy(mRegion, &head, sizeof(head));
+    }
+
+    UT::IPCShmChannel* getChannel() { return mChannel.get(); }
+
+    static constexpr size_t kCapacity = 64 * 1024;
+
+private:
+    int mFds[2] = { -1, -1 };
+    int mMemFd = -1;
+    int mLocalEfd = -1;
+    int mRemoteEfd = -1;
+    char* mRegion = nullptr;
+    std::unique_ptr<UT::IPCShmChannel> mChannel;
+}; // class Peer
+
+static void testBounds() {
+    constexpr size_t kCapacity = Peer::kCapacity;
+    constexpr size_t kHeader = sizeof(UT::IPCFrameHeader);
+
+    int records = 0;
+    auto callback = [&records] (const UT::IPCFrameHeader&, const void*, size_t) { ++records; };
+
+    {
+        Peer peer;
+        UT_CHECK(peer.getChannel());
+        if (peer.getChannel()) {
+            // A well formed record ending right at the ring's wrapped end
+            peer.publish(kCapacity - kHeader, 2 * kCapacity - kHeader, static_cast<uint32_t>(kCapacity - kHeader));
+            UT_CHECK(peer.getChannel()->read(callback) == RetCode::kSuccess);
+            UT_CHECK(records == 1);
+        }
+    }
+
+    records = 0;
+    {
+        // More published than the ring holds
+        Peer peer;
+        if (peer.getChannel()) {
+            peer.publish(0, kCapacity + 8, 0);
+            UT_CHECK(peer.getChannel()->read(callback) == RetCode::kCorrupted);
+        }
+    }
+
+    {
+        // A record larger than the ring itself
+        Peer peer;
+        if (peer.getChannel()) {
+            peer.publish(0, kCapacity, static_cast<uint32_t>(4 * kCapacity));
+            UT_CHECK(peer.getChannel()->read(callback) == RetCode::kCorrupted);
+        }
+    }
+
+    {
+        // A record reaching past head
+        Peer peer;
+        if (peer.getChannel()) {
+            peer.publish(8, 8 + kHeader + 64, 128);
+            UT_CHECK(peer.getChannel()->read(callback) == RetCode::kCorrupted);
+        }
+    }
+
+    {
+        // Head behind tail
+        Peer peer;
+        if (peer.getChannel()) {
+            peer.publish(4096, 64, 0);
+            UT_CHECK(peer.getChannel()->read(callback) == RetCode::kCorrupted);
+        }
+    }
+    UT_CHECK(records == 0);
+}
+
+int main() {
+    testWraparound();
+    testBounds();
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include <set>
+#include <vector>
+#include <ut/ipc/slotmap.h>
+#include "check.h"
+
+// Handles of erased values stay stale while their slots are reused, and
+// erasing moves values around without breaking the handles of the others
+
+using SlotMap = UT::IPCSlotMap<int>;
+
+static uint32_t index(SlotMap::Handle handle) { return static_cast<uint32_t>(handle); }
+
+int main() {
+    {
+        SlotMap map;
+        auto a = map.insert(1);
+        auto b = map.insert(2);
+        auto c = map.insert(3);
+        UT_CHECK(a && b && c);
+        UT_CHECK(map.size() == 3);
+
+        // "c" moves into the gap left by "a"
+        UT_CHECK(map.erase(a));
+        UT_CHECK(!map.erase(a));
+        UT_CHECK(!map.find(a));
+        UT_CHECK(map.find(b) && *map.find(b) == 2);
+        UT_CHECK(map.find(c) && *map.find(c) == 3);
+        UT_CHECK(!map.find(0));
+
+        size_t visited = 0;
+        map.forEach([&] (SlotMap::Handle handle, int value) {
+            UT_CHECK(map.find(handle) && *map.find(handle) == value);
+            ++visited;
+        });
+        UT_CHECK(visited == 2);
+
+        map.clear();
+        UT_CHECK(map.empty());
+        UT_CHECK(!map.find(b) && !map.find(c));
+    }
+
+    {
+        // Freed slots are held back until more than kMinFree piled up
+        SlotMap map;
+        std::vector<SlotMap::Handle> handles;
+        for (size_t i = 0; i <= SlotMap::kMinFree; ++i) {
+            handles.push_back(map.insert(static_cast<int>(i)));
+        }
+        for (auto handle : handles) {
+            map.erase(handle);
+        }
+
+        auto reused = map.insert(-1);
+        UT_CHECK(index(reused) == index(handles.front()));
+        UT_CHECK(reused != handles.front());
+        UT_CHECK(!map.find(handles.front()));
+        UT_CHECK(map.find(reused) && *map.find(reused) == -1);
+    }
+
+    {
+        // A slot cycled over and over never hands out the same handle twice
+        SlotMap map;
+        std::set<SlotMap::Handle> seen;
+        for (int i = 0; i < 100000; ++i) {
+            auto handle = map.insert(i);
+            UT_CHECK(seen.insert(handle).second);
+            map.erase(handle);
+        }
+        UT_CHECK(map.empty());
+    }
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+#include "check.h"
+
+// A streamed message larger than UT_IPC_FRAME_MAX_SIZE arrives intact as
+// chunks no larger than the sender's chunk size, between one begin(...) and
+// one complete end(...), over sockets and shared memory and in both
+// directions. Without a stream handler it's joined and delivered whole, and
+// a sender leaving in the middle of one ends it as incomplete
+
+static constexpr uint32_t kChannel = 3;
+static constexpr uint32_t kType = 9;
+static constexpr size_t kPiece = 1024 * 1024;
+static constexpr size_t kTotal = UT_IPC_FRAME_MAX_SIZE + 16 * kPiece;
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static char byteAt(size_t offset) {
+    return static_cast<char>(offset % 251);
+}
+
+// What a stream handler saw of one channel
+struct Observed {
+    std::atomic<int> begins = 0;
+    std::atomic<int> ends = 0;
+    std::atomic<bool> complete = false;
+    std::atomic<bool> intact = true;
+    std::atomic<size_t> bytes = 0;
+    std::atomic<size_t> largest = 0;
+
+    void begin(uint32_t channel, uint32_t type) {
+        intact = intact && channel == kChannel && type == kType && bytes == 0;
+        ++begins;
+    }
+
+    void chunk(uint32_t channel, const void* data, size_t size) {
+        auto input = static_cast<const char*>(data);
+        bool same = channel == kChannel && begins == 1;
+        for (size_t i = 0; i < size && same; ++i) {
+            same = input[i] == byteAt(bytes + i);
+        }
+        intact = intact && same;
+        bytes += size;
+        largest = std::max(largest.load(), size);
+    }
+
+    void end(uint32_t channel, bool whole) {
+        intact = intact && channel == kChannel;
+        complete = whole;
+        ++ends;
+    }
+}; // struct Observed
+
+// Sends kTotal bytes in kPiece pieces, holding off while "congested"
+static void stream(const std::function<void(const void*, size_t, bool)>& send, const std::atomic<bool>& congested) {
+    std::vector<char> piece(kPiece);
+    for (size_t offset = 0; offset < kTotal; offset += kPiece) {
+        for (size_t i = 0; i < kPiece; ++i) {
+            piece[i] = byteAt(offset + i);
+        }
+        waitFor([&] { return !congested; });
+        send(piece.data(), piece.size(), offset + kPiece == kTotal);
+    }
+}
+
+static void testClientToServer(UT::IPCTransport transport, const std::string& name) {
+    Observed observed;
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setTransport(transport);
+    server.setStreamHandler({
+        [&] (UT::IPCClientId, uint32_t channel, uint32_t type) { observed.begin(channel, type); },
+        [&] (UT::IPCClientId, uint32_t channel, const void* data, size_t bytes) { observed.chunk(channel, data, bytes); },
+        [&] (UT::IPCClientId, uint32_t channel, bool complete) { observed.end(channel, complete); }
+    });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    std::atomic<bool> congested = false;
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setTransport(transport);
+    client.onCongestionChanged.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (bool state) {
+            congested = state;
+        });
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+
+    stream([&] (const void* data, size_t bytes, bool last) {
+        client.sendStream(kChannel, kType, data, bytes, last);
+    }, congested);
+    UT_CHECK(waitFor([&] { return observed.ends == 1; }));
+
+    UT_CHECK(observed.intact && observed.complete);
+    UT_CHECK(observed.begins == 1 && observed.bytes == kTotal);
+    if (transport == UT::IPCTransport::kSocket) {
+        UT_CHECK(observed.largest <= client.getChunkSize());
+    } else {
+        UT_CHECK(observed.largest <= kPiece);
+    }
+
+    client.stop();
+    server.stop();
+}
+
+static void testServerToClient(const std::string& name) {
+    Observed observed;
+    std::atomic<UT::IPCClientId> id = 0;
+    std::atomic<bool> congested = false;
+
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.onClientConnected.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId client) {
+            id = client;
+        });
+    server.onClientCongestionChanged.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId, bool state) {
+            congested = state;
+        });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.setStreamHandler({
+        [&] (uint32_t channel, uint32_t type) { observed.begin(channel, type); },
+        [&] (uint32_t channel, const void* data, size_t bytes) { observed.chunk(channel, data, bytes); },
+        [&] (uint32_t channel, bool complete) { observed.end(channel, complete); }
+    });
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady() && id; }));
+
+    stream([&] (const void* data, size_t bytes, bool last) {
+        server.sendStream(id, kChannel, kType, data, bytes, last);
+    }, congested);
+    UT_CHECK(waitFor([&] { return observed.ends == 1; }));
+
+    UT_CHECK(observed.intact && observed.complete);
+    UT_CHECK(observed.begins == 1 && observed.bytes == kTotal);
+    UT_CHECK(observed.largest <= server.getChunkSize());
+
+    client.stop();
+    server.stop();
+}
+
+static void testJoinedAndAborted(const std::string& name) {
+    std::mutex mutex;
+    std::vector<std::string> joined;
+    Observed observed;
+
+    // The first server joins, the second one streams
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.onChannelMessageReceived.addEventHandler(
+        UT::EventLoop::getMainInstance(),
+        [&] (UT::IPCClientId, uint32_t channel, uint32_t type, std::shared_ptr<void> data, ssize_t bytes) {
+            std::lock_guard lock(mutex);
+            if (channel == kChannel && type == kType) {
+                joined.emplace_back(static_cast<const char*>(data.get()), static_cast<size_t>(bytes));
+            }
+        });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    UT::IPCClient client;
+    client.setFramed(true);
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+
+    std::string expected;
+    for (int i = 0; i < 3; ++i) {
+        std::string piece(10000, static_cast<char>('a' + i));
+        expected += piece;
+        client.sendStream(kChannel, kType, piece.data(), piece.size(), i == 2);
+    }
+    UT_CHECK(waitFor([&] {
+        std::lock_guard lock(mutex);
+        return joined.size() == 1;
+    }));
+    {
+        std::lock_guard lock(mutex);
+        UT_CHECK(joined.size() == 1 && joined[0] == expected);
+    }
+    client.stop();
+    server.stop();
+
+    UT::IPCServer streaming;
+    streaming.setFramed(true);
+    streaming.setStreamHandler({
+        [&] (UT::IPCClientId, uint32_t channel, uint32_t type) { observed.begin(channel, type); },
+        [&] (UT::IPCClientId, uint32_t channel, const void* data, size_t bytes) { observed.chunk(channel, data, bytes); },
+        [&] (UT::IPCClientId, uint32_t channel, bool complete) { observed.end(channel, complete); }
+    });
+    UT_CHECK(streaming.start(name) == UT::IPCServer::RetCode::kSuccess);
+    client.start(name);
+    UT_CHECK(waitFor([&] { return client.getReady(); }));
+
+    std::vector<char> piece(1000);
+    for (size_t i = 0; i < piece.size(); ++i) {
+        piece[i] = byteAt(i);
+    }
+    client.sendStream(kChannel, kType, piece.data(), piece.size(), false);
+    UT_CHECK(waitFor([&] { return observed.bytes == piece.size(); }));
+    client.stop();
+
+    UT_CHECK(waitFor([&] { return observed.ends == 1; }));
+    UT_CHECK(observed.intact && !observed.complete && observed.begins == 1);
+
+    streaming.stop();
+}
+
+int main() {
+    testClientToServer(UT::IPCTransport::kSocket, "test-stream-socket");
+    testClientToServer(UT::IPCTransport::kSharedMemory, "test-stream-shm");
+    testServerToClient("test-stream-server");
+    testJoinedAndAborted("test-stream-joined");
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <ut/ipc/client.h>
+#include <ut/ipc/server.h>
+#include <ut/ipc/uring.h>
+#include "check.h"
+
+// A server asked for io_uring where the kernel refuses to set up a ring, as
+// with io_uring disabled by sysctl or filtered by seccomp, falls back to
+// poll(...) and serves its clients all the same. The refusal is played by a
+// seccomp filter in a child process, the parent runs the same clients with
+// whatever the kernel offers
+
+static constexpr int kClients = 4;
+static constexpr int kMessages = 100;
+
+static bool waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// io_uring_setup(...) fails with ENOSYS from here on
+static bool refuseUring() {
+    sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_io_uring_setup, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW)
+    };
+    sock_fprog program = { sizeof(filter) / sizeof(filter[0]), filter };
+
+    return prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0 && prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) == 0;
+}
+
+// Every client gets its messages echoed back
+static void testEcho(const std::string& name) {
+    UT::IPCServer server;
+    server.setFramed(true);
+    server.setBackend(UT::IPCPoller::Backend::kUring);
+    server.setWorkers(2);
+    server.setMessageHandler([&server] (UT::IPCClientId client, uint32_t type, const void* data, size_t bytes) {
+        server.sendMessage(client, type, data, bytes);
+    });
+    UT_CHECK(server.start(name) == UT::IPCServer::RetCode::kSuccess);
+
+    std::vector<std::unique_ptr<UT::IPCClient>> clients;
+    std::vector<std::unique_ptr<std::atomic<int>>> echoed;
+    for (int i = 0; i < kClients; ++i) {
+        echoed.push_back(std::make_unique<std::atomic<int>>(0));
+        auto& count = *echoed.back();
+        clients.push_back(std::make_unique<UT::IPCClient>());
+        auto& client = *clients.back();
+        client.setFramed(true);
+        client.setMessageHandler([&count] (uint32_t type, const void* data, size_t bytes) {
+            if (type == static_cast<uint32_t>(count) && bytes == sizeof(type) && *static_cast<const uint32_t*>(data) == type) {
+                ++count;
+            }
+        });
+        client.start(name);
+    }
+    UT_CHECK(waitFor([&] {
+        for (auto& client : clients) {
+            if (!client->getReady()) {
+                return false;
+            }
+        }
+        return server.getMetrics().connections.size() == kClients;
+    }));
+
+    for (uint32_t i = 0; i < kMessages; ++i) {
+        for (auto& client : clients) {
+            client->sendMessage(i, &i, sizeof(i));
+        }
+    }
+    UT_CHECK(waitFor([&] {
+        for (auto& count : echoed) {
+            if (*count != kMessages) {
+                return false;
+            }
+        }
+        return true;
+    }));
+
+    for (auto& client : clients) {
+        client->stop();
+    }
+    UT_CHECK(server.stop() == UT::IPCServer::RetCode::kSuccess);
+}
+
+int main() {
+    // Forked before any thread runs, the filter stays with the child
+    pid_t child = fork();
+    if (child == 0) {
+        UT_CHECK(refuseUring());
+        UT_CHECK(!UT::IPCUring::isSupported());
+        testEcho("test-uring-fallback-refused");
+        _exit(UT::Test::failures ? 1 : 0);
+    }
+    UT_CHECK(child > 0);
+
+    testEcho("test-uring-fallback");
+
+    int status = 0;
+    UT_CHECK(waitpid(child, &status, 0) == child);
+    UT_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    return UT::Test::failures ? 1 : 0;
+}
\ No newline at end of file